@@ -459,6 +459,7 @@ struct _typeobject {
     void* _gcvisit_func;
     void* _dtor;
     int _attrs_offset;
+    int _inline_attrs_hint;
     bool _flags[3];
     void* _tpp_descr_get;
     void* _tpp_hasnext;
@@ -0,0 +1,17 @@
+# Parsing throughput: compile some of the largest stdlib modules over and over.
+# compile() parses the source from memory with the same parser as imports use, but never hits
+# the .pyc cache.  It also builds a code object from the AST, so the wall time overstates the
+# parser's share; run with -s and look at the us_parsing stat for the time spent parsing alone.
+
+import os
+
+dirname = os.path.dirname(os.__file__)
+sources = []
+for name in ["decimal", "tarfile", "pydoc", "argparse", "difflib", "inspect"]:
+    fn = os.path.join(dirname, name + ".py")
+    with open(fn) as f:
+        sources.append((fn, f.read()))
+
+for i in xrange(10):
+    for fn, source in sources:
+        compile(source, fn, "exec")
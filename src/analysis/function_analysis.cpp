@@ -548,4 +548,24 @@ std::unique_ptr<PhiAnalysis> computeRequiredPhis(const OSREntryDescriptor* entry
     return std::unique_ptr<PhiAnalysis>(
         new PhiAnalysis(std::move(initial_map), entry_descriptor->backedge->target, true, liveness, scope_info));
 }
+
+LivenessAnalysis* getLivenessInfo(SourceInfo* source) {
+    if (source->liveness) {
+        static StatCounter counter("num_liveness_analysis_reused");
+        counter.log();
+    } else {
+        source->liveness = computeLivenessInfo(source->cfg);
+    }
+    return source->liveness.get();
+}
+
+PhiAnalysis* getRequiredPhis(const ParamNames& param_names, SourceInfo* source) {
+    if (source->phis) {
+        static StatCounter counter("num_phi_analysis_reused");
+        counter.log();
+    } else {
+        source->phis = computeRequiredPhis(param_names, source->cfg, getLivenessInfo(source), source->getScopeInfo());
+    }
+    return source->phis.get();
+}
 }
@@ -109,6 +109,11 @@ public:
 std::unique_ptr<LivenessAnalysis> computeLivenessInfo(CFG*);
 std::unique_ptr<PhiAnalysis> computeRequiredPhis(const ParamNames&, CFG*, LivenessAnalysis*, ScopeInfo* scope_info);
 std::unique_ptr<PhiAnalysis> computeRequiredPhis(const OSREntryDescriptor*, LivenessAnalysis*, ScopeInfo* scope_info);
+
+// Like the above, but computed once per function and kept on the SourceInfo, so that recompiles at a higher effort
+// level (and OSR compiles, for the liveness) don't redo them.  The param_names have to be the same on every call.
+LivenessAnalysis* getLivenessInfo(SourceInfo* source);
+PhiAnalysis* getRequiredPhis(const ParamNames& param_names, SourceInfo* source);
 }
 
 #endif
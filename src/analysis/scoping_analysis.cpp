@@ -42,6 +42,8 @@ bool containsYield(AST* ast) {
     YieldVisitor visitor;
     if (ast->type == AST_TYPE::FunctionDef) {
         AST_FunctionDef* funcDef = static_cast<AST_FunctionDef*>(ast);
+        if (funcDef->lazy_body)
+            return funcDef->lazy_body->contains_yield;
         for (auto& e : funcDef->body) {
             e->accept(&visitor);
             if (visitor.containsYield)
@@ -111,6 +113,21 @@ static bool isCompilerCreatedName(InternedString name) {
     return name.str()[0] == '!' || name.str()[0] == '#';
 }
 
+int ScopeInfo::getFastLocalSlot(InternedString name) {
+    auto it = fast_local_slots.find(name);
+    if (it != fast_local_slots.end())
+        return it->second;
+
+    VarScopeType vst = getScopeTypeOfName(name);
+    if (vst != VarScopeType::FAST && vst != VarScopeType::CLOSURE)
+        return -1;
+
+    int slot = fast_local_names.size();
+    fast_local_slots[name] = slot;
+    fast_local_names.push_back(name);
+    return slot;
+}
+
 class ModuleScopeInfo : public ScopeInfo {
 public:
     ScopeInfo* getParent() override { return NULL; }
@@ -208,7 +225,7 @@ public:
     InternedString internString(llvm::StringRef s) override { abort(); }
 };
 
-struct ScopingAnalysis::ScopeNameUsage {
+struct ScopingAnalysis::ScopeNameUsage : public ArenaAllocated {
     AST* node;
     ScopeNameUsage* parent;
     const std::string* private_name;
@@ -326,6 +343,11 @@ public:
             closure_offsets[p] = i;
             i++;
         }
+
+        std::vector<InternedString> written_sorted(usage->written.begin(), usage->written.end());
+        std::sort(written_sorted.begin(), written_sorted.end());
+        for (InternedString name : written_sorted)
+            getFastLocalSlot(name);
     }
 
     ~ScopeInfoBase() override { delete this->usage; }
@@ -587,6 +609,7 @@ public:
                 mangleNameInPlace(node->args->kwarg, cur->private_name, scoping->getInternedStrings());
                 doWrite(node->args->kwarg);
             }
+            node->ensureBody();
             for (AST_stmt* s : node->body)
                 s->accept(this);
             return true;
@@ -883,6 +906,8 @@ InternedStringPool& ScopingAnalysis::getInternedStrings() {
 }
 
 ScopeInfo* ScopingAnalysis::analyzeSubtree(AST* node) {
+    ArenaScope _arena_scope(arena);
+
     NameUsageMap usages;
     usages[node] = new ScopeNameUsage(node, NULL, this);
     NameCollectorVisitor::collect(node, &usages, this);
@@ -925,6 +950,14 @@ ScopeInfo* ScopingAnalysis::getScopeInfoForNode(AST* node) {
 
 ScopingAnalysis::ScopingAnalysis(AST* ast, bool globals_from_module)
     : parent_module(NULL), globals_from_module(globals_from_module) {
+    if (ast->type == AST_TYPE::Module) {
+        own_arena.reset(new Arena());
+        arena = own_arena.get();
+    } else {
+        arena = ArenaScope::global();
+    }
+    ArenaScope _arena_scope(arena);
+
     switch (ast->type) {
         case AST_TYPE::Module:
             assert(globals_from_module);
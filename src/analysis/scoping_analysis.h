@@ -15,6 +15,11 @@
 #ifndef PYSTON_ANALYSIS_SCOPINGANALYSIS_H
 #define PYSTON_ANALYSIS_SCOPINGANALYSIS_H
 
+#include <memory>
+
+#include "llvm/ADT/DenseMap.h"
+
+#include "core/arena.h"
 #include "core/common.h"
 #include "core/stringpool.h"
 
@@ -35,7 +40,11 @@ struct DerefInfo {
     size_t offset;
 };
 
-class ScopeInfo {
+class ScopeInfo : public ArenaAllocated {
+private:
+    llvm::DenseMap<InternedString, int> fast_local_slots;
+    std::vector<InternedString> fast_local_names;
+
 public:
     ScopeInfo() {}
     virtual ~ScopeInfo() {}
@@ -141,6 +150,14 @@ public:
 
     virtual InternedString mangleName(InternedString id) = 0;
     virtual InternedString internString(llvm::StringRef) = 0;
+
+    // Interpreted frames keep the FAST and CLOSURE variables of the scope in a flat array; these number them.
+    // The names that the scoping analysis finds are numbered up front, and compiler-created names (which only
+    // show up once the CFG gets built) get the next slot the first time they get asked about.
+    // Returns -1 if the name isn't a FAST or CLOSURE variable of this scope.
+    int getFastLocalSlot(InternedString name);
+    int getNumFastLocals() { return fast_local_names.size(); }
+    InternedString getFastLocalName(int slot) { return fast_local_names[slot]; }
 };
 
 class ScopingAnalysis {
@@ -160,6 +177,11 @@ private:
 
     bool globals_from_module;
 
+    // The ScopeInfos and the intermediate results of the analysis, and the CFGs of the scopes (see computeCFG).
+    // Modules get an arena of their own; eval and exec code uses the global one (see core/arena.h).
+    std::unique_ptr<Arena> own_arena;
+    Arena* arena;
+
 public:
     // The scope-analysis is done before any CFG-ization is done,
     // but many of the queries will be done post-CFG-ization.
@@ -174,6 +196,7 @@ public:
     ScopeInfo* getScopeInfoForNode(AST* node);
 
     InternedStringPool& getInternedStrings();
+    Arena* getArena() { return arena; }
     bool areGlobalsFromModule() { return globals_from_module; }
 };
 
@@ -84,6 +84,22 @@ typedef llvm::DenseMap<InternedString, CompilerType*> TypeMap;
 typedef llvm::DenseMap<CFGBlock*, TypeMap> AllTypeMap;
 typedef llvm::DenseMap<AST_expr*, CompilerType*> ExprTypeMap;
 typedef llvm::DenseMap<AST_expr*, BoxedClass*> TypeSpeculations;
+// What the type feedback said for each node that we considered speculating on:
+typedef std::vector<std::pair<AST_expr*, BoxedClass*>> TypeFeedback;
+
+// What the type feedback says about a node that we might speculate on.  For the int binops, all that matters is
+// whether the node has only ever produced ints, which gets returned as int_cls (or NULL if it has overflowed before).
+static BoxedClass* typeFeedbackFor(AST_expr* node) {
+    if (node->type == AST_TYPE::Attribute)
+        return predictClassFor(node);
+
+    // If this node has overflowed before, deopt() will have recorded the long:
+    TypeRecorder* recorder = lookupTypeRecorderForNode(node);
+    if (recorder && !recorder->onlySaw(int_cls))
+        return NULL;
+    return int_cls;
+}
+
 class BasicBlockTypePropagator : public ExprVisitor, public StmtVisitor {
 private:
     static const bool EXPAND_UNNEEDED = true;
@@ -92,16 +108,18 @@ private:
     TypeMap& sym_table;
     ExprTypeMap& expr_types;
     TypeSpeculations& type_speculations;
+    TypeFeedback& feedback;
     TypeAnalysis::SpeculationLevel speculation;
     ScopeInfo* scope_info;
 
     BasicBlockTypePropagator(CFGBlock* block, TypeMap& initial, ExprTypeMap& expr_types,
-                             TypeSpeculations& type_speculations, TypeAnalysis::SpeculationLevel speculation,
-                             ScopeInfo* scope_info)
+                             TypeSpeculations& type_speculations, TypeFeedback& feedback,
+                             TypeAnalysis::SpeculationLevel speculation, ScopeInfo* scope_info)
         : block(block),
           sym_table(initial),
           expr_types(expr_types),
           type_speculations(type_speculations),
+          feedback(feedback),
           speculation(speculation),
           scope_info(scope_info) {}
 
@@ -132,6 +150,12 @@ private:
         return old_type;
     }
 
+    BoxedClass* getTypeFeedback(AST_expr* node) {
+        BoxedClass* cls = typeFeedbackFor(node);
+        feedback.push_back(std::make_pair(node, cls));
+        return cls;
+    }
+
     CompilerType* getType(AST_expr* node) {
         type_speculations.erase(node);
 
@@ -184,7 +208,7 @@ private:
         //}
 
         if (speculation != TypeAnalysis::NONE) {
-            BoxedClass* speculated_class = predictClassFor(node);
+            BoxedClass* speculated_class = getTypeFeedback(node);
             rtn = processSpeculation(speculated_class, node, rtn);
         }
 
@@ -214,6 +238,20 @@ private:
         return type == STR || type == INT || type == FLOAT || type == LIST || type == DICT;
     }
 
+    // Speculate that int arithmetic doesn't overflow into a long, so that it can stay unboxed.  The JIT checks
+    // this with the overflow flag rather than with a class check on the result.
+    CompilerType* speculateIntBinop(AST_expr* node, CompilerType* left, CompilerType* right, AST_TYPE::AST_TYPE op_type,
+                                    CompilerType* rtn) {
+        if (speculation == TypeAnalysis::NONE || left != INT || right != INT)
+            return rtn;
+        if (op_type != AST_TYPE::Add && op_type != AST_TYPE::Sub && op_type != AST_TYPE::Mult)
+            return rtn;
+
+        if (getTypeFeedback(node) != int_cls)
+            return rtn;
+        return processSpeculation(int_cls, node, rtn);
+    }
+
     void* visit_augbinop(AST_AugBinOp* node) override {
         CompilerType* left = getType(node->left);
         CompilerType* right = getType(node->right);
@@ -240,7 +278,7 @@ private:
         ASSERT(rtn != UNDEF, "need to implement the actual semantics here for %s.%s", left->debugName().c_str(),
                name.c_str());
 
-        return rtn;
+        return speculateIntBinop(node, left, right, node->op_type, rtn);
     }
 
     void* visit_binop(AST_BinOp* node) override {
@@ -269,7 +307,7 @@ private:
         ASSERT(rtn != UNDEF, "need to implement the actual semantics here for %s.%s", left->debugName().c_str(),
                name.c_str());
 
-        return rtn;
+        return speculateIntBinop(node, left, right, node->op_type, rtn);
     }
 
     void* visit_boolop(AST_BoolOp* node) override {
@@ -648,14 +686,95 @@ private:
 
 public:
     static TypeMap propagate(CFGBlock* block, const TypeMap& starting, ExprTypeMap& expr_types,
-                             TypeSpeculations& type_speculations, TypeAnalysis::SpeculationLevel speculation,
-                             ScopeInfo* scope_info) {
+                             TypeSpeculations& type_speculations, TypeFeedback& feedback,
+                             TypeAnalysis::SpeculationLevel speculation, ScopeInfo* scope_info) {
         TypeMap ending = starting;
-        BasicBlockTypePropagator(block, ending, expr_types, type_speculations, speculation, scope_info).run();
+        BasicBlockTypePropagator(block, ending, expr_types, type_speculations, feedback, speculation, scope_info)
+            .run();
         return ending;
     }
 };
 
+namespace {
+// The most recent propagation of a block:
+struct CachedBlockTypes {
+    bool valid = false;
+    TypeAnalysis::SpeculationLevel speculation;
+    TypeMap starting, ending;
+    // Only the entries for the nodes in this block:
+    ExprTypeMap expr_types;
+    TypeSpeculations type_speculations;
+    TypeFeedback feedback;
+};
+
+class BlockTypeCache : public TypeAnalysisCache {
+public:
+    llvm::DenseMap<CFGBlock*, CachedBlockTypes> blocks;
+};
+}
+
+static BlockTypeCache* getBlockTypeCache(SourceInfo* source) {
+    if (!source->type_analysis_cache)
+        source->type_analysis_cache.reset(new BlockTypeCache());
+    return static_cast<BlockTypeCache*>(source->type_analysis_cache.get());
+}
+
+static bool sameTypes(const TypeMap& lhs, const TypeMap& rhs) {
+    if (lhs.size() != rhs.size())
+        return false;
+    for (const auto& p : lhs) {
+        auto it = rhs.find(p.first);
+        if (it == rhs.end() || it->second != p.second)
+            return false;
+    }
+    return true;
+}
+
+static bool typeFeedbackUnchanged(const TypeFeedback& feedback) {
+    for (const auto& p : feedback) {
+        if (typeFeedbackFor(p.first) != p.second)
+            return false;
+    }
+    return true;
+}
+
+// Like BasicBlockTypePropagator::propagate(), but reuses the block's cached result if it's still valid.
+static TypeMap propagateCached(BlockTypeCache* cache, CFGBlock* block, const TypeMap& starting,
+                               ExprTypeMap& expr_types, TypeSpeculations& type_speculations,
+                               TypeAnalysis::SpeculationLevel speculation, ScopeInfo* scope_info) {
+    CachedBlockTypes& cached = cache->blocks[block];
+
+    if (cached.valid && cached.speculation == speculation && sameTypes(cached.starting, starting)
+        && typeFeedbackUnchanged(cached.feedback)) {
+        static StatCounter num_reused("num_type_analysis_blocks_reused");
+        num_reused.log();
+    } else {
+        static StatCounter num_propagated("num_type_analysis_blocks_propagated");
+        num_propagated.log();
+
+        cached.valid = false;
+        cached.speculation = speculation;
+        cached.starting = starting;
+        cached.expr_types.clear();
+        cached.type_speculations.clear();
+        cached.feedback.clear();
+        cached.ending = BasicBlockTypePropagator::propagate(block, starting, cached.expr_types,
+                                                            cached.type_speculations, cached.feedback, speculation,
+                                                            scope_info);
+        cached.valid = true;
+    }
+
+    // Same as if the block had been propagated into expr_types and type_speculations directly:
+    for (const auto& p : cached.expr_types) {
+        expr_types[p.first] = p.second;
+        type_speculations.erase(p.first);
+    }
+    for (const auto& p : cached.type_speculations)
+        type_speculations[p.first] = p.second;
+
+    return cached.ending;
+}
+
 class PropagatingTypeAnalysis : public TypeAnalysis {
 private:
     AllTypeMap starting_types;
@@ -727,7 +846,7 @@ public:
         return changed;
     }
 
-    static PropagatingTypeAnalysis* doAnalysis(SpeculationLevel speculation, ScopeInfo* scope_info,
+    static PropagatingTypeAnalysis* doAnalysis(SourceInfo* source, SpeculationLevel speculation,
                                                TypeMap&& initial_types, CFGBlock* initial_block) {
         Timer _t("PropagatingTypeAnalysis::doAnalysis()");
 
@@ -735,6 +854,9 @@ public:
         ExprTypeMap expr_types;
         TypeSpeculations type_speculations;
 
+        BlockTypeCache* cache = getBlockTypeCache(source);
+        ScopeInfo* scope_info = source->getScopeInfo();
+
         llvm::SmallPtrSet<CFGBlock*, 32> in_queue;
         std::priority_queue<CFGBlock*, llvm::SmallVector<CFGBlock*, 32>, CFGBlockMinIndex> queue;
 
@@ -763,8 +885,8 @@ public:
                 }
             }
 
-            TypeMap ending = BasicBlockTypePropagator::propagate(block, starting_types[block], expr_types,
-                                                                 type_speculations, speculation, scope_info);
+            TypeMap ending = propagateCached(cache, block, starting_types[block], expr_types, type_speculations,
+                                             speculation, scope_info);
 
             if (VERBOSITY("types") >= 3) {
                 printf("before (after):\n");
@@ -817,13 +939,15 @@ public:
 
 
 // public entry point:
-TypeAnalysis* doTypeAnalysis(CFG* cfg, const ParamNames& arg_names, const std::vector<ConcreteCompilerType*>& arg_types,
-                             EffortLevel effort, TypeAnalysis::SpeculationLevel speculation, ScopeInfo* scope_info) {
+TypeAnalysis* doTypeAnalysis(SourceInfo* source, const ParamNames& arg_names,
+                             const std::vector<ConcreteCompilerType*>& arg_types, EffortLevel effort,
+                             TypeAnalysis::SpeculationLevel speculation) {
     // if (effort == EffortLevel::INTERPRETED) {
     // return new NullTypeAnalysis();
     //}
     assert(arg_names.totalParameters() == arg_types.size());
 
+    ScopeInfo* scope_info = source->getScopeInfo();
     TypeMap initial_types;
     int i = 0;
 
@@ -843,17 +967,17 @@ TypeAnalysis* doTypeAnalysis(CFG* cfg, const ParamNames& arg_names, const std::v
 
     assert(i == arg_types.size());
 
-    return PropagatingTypeAnalysis::doAnalysis(speculation, scope_info, std::move(initial_types),
-                                               cfg->getStartingBlock());
+    return PropagatingTypeAnalysis::doAnalysis(source, speculation, std::move(initial_types),
+                                               source->cfg->getStartingBlock());
 }
 
-TypeAnalysis* doTypeAnalysis(const OSREntryDescriptor* entry_descriptor, EffortLevel effort,
-                             TypeAnalysis::SpeculationLevel speculation, ScopeInfo* scope_info) {
+TypeAnalysis* doTypeAnalysis(SourceInfo* source, const OSREntryDescriptor* entry_descriptor, EffortLevel effort,
+                             TypeAnalysis::SpeculationLevel speculation) {
     // if (effort == EffortLevel::INTERPRETED) {
     // return new NullTypeAnalysis();
     //}
     TypeMap initial_types(entry_descriptor->args.begin(), entry_descriptor->args.end());
-    return PropagatingTypeAnalysis::doAnalysis(speculation, scope_info, std::move(initial_types),
+    return PropagatingTypeAnalysis::doAnalysis(source, speculation, std::move(initial_types),
                                                entry_descriptor->backedge->target);
 }
 }
@@ -43,11 +43,20 @@ public:
     virtual BoxedClass* speculatedExprClass(AST_expr*) = 0;
 };
 
-TypeAnalysis* doTypeAnalysis(CFG* cfg, const ParamNames& param_names,
+// What propagating types through each block of a function produced last time, kept on the SourceInfo.  When the
+// function gets recompiled (at a higher effort level, or for an OSR entry), a block whose starting types are the same
+// as last time, and whose type feedback still predicts the same classes for the nodes we speculated on, doesn't
+// have to be propagated again.
+class TypeAnalysisCache {
+public:
+    virtual ~TypeAnalysisCache() {}
+};
+
+TypeAnalysis* doTypeAnalysis(SourceInfo* source, const ParamNames& param_names,
                              const std::vector<ConcreteCompilerType*>& arg_types, EffortLevel effort,
-                             TypeAnalysis::SpeculationLevel speculation, ScopeInfo* scope_info);
-TypeAnalysis* doTypeAnalysis(const OSREntryDescriptor* entry_descriptor, EffortLevel effort,
-                             TypeAnalysis::SpeculationLevel speculation, ScopeInfo* scope_info);
+                             TypeAnalysis::SpeculationLevel speculation);
+TypeAnalysis* doTypeAnalysis(SourceInfo* source, const OSREntryDescriptor* entry_descriptor, EffortLevel effort,
+                             TypeAnalysis::SpeculationLevel speculation);
 }
 
 #endif
@@ -646,6 +646,29 @@ void Assembler::incl(Indirect mem) {
     }
 }
 
+void Assembler::incq(Indirect mem) {
+    int src_idx = mem.base.regnum;
+
+    int rex = REX_W;
+    if (src_idx >= 8) {
+        rex |= REX_B;
+        src_idx -= 8;
+    }
+
+    assert(src_idx >= 0 && src_idx < 8);
+
+    emitRex(rex);
+    emitByte(0xff);
+
+    assert(-0x80 <= mem.offset && mem.offset < 0x80);
+    if (mem.offset == 0) {
+        emitModRM(0b00, 0, src_idx);
+    } else {
+        emitModRM(0b01, 0, src_idx);
+        emitByte(mem.offset);
+    }
+}
+
 void Assembler::decl(Indirect mem) {
     int src_idx = mem.base.regnum;
 
@@ -126,6 +126,7 @@ public:
     void add(Immediate imm, Register reg);
     void sub(Immediate imm, Register reg);
     void incl(Indirect mem);
+    void incq(Indirect mem);
     void decl(Indirect mem);
 
     void callq(Register reg);
@@ -14,6 +14,7 @@
 
 #include "asm_writing/icinfo.h"
 
+#include <algorithm>
 #include <cstring>
 #include <memory>
 
@@ -22,6 +23,8 @@
 #include "asm_writing/assembler.h"
 #include "asm_writing/mc_writer.h"
 #include "codegen/patchpoints.h"
+#include "codegen/unwinding.h"
+#include "core/ast.h"
 #include "core/common.h"
 #include "core/options.h"
 #include "core/types.h"
@@ -39,12 +42,30 @@ int64_t ICInvalidator::version() {
 }
 
 void ICInvalidator::addDependent(ICSlotInfo* entry_info) {
-    dependents.insert(entry_info);
+    if (dependents.insert(entry_info).second)
+        entry_info->invalidators.push_back(this);
+}
+
+void ICInvalidator::removeDependent(ICSlotInfo* entry_info) {
+    dependents.erase(entry_info);
+}
+
+static void unlinkInvalidator(ICSlotInfo* slot, ICInvalidator* invalidator) {
+    auto it = std::find(slot->invalidators.begin(), slot->invalidators.end(), invalidator);
+    assert(it != slot->invalidators.end());
+    slot->invalidators.erase(it);
+}
+
+ICInvalidator::~ICInvalidator() {
+    for (ICSlotInfo* slot : dependents)
+        unlinkInvalidator(slot, this);
 }
 
 void ICInvalidator::invalidateAll() {
     cur_version++;
     for (ICSlotInfo* slot : dependents) {
+        unlinkInvalidator(slot, this);
+        slot->ic->recordInvalidation();
         slot->clear();
     }
     dependents.clear();
@@ -75,6 +96,10 @@ void ICSlotRewrite::abort() {
     ic->retry_in = ic->retry_backoff;
 }
 
+void ICSlotRewrite::recordAbortReason(const std::string& reason) {
+    ic->abort_reasons[reason]++;
+}
+
 void ICSlotRewrite::commit(CommitHook* hook) {
     bool still_valid = true;
     for (int i = 0; i < dependencies.size(); i++) {
@@ -111,9 +136,18 @@ void ICSlotRewrite::commit(CommitHook* hook) {
         invalidator->addDependent(ic_entry);
     }
 
+    // The hits of the code we're replacing still count towards the IC:
+    ic->hits_in_replaced_slots += ic_entry->num_hits;
+    ic_entry->num_hits = 0;
+
     // if (VERBOSITY()) printf("Commiting to %p-%p\n", start, start + ic->slot_size);
     memcpy(slot_start, buf, ic->getSlotSize());
 
+    if (ic->isMegamorphic()) {
+        static StatCounter megamorphic_final_rewrites("megamorphic_ic_final_rewrites");
+        megamorphic_final_rewrites.log();
+    }
+
     ic->times_rewritten++;
 
     if (ic->times_rewritten == MEGAMORPHIC_THRESHOLD) {
@@ -193,6 +227,11 @@ ICInfo::ICInfo(void* start_addr, void* slowpath_rtn_addr, void* continue_addr, S
       retry_in(0),
       retry_backoff(1),
       times_rewritten(0),
+      debug_name(NULL),
+      times_missed(0),
+      times_invalidated(0),
+      hits_in_replaced_slots(0),
+      deregistered(false),
       start_addr(start_addr),
       slowpath_rtn_addr(slowpath_rtn_addr),
       continue_addr(continue_addr) {
@@ -201,6 +240,14 @@ ICInfo::ICInfo(void* start_addr, void* slowpath_rtn_addr, void* continue_addr, S
     }
 }
 
+ICInfo::~ICInfo() {
+    assert(deregistered);
+    for (ICSlotInfo& slot : slots) {
+        for (ICInvalidator* invalidator : slot.invalidators)
+            invalidator->removeDependent(&slot);
+    }
+}
+
 static std::unordered_map<void*, ICInfo*> ics_by_return_addr;
 std::unique_ptr<ICInfo> registerCompiledPatchpoint(uint8_t* start_addr, uint8_t* slowpath_start_addr,
                                                    uint8_t* continue_addr, uint8_t* slowpath_rtn_addr,
@@ -254,6 +301,7 @@ std::unique_ptr<ICInfo> registerCompiledPatchpoint(uint8_t* start_addr, uint8_t*
 void deregisterCompiledPatchpoint(ICInfo* ic) {
     assert(ics_by_return_addr.count(ic->slowpath_rtn_addr));
     ics_by_return_addr.erase(ic->slowpath_rtn_addr);
+    ic->deregistered = true;
 }
 
 ICInfo* getICInfo(void* rtn_addr) {
@@ -267,6 +315,9 @@ ICInfo* getICInfo(void* rtn_addr) {
 void ICInfo::clear(ICSlotInfo* icentry) {
     assert(icentry);
 
+    if (deregistered)
+        return;
+
     uint8_t* start = (uint8_t*)start_addr + icentry->idx * getSlotSize();
 
     if (VERBOSITY() >= 4)
@@ -290,6 +341,75 @@ bool ICInfo::shouldAttempt() {
         retry_in--;
         return false;
     }
-    return times_rewritten < MEGAMORPHIC_THRESHOLD;
+    // Allow one more rewrite once we hit the threshold; see isMegamorphic()
+    return times_rewritten <= MEGAMORPHIC_THRESHOLD;
+}
+
+bool ICInfo::isMegamorphic() const {
+    return times_rewritten >= MEGAMORPHIC_THRESHOLD;
+}
+
+void ICInfo::recordMiss(const char* debug_name) {
+    times_missed++;
+
+    if (this->debug_name)
+        return;
+    this->debug_name = debug_name;
+
+    // Walking the stack is expensive, so we only figure out where we are on the first miss.
+    // ICs that belong to a Python function get called directly from its code, so the topmost Python
+    // frame is the one we want; anything else (ex runtime ICs) doesn't have a source location.
+    PythonFrameIterator frame = getPythonFrame(0);
+    if (!frame.exists()) {
+        source_location = "<unknown>";
+        return;
+    }
+    std::unique_ptr<ExecutionPoint> point = frame.getExecutionPoint();
+    CompiledFunction* cf = point->cf;
+    if (std::find(cf->ics.begin(), cf->ics.end(), this) == cf->ics.end()) {
+        source_location = "<runtime>";
+        return;
+    }
+    SourceInfo* source = cf->clfunc->source.get();
+    source_location = source->fn + ":" + std::to_string(point->current_stmt->lineno) + " (" + source->getName() + ")";
+}
+
+void dumpICStats(int64_t min_misses) {
+    std::vector<ICInfo*> ics;
+    for (auto&& p : ics_by_return_addr) {
+        if (p.second->times_missed >= min_misses && p.second->debug_name)
+            ics.push_back(p.second);
+    }
+    std::sort(ics.begin(), ics.end(), [](ICInfo* a, ICInfo* b) { return a->times_missed > b->times_missed; });
+
+    fprintf(stderr, "IC stats (%ld ICs):\n", ics.size());
+    fprintf(stderr, "%12s %12s %8s %8s %8s  %-10s %s\n", "hits", "misses", "rewrites", "aborts", "invals", "kind",
+            "location");
+    for (ICInfo* ic : ics) {
+        int64_t hits = ic->hits_in_replaced_slots;
+        std::string slot_hits;
+        for (ICSlotInfo& slot : ic->slots) {
+            hits += slot.num_hits;
+            if (!slot_hits.empty())
+                slot_hits += " ";
+            slot_hits += std::to_string(slot.num_hits);
+        }
+
+        int64_t aborts = 0;
+        std::vector<std::pair<int64_t, std::string>> reasons;
+        for (auto&& p : ic->abort_reasons) {
+            aborts += p.second;
+            reasons.push_back(std::make_pair(p.second, p.first));
+        }
+        std::sort(reasons.rbegin(), reasons.rend());
+
+        fprintf(stderr, "%12ld %12ld %8d %8ld %8ld  %-10s %s%s\n", hits, ic->times_missed, ic->times_rewritten, aborts,
+                ic->times_invalidated, ic->debug_name, ic->source_location.c_str(),
+                ic->isMegamorphic() ? " [megamorphic]" : "");
+        fprintf(stderr, "%12s slot hits: %s\n", "", slot_hits.c_str());
+        for (auto&& p : reasons) {
+            fprintf(stderr, "%12s aborted %ld times: %s\n", "", p.first, p.second.c_str());
+        }
+    }
 }
 }
@@ -16,6 +16,8 @@
 #define PYSTON_ASMWRITING_ICINFO_H
 
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -34,12 +36,19 @@ class ICInvalidator;
 
 struct ICSlotInfo {
 public:
-    ICSlotInfo(ICInfo* ic, int idx) : ic(ic), idx(idx), num_inside(0) {}
+    ICSlotInfo(ICInfo* ic, int idx) : ic(ic), idx(idx), num_inside(0), num_hits(0) {}
 
     ICInfo* ic;
     int idx;        // the index inside the ic
     int num_inside; // the number of stack frames that are currently inside this slot
 
+    // The number of times the current contents of this slot were run.  Only counted for slots that
+    // were written while ENABLE_IC_TELEMETRY was set.
+    int64_t num_hits;
+
+    // The invalidators that this slot is a dependent of; ~ICInfo removes the slot from them.
+    std::vector<ICInvalidator*> invalidators;
+
     void clear();
 };
 
@@ -77,6 +86,7 @@ public:
     void addDependenceOn(ICInvalidator&);
     void commit(CommitHook* hook);
     void abort();
+    void recordAbortReason(const std::string& reason);
 
     const ICInfo* getICInfo() { return ic; }
 
@@ -102,6 +112,16 @@ private:
     int retry_in, retry_backoff;
     int times_rewritten;
 
+    // Telemetry, only collected while ENABLE_IC_TELEMETRY is set.  See dumpICStats().
+    const char* debug_name; // the kind of IC, as given by the first slowpath that tried to rewrite it
+    std::string source_location;
+    int64_t times_missed, times_invalidated, hits_in_replaced_slots;
+    std::unordered_map<std::string, int64_t> abort_reasons;
+
+    // Set once the IC has been deregistered, after which its code may get freed, so clearing slots has to
+    // become a no-op.
+    bool deregistered;
+
     // for ICSlotRewrite:
     ICSlotInfo* pickEntryForRewrite(const char* debug_name);
 
@@ -109,6 +129,9 @@ public:
     ICInfo(void* start_addr, void* slowpath_rtn_addr, void* continue_addr, StackInfo stack_info, int num_slots,
            int slot_size, llvm::CallingConv::ID calling_conv, const std::unordered_set<int>& live_outs,
            assembler::GenericRegister return_register, TypeRecorder* type_recorder);
+    ~ICInfo();
+    ICInfo(const ICInfo&) = delete;
+    void operator=(const ICInfo&) = delete;
     void* const start_addr, *const slowpath_rtn_addr, *const continue_addr;
 
     int getSlotSize() { return slot_size; }
@@ -121,7 +144,19 @@ public:
 
     bool shouldAttempt();
 
+    // An IC becomes megamorphic once it has been rewritten too many times.  We then allow one final rewrite,
+    // which callers that support it should use to install a stub that calls into a shared, type-independent
+    // cache, since trying to cache the types seen here is pointless.  The existing entries stay in place and
+    // keep handling the types they were specialized for.
+    bool isMegamorphic() const;
+
+    // Called whenever the slowpath for this IC is taken.
+    void recordMiss(const char* debug_name);
+    void recordInvalidation() { times_invalidated++; }
+
     friend class ICSlotRewrite;
+    friend void dumpICStats(int64_t min_misses);
+    friend void deregisterCompiledPatchpoint(ICInfo* ic);
 };
 
 class ICSetupInfo;
@@ -133,6 +168,10 @@ std::unique_ptr<ICInfo> registerCompiledPatchpoint(uint8_t* start_addr, uint8_t*
 void deregisterCompiledPatchpoint(ICInfo* ic);
 
 ICInfo* getICInfo(void* rtn_addr);
+
+// Prints a table of the hits, misses, rewrites, aborts and invalidations of every live IC that has
+// missed at least min_misses times, most-missed first.  Only has data if ENABLE_IC_TELEMETRY was set.
+void dumpICStats(int64_t min_misses);
 }
 
 #endif
@@ -14,10 +14,14 @@
 
 #include "asm_writing/rewriter.h"
 
+#include <algorithm>
 #include <vector>
 
+#include "llvm/Support/Path.h"
+
 #include "asm_writing/icinfo.h"
 #include "core/common.h"
+#include "core/options.h"
 #include "core/stats.h"
 
 namespace pyston {
@@ -132,6 +136,8 @@ static bool isLargeConstant(int64_t val) {
 }
 
 void RewriterVar::addGuard(uint64_t val) {
+    if (!guards.insert(std::make_pair(val, false)).second)
+        return; // duplicate guard detected
     rewriter->addAction([=]() { rewriter->_addGuard(this, val); }, { this }, ActionType::GUARD);
 }
 
@@ -153,6 +159,8 @@ void Rewriter::_addGuard(RewriterVar* var, uint64_t val) {
 }
 
 void RewriterVar::addGuardNotEq(uint64_t val) {
+    if (!guards.insert(std::make_pair(val, true)).second)
+        return; // duplicate guard detected
     rewriter->addAction([=]() { rewriter->_addGuardNotEq(this, val); }, { this }, ActionType::GUARD);
 }
 
@@ -206,8 +214,19 @@ void Rewriter::_addAttrGuard(RewriterVar* var, int offset, uint64_t val, bool ne
 }
 
 RewriterVar* RewriterVar::getAttr(int offset, Location dest, assembler::MovType type) {
+    // If we already loaded this and nothing could have written to memory since then, reuse that load.
+    // Only do this if the caller doesn't care where the result ends up.
+    auto key = std::make_pair(offset, (int)type);
+    if (dest.type == Location::AnyReg) {
+        auto it = attr_loads.find(key);
+        if (it != attr_loads.end() && it->second.second == rewriter->num_mutations)
+            return it->second.first;
+    }
+
     RewriterVar* result = rewriter->createNewVar();
-    rewriter->addAction([=]() { rewriter->_getAttr(result, this, offset, dest, type); }, { this }, ActionType::NORMAL);
+    rewriter->addAction([=]() { rewriter->_getAttr(result, this, offset, dest, type); }, { this }, ActionType::NORMAL,
+                        result);
+    attr_loads[key] = std::make_pair(result, rewriter->num_mutations);
     return result;
 }
 
@@ -232,7 +251,8 @@ void Rewriter::_getAttr(RewriterVar* result, RewriterVar* ptr, int offset, Locat
 
 RewriterVar* RewriterVar::getAttrDouble(int offset, Location dest) {
     RewriterVar* result = rewriter->createNewVar();
-    rewriter->addAction([=]() { rewriter->_getAttrDouble(result, this, offset, dest); }, { this }, ActionType::NORMAL);
+    rewriter->addAction([=]() { rewriter->_getAttrDouble(result, this, offset, dest); }, { this }, ActionType::NORMAL,
+                        result);
     return result;
 }
 
@@ -250,7 +270,8 @@ void Rewriter::_getAttrDouble(RewriterVar* result, RewriterVar* ptr, int offset,
 
 RewriterVar* RewriterVar::getAttrFloat(int offset, Location dest) {
     RewriterVar* result = rewriter->createNewVar();
-    rewriter->addAction([=]() { rewriter->_getAttrFloat(result, this, offset, dest); }, { this }, ActionType::NORMAL);
+    rewriter->addAction([=]() { rewriter->_getAttrFloat(result, this, offset, dest); }, { this }, ActionType::NORMAL,
+                        result);
     return result;
 }
 
@@ -272,14 +293,14 @@ void Rewriter::_getAttrFloat(RewriterVar* result, RewriterVar* ptr, int offset,
 RewriterVar* RewriterVar::cmp(AST_TYPE::AST_TYPE cmp_type, RewriterVar* other, Location dest) {
     RewriterVar* result = rewriter->createNewVar();
     rewriter->addAction([=]() { rewriter->_cmp(result, this, cmp_type, other, dest); }, { this, other },
-                        ActionType::NORMAL);
+                        ActionType::NORMAL, result);
     return result;
 }
 
 void Rewriter::_cmp(RewriterVar* result, RewriterVar* v1, AST_TYPE::AST_TYPE cmp_type, RewriterVar* v2, Location dest) {
     assembler::Register v1_reg = v1->getInReg();
-    assembler::Register v2_reg = v2->getInReg();
-    assert(v1_reg != v2_reg); // TODO how do we ensure this?
+    assembler::Register v2_reg = v2->getInReg(Location::any(), false, v1_reg);
+    assert(v1_reg != v2_reg);
 
     v1->bumpUse();
     v2->bumpUse();
@@ -304,7 +325,7 @@ void Rewriter::_cmp(RewriterVar* result, RewriterVar* v1, AST_TYPE::AST_TYPE cmp
 
 RewriterVar* RewriterVar::toBool(Location dest) {
     RewriterVar* result = rewriter->createNewVar();
-    rewriter->addAction([=]() { rewriter->_toBool(result, this, dest); }, { this }, ActionType::NORMAL);
+    rewriter->addAction([=]() { rewriter->_toBool(result, this, dest); }, { this }, ActionType::NORMAL, result);
     return result;
 }
 
@@ -371,6 +392,17 @@ assembler::Register RewriterVar::getInReg(Location dest, bool allow_constant_in_
     // assembler::Register reg = var->rewriter->allocReg(l);
     // var->rewriter->addLocationToVar(var, reg);
     // return reg;
+
+    // Large constants get dropped instead of spilled; rematerialize them:
+    if (locations.empty()) {
+        assert(is_constant);
+        assembler::Register reg = rewriter->allocReg(dest, otherThan);
+        assert(rewriter->vars_by_location.count(reg) == 0);
+        rewriter->assembler->mov(assembler::Immediate(constant_value), reg);
+        rewriter->addLocationToVar(this, reg);
+        return reg;
+    }
+
     assert(locations.size());
 #ifndef NDEBUG
     if (!allow_constant_in_reg) {
@@ -506,8 +538,19 @@ RewriterVar* Rewriter::loadConst(int64_t val, Location dest) {
         }
         return var;
     } else {
+        // Like small constants, there's no need to load the same value more than once:
+        if (dest.type == Location::AnyReg) {
+            auto it = large_constants.find(val);
+            if (it != large_constants.end())
+                return it->second;
+        }
+
         RewriterVar* result = createNewVar();
-        addAction([=]() { this->_loadConst(result, val, dest); }, {}, ActionType::NORMAL);
+        result->is_constant = true;
+        result->constant_value = val;
+        addAction([=]() { this->_loadConst(result, val, dest); }, {}, ActionType::NORMAL, result);
+        if (dest.type == Location::AnyReg)
+            large_constants[val] = result;
         return result;
     }
 }
@@ -741,11 +784,33 @@ void Rewriter::_call(RewriterVar* result, bool can_call_into_python, void* func_
     result->releaseIfNoUses();
 }
 
+static __thread RewriteAbortReason pending_abort_reason;
+
+void noteRewriteAbortReason(const char* reason, const char* file, int line) {
+    if (!ENABLE_IC_TELEMETRY || pending_abort_reason.file)
+        return;
+    pending_abort_reason = { reason, file, line };
+}
+
+void Rewriter::restoreAbortReason() {
+    pending_abort_reason = outer_abort_reason;
+}
+
 void Rewriter::abort() {
     assert(!finished);
     finished = true;
     rewrite->abort();
 
+    if (ENABLE_IC_TELEMETRY) {
+        const RewriteAbortReason& r = pending_abort_reason;
+        if (r.reason && r.reason[0])
+            rewrite->recordAbortReason(r.reason);
+        else if (r.file)
+            rewrite->recordAbortReason(std::string(llvm::sys::path::filename(r.file)) + ":" + std::to_string(r.line));
+        else
+            rewrite->recordAbortReason("unknown");
+    }
+
     static StatCounter rewriter_aborts("rewriter_aborts");
     rewriter_aborts.log();
 }
@@ -782,6 +847,25 @@ void RewriterVar::releaseIfNoUses() {
     }
 }
 
+void Rewriter::removeDeadActions() {
+    static StatCounter num_removed("rewriter_dead_actions_removed");
+
+    // Going backwards means that dropping an action can make the actions that computed its operands dead too.
+    for (int i = actions.size() - 1; i >= 0; i--) {
+        RewriterAction& action = actions[i];
+        if (!action.result || !action.result->uses.empty())
+            continue;
+
+        action.dead = true;
+        for (RewriterVar* var : action.vars) {
+            auto it = std::find(var->uses.begin(), var->uses.end(), i);
+            assert(it != var->uses.end());
+            var->uses.erase(it);
+        }
+        num_removed.log();
+    }
+}
+
 void Rewriter::commit() {
     assert(!finished);
     initPhaseEmitting();
@@ -790,6 +874,7 @@ void Rewriter::commit() {
 
     auto on_assemblyfail = [&]() {
         rewriter_assemblyfail.log();
+        pending_abort_reason = { "ran out of space in the IC slot", NULL, 0 };
         this->abort();
     };
 
@@ -803,6 +888,8 @@ void Rewriter::commit() {
         live_outs[i]->uses.push_back(actions.size());
     }
 
+    removeDeadActions();
+
     assertConsistent();
 
     // Emit assembly for each action, and set done_guarding when
@@ -834,13 +921,16 @@ void Rewriter::commit() {
 
     // Now, start emitting assembly; check if we're dong guarding after each.
     for (int i = 0; i < actions.size(); i++) {
-        actions[i].action();
+        current_action = i;
+        if (!actions[i].dead)
+            actions[i].action();
 
         assertConsistent();
         if (i == last_guard_action) {
             on_done_guarding();
         }
     }
+    current_action = actions.size();
 
     if (marked_inside_ic) {
         // TODO this is super hacky: we don't know the address that we want to inc/dec, since
@@ -854,6 +944,14 @@ void Rewriter::commit() {
         assembler->decl(assembler::Indirect(reg, 0));
     }
 
+    if (ENABLE_IC_TELEMETRY) {
+        // Same trick as above: we don't know the address of the hit counter yet.
+        hit_counter_addr_addrs.push_back((void**)(assembler->curInstPointer() + 2));
+        assembler::Register reg = allocReg(Location::any(), getReturnDestination());
+        assembler->mov(assembler::Immediate(0x1234567890abcdefL), reg);
+        assembler->incq(assembler::Indirect(reg, 0));
+    }
+
 // Make sure that we have been calling bumpUse correctly.
 // All uses should have been accounted for, other than the live outs
 #ifndef NDEBUG
@@ -986,6 +1084,11 @@ bool Rewriter::finishAssembly(ICSlotInfo* picked_slot, int continue_offset) {
         }
     }
 
+    for (void** hit_counter_addr_addr : hit_counter_addr_addrs) {
+        assert(*hit_counter_addr_addr == (void*)0x1234567890abcdefL);
+        *hit_counter_addr_addr = &picked_slot->num_hits;
+    }
+
     assembler->jmp(assembler::JumpDestination::fromStart(continue_offset));
 
     assembler->fillWithNops();
@@ -1021,7 +1124,7 @@ Location Rewriter::allocScratch() {
 
 RewriterVar* Rewriter::add(RewriterVar* a, int64_t b, Location dest) {
     RewriterVar* result = createNewVar();
-    addAction([=]() { this->_add(result, a, b, dest); }, { a }, ActionType::NORMAL);
+    addAction([=]() { this->_add(result, a, b, dest); }, { a }, ActionType::NORMAL, result);
     return result;
 }
 
@@ -1177,8 +1280,9 @@ void Rewriter::spillRegister(assembler::Register reg, Location preserve) {
     RewriterVar* var = vars_by_location[reg];
     assert(var);
 
-    // There may be no need to spill if the var is held in a different location already.
-    if (var->locations.size() > 1) {
+    // There may be no need to spill if the var is held in a different location already,
+    // or if it's a constant that we can just load again.
+    if (var->locations.size() > 1 || var->is_constant) {
         removeLocationFromVar(var, reg);
         return;
     }
@@ -1230,18 +1334,28 @@ assembler::Register Rewriter::allocReg(Location dest, Location otherThan) {
     assertPhaseEmitting();
 
     if (dest.type == Location::AnyReg) {
+        for (assembler::Register reg : allocatable_regs) {
+            if (Location(reg) != otherThan && vars_by_location.count(reg) == 0)
+                return reg;
+        }
+
+        // No free registers, so we have to take one.  Prefer ones whose contents are free to drop (constants, or
+        // values that are also held somewhere else), as long as the current action isn't using them.
         int best = -1;
         bool found = false;
         assembler::Register best_reg(0);
         for (assembler::Register reg : allocatable_regs) {
             if (Location(reg) != otherThan) {
-                if (vars_by_location.count(reg) == 0) {
-                    return reg;
-                }
                 RewriterVar* var = vars_by_location[reg];
                 if (!done_guarding && var->is_arg && var->arg_loc == Location(reg)) {
                     continue;
                 }
+                bool used_by_current_action = var->uses[var->next_use] == current_action;
+                if ((var->is_constant || var->locations.size() > 1) && !used_by_current_action) {
+                    spillRegister(reg, /* preserve */ otherThan);
+                    assert(vars_by_location.count(reg) == 0);
+                    return reg;
+                }
                 if (var->uses[var->next_use] > best) {
                     found = true;
                     best = var->uses[var->next_use];
@@ -1382,7 +1496,9 @@ Rewriter::Rewriter(ICSlotRewrite* rewrite, int num_args, const std::vector<int>&
     : rewrite(rewrite),
       assembler(rewrite->getAssembler()),
       return_location(rewrite->returnRegister()),
+      current_action(-1),
       added_changing_action(false),
+      num_mutations(0),
       marked_inside_ic(false),
       last_guard_action(-1),
       done_guarding(false) {
@@ -1393,6 +1509,9 @@ Rewriter::Rewriter(ICSlotRewrite* rewrite, int num_args, const std::vector<int>&
 #endif
     finished = false;
 
+    outer_abort_reason = pending_abort_reason;
+    pending_abort_reason = { NULL, NULL, 0 };
+
     for (int i = 0; i < num_args; i++) {
         Location l = Location::forArg(i);
         RewriterVar* var = createNewVar();
@@ -1468,6 +1587,9 @@ Rewriter* Rewriter::createRewriter(void* rtn_addr, int num_args, const char* deb
         return NULL;
     }
 
+    if (ENABLE_IC_TELEMETRY)
+        ic->recordMiss(debug_name);
+
     if (!ic->shouldAttempt()) {
         rewriter_skipped.log();
         return NULL;
@@ -18,6 +18,7 @@
 #include <map>
 #include <memory>
 #include <tuple>
+#include <unordered_map>
 
 #include "llvm/ADT/SmallSet.h"
 
@@ -254,6 +255,15 @@ private:
     Location arg_loc;
 
     llvm::SmallSet<std::tuple<int, uint64_t, bool>, 4> attr_guards; // used to detect duplicate guards
+    llvm::SmallSet<std::pair<uint64_t, bool>, 4> guards;             // used to detect duplicate guards
+
+    // Previous loads from this var, so that we can reuse them if nothing could have changed
+    // memory in the meantime.  Maps (offset, MovType) to (result, Rewriter::num_mutations at the time).
+    std::map<std::pair<int, int>, std::pair<RewriterVar*, int>> attr_loads;
+
+    // Large constants don't need to be spilled, since we can just load them again.
+    bool is_constant;
+    uint64_t constant_value;
 
     // Gets a copy of this variable in a register, spilling/reloading if necessary.
     // TODO have to be careful with the result since the interface doesn't guarantee
@@ -278,7 +288,8 @@ public:
     static int nvars;
 #endif
 
-    RewriterVar(Rewriter* rewriter) : rewriter(rewriter), next_use(0), is_arg(false) {
+    RewriterVar(Rewriter* rewriter)
+        : rewriter(rewriter), next_use(0), is_arg(false), is_constant(false), constant_value(0) {
 #ifndef NDEBUG
         nvars++;
 #endif
@@ -295,8 +306,14 @@ public:
 class RewriterAction {
 public:
     std::function<void()> action;
+    // The vars that the action uses:
+    std::vector<RewriterVar*> vars;
+    // If the action only computes this var and has no other effects, it can be dropped when the var ends up unused:
+    RewriterVar* result;
+    bool dead;
 
-    RewriterAction(std::function<void()> f) : action(f) {}
+    RewriterAction(std::function<void()> f, std::vector<RewriterVar*> const& vars, RewriterVar* result)
+        : action(f), vars(vars), result(result), dead(false) {}
 };
 
 enum class ActionType { NORMAL, GUARD, MUTATION };
@@ -304,6 +321,18 @@ enum class ActionType { NORMAL, GUARD, MUTATION };
 // non-NULL fake pointer, definitely legit
 #define LOCATION_PLACEHOLDER ((RewriterVar*)1)
 
+// Why a rewrite got abandoned, for the IC telemetry.  Reasons without a description are identified by
+// the source location that gave up.
+struct RewriteAbortReason {
+    const char* reason;
+    const char* file;
+    int line;
+};
+
+// Records why the rewrite that's currently in progress on this thread is being abandoned.
+// Only the first reason is kept.
+void noteRewriteAbortReason(const char* reason, const char* file, int line);
+
 class Rewriter : public ICSlotRewrite::CommitHook {
 private:
     std::unique_ptr<ICSlotRewrite> rewrite;
@@ -338,7 +367,9 @@ private:
     Rewriter(ICSlotRewrite* rewrite, int num_args, const std::vector<int>& live_outs);
 
     std::vector<RewriterAction> actions;
-    void addAction(const std::function<void()>& action, std::vector<RewriterVar*> const& vars, ActionType type) {
+    // Pass the result var if the action only computes that var; see removeDeadActions().
+    void addAction(const std::function<void()>& action, std::vector<RewriterVar*> const& vars, ActionType type,
+                   RewriterVar* pure_result = NULL) {
         assertPhaseCollecting();
         for (RewriterVar* var : vars) {
             assert(var != NULL);
@@ -346,15 +377,29 @@ private:
         }
         if (type == ActionType::MUTATION) {
             added_changing_action = true;
+            num_mutations++;
         } else if (type == ActionType::GUARD) {
             assert(!added_changing_action);
             last_guard_action = (int)actions.size();
         }
-        actions.emplace_back(action);
+        actions.emplace_back(action, vars, pure_result);
     }
+    // The optimization pass over the collected actions, run once the rewrite gets committed: drops the actions
+    // whose results never got used.
+    void removeDeadActions();
+    // The index of the action that is being emitted:
+    int current_action;
     bool added_changing_action;
+    int num_mutations; // the number of MUTATION actions so far; see RewriterVar::attr_loads
+    std::unordered_map<int64_t, RewriterVar*> large_constants;
     bool marked_inside_ic;
     std::vector<void**> mark_addr_addrs;
+    // Like mark_addr_addrs, but for the slot's hit counter (see ENABLE_IC_TELEMETRY):
+    std::vector<void**> hit_counter_addr_addrs;
+
+    // The abort reason of any rewrite that we're nested inside of, which we restore once we're done.
+    RewriteAbortReason outer_abort_reason;
+    void restoreAbortReason();
 
     int last_guard_action;
 
@@ -433,6 +478,7 @@ public:
         if (!finished)
             this->abort();
         assert(finished);
+        restoreAbortReason();
 
         for (RewriterVar* var : vars) {
             delete var;
@@ -448,6 +494,9 @@ public:
 
     TypeRecorder* getTypeRecorder();
 
+    // See ICInfo::isMegamorphic()
+    bool isMegamorphic() { return rewrite->getICInfo()->isMegamorphic(); }
+
     void trap();
     RewriterVar* loadConst(int64_t val, Location loc = Location::any());
     // can_call_into_python: whether this call could result in arbitrary Python code being called.
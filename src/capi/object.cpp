@@ -20,6 +20,7 @@
 #include "capi/types.h"
 #include "core/threading.h"
 #include "core/types.h"
+#include "runtime/ics.h"
 #include "runtime/import.h"
 #include "runtime/objmodel.h"
 #include "runtime/types.h"
@@ -444,10 +445,17 @@ extern "C" int PyObject_SetAttr(PyObject* obj, PyObject* name, PyObject* value)
     }
 
     try {
-        if (value == NULL)
+        if (value == NULL) {
             delattr(obj, static_cast<BoxedString*>(name)->s.data());
-        else
-            setattr(obj, static_cast<BoxedString*>(name)->s.data(), value);
+        } else {
+            static RuntimeICCache<SetattrIC, 256, std::string> runtime_ic_cache;
+            llvm::StringRef attr = static_cast<BoxedString*>(name)->s;
+            SetattrIC* ic = runtime_ic_cache.getIC(__builtin_return_address(0), attr);
+            if (ic)
+                ic->call(obj, value);
+            else
+                setattr(obj, attr.data(), value);
+        }
     } catch (ExcInfo e) {
         setCAPIException(e);
         return -1;
@@ -457,7 +465,12 @@ extern "C" int PyObject_SetAttr(PyObject* obj, PyObject* name, PyObject* value)
 
 extern "C" int PyObject_SetAttrString(PyObject* v, const char* name, PyObject* w) noexcept {
     try {
-        setattr(v, name, w);
+        static RuntimeICCache<SetattrIC, 256, std::string> runtime_ic_cache;
+        SetattrIC* ic = w ? runtime_ic_cache.getIC(__builtin_return_address(0), llvm::StringRef(name)) : NULL;
+        if (ic)
+            ic->call(v, w);
+        else
+            setattr(v, name, w);
     } catch (ExcInfo e) {
         setCAPIException(e);
         return -1;
@@ -471,6 +484,10 @@ extern "C" PyObject* PyObject_GetAttrString(PyObject* o, const char* attr) noexc
     // threading::GLDemoteRegion _gil_demote;
 
     try {
+        static RuntimeICCache<GetattrIC, 256, std::string> runtime_ic_cache;
+        GetattrIC* ic = runtime_ic_cache.getIC(__builtin_return_address(0), llvm::StringRef(attr));
+        if (ic)
+            return ic->call(o);
         return getattr(o, attr);
     } catch (ExcInfo e) {
         setCAPIException(e);
@@ -2786,6 +2786,7 @@ extern "C" int PyType_Ready(PyTypeObject* cls) noexcept {
 
     // this should get automatically initialized to 0 on this path:
     assert(cls->attrs_offset == 0);
+    cls->inline_attrs_hint = -1;
 
     return 0;
 }
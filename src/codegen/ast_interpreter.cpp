@@ -16,10 +16,12 @@
 
 #include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/StringMap.h>
-#include <unordered_map>
 
 #include "analysis/function_analysis.h"
 #include "analysis/scoping_analysis.h"
+#include "codegen/baseline_jit.h"
+#include "codegen/bytecode.h"
+#include "codegen/code_cache.h"
 #include "codegen/codegen.h"
 #include "codegen/compvars.h"
 #include "codegen/irgen.h"
@@ -27,15 +29,17 @@
 #include "codegen/irgen/irgenerator.h"
 #include "codegen/irgen/util.h"
 #include "codegen/osrentry.h"
+#include "codegen/tiering.h"
 #include "core/ast.h"
 #include "core/cfg.h"
 #include "core/common.h"
-#include "core/contiguous_map.h"
 #include "core/stats.h"
 #include "core/thread_utils.h"
+#include "core/threading.h"
 #include "core/util.h"
 #include "runtime/capi.h"
 #include "runtime/generator.h"
+#include "runtime/ics.h"
 #include "runtime/import.h"
 #include "runtime/inline/boxing.h"
 #include "runtime/long.h"
@@ -70,19 +74,31 @@ union Value {
 
 class ASTInterpreter {
 public:
-    typedef ContiguousMap<InternedString, Box*> SymMap;
-
     ASTInterpreter(CompiledFunction* compiled_function);
+    ~ASTInterpreter();
 
     void initArguments(int nargs, BoxedClosure* closure, BoxedGenerator* generator, Box* arg1, Box* arg2, Box* arg3,
                        Box** args);
     static Value execute(ASTInterpreter& interpreter, CFGBlock* start_block = NULL, AST_stmt* start_at = NULL);
+    // Only gets called through executeInnerFromASM:
+    static Value executeInner(ASTInterpreter& interpreter, CFGBlock* start_block, AST_stmt* start_at);
 
 private:
     Box* createFunction(AST* node, AST_arguments* args, const std::vector<AST_stmt*>& body);
     Value doBinOp(Box* left, Box* right, int op, BinExpType exp_type);
     void doStore(AST_expr* node, Value value);
+    void doStore(AST_Name* node, Value value);
     void doStore(InternedString name, Value value);
+    int getLocalSlot(InternedString name);
+    int getLocalSlot(AST_Name* node);
+
+    // bytecode
+    // Runs the block's code from start to stop (the whole block by default).  Exceptions only get routed to the
+    // block's Invoke destination when running the whole block; otherwise the caller has to do that.
+    Value executeBytecode(CFGBlock* block, const uint32_t* start = NULL, const uint32_t* stop = NULL);
+    Value handleBytecodeException(CFGBlock* block, ExcInfo e);
+    Box* getOperand(uint32_t operand);
+    void raiseUnboundLocal(uint32_t slot) __attribute__((__noreturn__));
 
     Value visit_assert(AST_Assert* node);
     Value visit_assign(AST_Assign* node);
@@ -128,14 +144,34 @@ private:
     Value visit_jump(AST_Jump* node);
     Value visit_langPrimitive(AST_LangPrimitive* node);
 
+    // baseline jit
+    void compileBlock(CFGBlock* block);
+    static Box* jitRunBytecode(ASTInterpreter* interp, const uint32_t* start, const uint32_t* stop);
+    static Box* jitGetattr(ASTInterpreter* interp, const uint32_t* pc, GetattrIC* ic);
+    static Box* jitSetattr(ASTInterpreter* interp, const uint32_t* pc, SetattrIC* ic);
+    static Box* jitGetitem(ASTInterpreter* interp, const uint32_t* pc, GetitemIC* ic);
+    static Box* jitSetitem(ASTInterpreter* interp, const uint32_t* pc, SetitemIC* ic);
+    static Box* jitBinop(ASTInterpreter* interp, const uint32_t* pc, BinopIC* ic);
+    static Box* jitCompare(ASTInterpreter* interp, const uint32_t* pc, CompareIC* ic);
+    static Box* jitNonzero(ASTInterpreter* interp, const uint32_t* pc, NonzeroIC* ic);
+    static Box* jitCallattr(ASTInterpreter* interp, const uint32_t* pc, CallattrIC* ic);
+
     CompiledFunction* compiled_func;
     SourceInfo* source_info;
     ScopeInfo* scope_info;
     PhiAnalysis* phis;
 
-    SymMap sym_table;
+    BytecodeFunction* bytecode;
+    // The locals, followed by the bytecode's temporaries.
+    // There's no table of live interpreters, so the GC finds their contents by scanning the stack: the registers live
+    // in the interpreter object itself if they fit, and in a conservatively-scanned allocation otherwise.
+    static const int NUM_INLINE_VREGS = 16;
+    Box** vregs;
+    Box* inline_vregs[NUM_INLINE_VREGS];
     CFGBlock* next_block, *current_block;
     AST_stmt* current_inst;
+    // Set while running bytecode, instead of current_inst:
+    const uint32_t* current_pc;
     ExcInfo last_exception;
     BoxedClosure* passed_closure, *created_closure;
     BoxedGenerator* generator;
@@ -147,6 +183,8 @@ private:
 
 public:
     AST_stmt* getCurrentStatement() {
+        if (current_pc)
+            return bytecode->getStatementAt(current_pc);
         assert(current_inst);
         return current_inst;
     }
@@ -159,8 +197,9 @@ public:
     CompiledFunction* getCF() { return compiled_func; }
     FrameInfo* getFrameInfo() { return &frame_info; }
     BoxedClosure* getPassedClosure() { return passed_closure; }
-    const SymMap& getSymbolTable() { return sym_table; }
-    const ScopeInfo* getScopeInfo() { return scope_info; }
+    const BytecodeFunction* getBytecode() { return bytecode; }
+    Box* getLocal(int slot) { return vregs[slot]; }
+    ScopeInfo* getScopeInfo() { return scope_info; }
 
     void addSymbol(InternedString name, Box* value, bool allow_duplicates);
     void setGenerator(Box* gen);
@@ -170,13 +209,13 @@ public:
     void setFrameInfo(const FrameInfo* frame_info);
     void setGlobals(Box* globals);
 
-    void gcVisit(GCVisitor* visitor);
 };
 
 void ASTInterpreter::addSymbol(InternedString name, Box* value, bool allow_duplicates) {
+    int slot = getLocalSlot(name);
     if (!allow_duplicates)
-        assert(sym_table.count(name) == 0);
-    sym_table[name] = value;
+        assert(vregs[slot] == NULL);
+    vregs[slot] = value;
 }
 
 void ASTInterpreter::setGenerator(Box* gen) {
@@ -209,17 +248,21 @@ void ASTInterpreter::setGlobals(Box* globals) {
     this->globals = globals;
 }
 
-void ASTInterpreter::gcVisit(GCVisitor* visitor) {
-    visitor->visitRange((void* const*)&sym_table.vector()[0], (void* const*)&sym_table.vector()[sym_table.size()]);
-    if (passed_closure)
-        visitor->visit(passed_closure);
-    if (created_closure)
-        visitor->visit(created_closure);
-    if (generator)
-        visitor->visit(generator);
-    if (frame_info.boxedLocals)
-        visitor->visit(frame_info.boxedLocals);
-    visitor->visit(globals);
+// Computes the function's cfg and bytecode, if that hasn't happened yet.  They're shared by all threads running the
+// function, and the lowering also fills in the scope's local slots and the slots and scope types that get cached in
+// the AST_Name nodes (which is why nothing else has to update those later), so under the GRWL this has to happen with
+// the lock held for writing.
+static void ensureBytecode(CLFunction* f) {
+    SourceInfo* source = f->source.get();
+    if (source->bytecode)
+        return;
+
+    threading::GLPromoteRegion _gl_lock;
+    // promoteGL can drop the lock, so another thread might have gotten here first:
+    if (!source->cfg)
+        source->cfg = computeCFG(source, source->getBody());
+    if (!source->bytecode)
+        source->bytecode = lowerToBytecode(source, f->param_names);
 }
 
 ASTInterpreter::ASTInterpreter(CompiledFunction* compiled_function)
@@ -227,8 +270,11 @@ ASTInterpreter::ASTInterpreter(CompiledFunction* compiled_function)
       source_info(compiled_function->clfunc->source.get()),
       scope_info(0),
       phis(NULL),
+      bytecode(NULL),
+      next_block(0),
       current_block(0),
       current_inst(0),
+      current_pc(0),
       last_exception(NULL, NULL, NULL),
       passed_closure(0),
       created_closure(0),
@@ -236,13 +282,24 @@ ASTInterpreter::ASTInterpreter(CompiledFunction* compiled_function)
       edgecount(0),
       frame_info(ExcInfo(NULL, NULL, NULL)) {
 
-    CLFunction* f = compiled_function->clfunc;
-    if (!source_info->cfg)
-        source_info->cfg = computeCFG(f->source.get(), f->source->body);
+    // Keeps the version's baseline JIT code alive while we might be running it:
+    __atomic_fetch_add(&compiled_func->num_inside, 1, __ATOMIC_RELAXED);
 
+    ensureBytecode(compiled_function->clfunc);
     scope_info = source_info->getScopeInfo();
 
     assert(scope_info);
+
+    bytecode = source_info->bytecode;
+    if (bytecode->num_regs <= NUM_INLINE_VREGS)
+        vregs = inline_vregs;
+    else
+        vregs = (Box**)gc::gc_alloc(sizeof(Box*) * bytecode->num_regs, gc::GCKind::CONSERVATIVE);
+    memset(vregs, 0, sizeof(Box*) * bytecode->num_regs);
+}
+
+ASTInterpreter::~ASTInterpreter() {
+    __atomic_fetch_sub(&compiled_func->num_inside, 1, __ATOMIC_RELAXED);
 }
 
 void ASTInterpreter::initArguments(int nargs, BoxedClosure* _closure, BoxedGenerator* _generator, Box* arg1, Box* arg2,
@@ -272,32 +329,35 @@ void ASTInterpreter::initArguments(int nargs, BoxedClosure* _closure, BoxedGener
         doStore(source_info->getInternedStrings().get(param_names.kwarg), argsArray[i++]);
     }
 }
+}
 
-static std::unordered_map<void*, ASTInterpreter*> s_interpreterMap;
-static_assert(THREADING_USE_GIL, "have to make the interpreter map thread safe!");
+// Interpreted frames don't get registered anywhere: executeInnerFromASM (ast_interpreter_exec.S) sets up a frame that
+// keeps the ASTInterpreter* at a fixed offset from its frame pointer, and calls executeInnerAndSetupFrame.  The
+// unwinder recognizes interpreted frames by executeInnerFromASM's return address, and gets the interpreter from there.
+extern "C" Box* executeInnerFromASM(ASTInterpreter& interpreter, CFGBlock* start_block, AST_stmt* start_at);
+extern "C" Box* executeInnerAndSetupFrame(ASTInterpreter& interpreter, CFGBlock* start_block, AST_stmt* start_at) {
+    return ASTInterpreter::executeInner(interpreter, start_block, start_at).o;
+}
 
-class RegisterHelper {
-private:
-    void* frame_addr;
+static ASTInterpreter* getInterpreterFromFramePtr(void* frame_ptr) {
+    ASTInterpreter* interpreter = *((ASTInterpreter**)frame_ptr - 1);
+    assert(interpreter);
+    return interpreter;
+}
 
-public:
-    RegisterHelper(ASTInterpreter* interpreter, void* frame_addr) : frame_addr(frame_addr) {
-        s_interpreterMap[frame_addr] = interpreter;
-    }
-    ~RegisterHelper() {
-        assert(s_interpreterMap.count(frame_addr));
-        s_interpreterMap.erase(frame_addr);
-    }
-};
+namespace {
 
 Value ASTInterpreter::execute(ASTInterpreter& interpreter, CFGBlock* start_block, AST_stmt* start_at) {
+    Value v;
+    v.o = executeInnerFromASM(interpreter, start_block, start_at);
+    return v;
+}
+
+Value ASTInterpreter::executeInner(ASTInterpreter& interpreter, CFGBlock* start_block, AST_stmt* start_at) {
     threading::allowGLReadPreemption();
 
     STAT_TIMER(t0, "us_timer_astinterpreter_execute");
 
-    void* frame_addr = __builtin_frame_address(0);
-    RegisterHelper frame_registerer(&interpreter, frame_addr);
-
     Value v;
 
     assert((start_block == NULL) == (start_at == NULL));
@@ -306,23 +366,53 @@ Value ASTInterpreter::execute(ASTInterpreter& interpreter, CFGBlock* start_block
         start_at = start_block->body[0];
     }
 
-    interpreter.current_block = start_block;
-    bool started = false;
-    for (auto s : start_block->body) {
-        if (!started) {
-            if (s != start_at)
-                continue;
-            started = true;
-        }
+    if (start_at == start_block->body[0]) {
+        // Starting at the top of a block is the same as jumping to it, which lets the baseline JIT handle it:
+        interpreter.next_block = start_block;
+    } else {
+        interpreter.current_block = start_block;
+        bool started = false;
+        for (auto s : start_block->body) {
+            if (!started) {
+                if (s != start_at)
+                    continue;
+                started = true;
+            }
 
-        interpreter.current_inst = s;
-        v = interpreter.visit_stmt(s);
+            interpreter.current_inst = s;
+            v = interpreter.visit_stmt(s);
+        }
     }
 
     while (interpreter.next_block) {
         interpreter.current_block = interpreter.next_block;
         interpreter.next_block = 0;
 
+        if (ENABLE_BASELINEJIT && !FORCE_INTERPRETER) {
+            CFGBlock* block = interpreter.current_block;
+            std::vector<JitCodeBlock*>& jit_code = interpreter.compiled_func->baseline_jit_code;
+            JitCodeBlock* code = block->idx < jit_code.size() ? jit_code[block->idx] : NULL;
+            if (!code && ++block->times_entered >= BASELINEJIT_THRESHOLD && !interpreter.compiled_func->retired) {
+                interpreter.compileBlock(block);
+                code = block->idx < jit_code.size() ? jit_code[block->idx] : NULL;
+            }
+
+            if (code) {
+                try {
+                    // Like the OSR exit in visit_jump, this might hand us something that isn't a valid Box*:
+                    v = (intptr_t)code->call(&interpreter);
+                } catch (ExcInfo e) {
+                    v = interpreter.handleBytecodeException(block, e);
+                }
+                continue;
+            }
+        }
+
+        if (ENABLE_BYTECODE_INTERPRETER) {
+            v = interpreter.executeBytecode(interpreter.current_block);
+            continue;
+        }
+
         for (AST_stmt* s : interpreter.current_block->body) {
             interpreter.current_inst = s;
             v = interpreter.visit_stmt(s);
@@ -331,6 +421,448 @@ Value ASTInterpreter::execute(ASTInterpreter& interpreter, CFGBlock* start_block
     return v;
 }
 
+int ASTInterpreter::getLocalSlot(InternedString name) {
+    int slot = scope_info->getFastLocalSlot(name);
+    RELEASE_ASSERT(slot >= 0 && slot < bytecode->num_locals, "'%s' doesn't have a register", name.c_str());
+    return slot;
+}
+
+int ASTInterpreter::getLocalSlot(AST_Name* node) {
+    if (node->vreg == -1)
+        node->vreg = getLocalSlot(node->id);
+    return node->vreg;
+}
+
+void ASTInterpreter::raiseUnboundLocal(uint32_t slot) {
+    // Temporaries always get set before they get read:
+    assert(slot < bytecode->num_locals);
+    assertNameDefined(0, scope_info->getFastLocalName(slot).c_str(), UnboundLocalError, true);
+    abort();
+}
+
+Box* ASTInterpreter::getOperand(uint32_t arg) {
+    if (arg & BYTECODE_CONST_BIT)
+        return bytecode->constants[arg & ~BYTECODE_CONST_BIT];
+    Box* val = vregs[arg];
+    if (unlikely(!val))
+        raiseUnboundLocal(arg);
+    return val;
+}
+
+Value ASTInterpreter::handleBytecodeException(CFGBlock* block, ExcInfo e) {
+    const BytecodeFunction::BlockInfo& info = bytecode->blocks[block->idx];
+    assert(current_pc);
+    uint32_t offset = current_pc - &bytecode->code[0];
+    current_pc = NULL;
+    if (!info.invoke || offset < info.invoke_start)
+        throw e;
+
+    next_block = info.invoke->exc_dest;
+    last_exception = e;
+    return Value();
+}
+
+Value ASTInterpreter::executeBytecode(CFGBlock* block, const uint32_t* start, const uint32_t* stop) {
+    const BytecodeFunction::BlockInfo& info = bytecode->blocks[block->idx];
+    const uint32_t* code = &bytecode->code[0];
+    const uint32_t* pc = start ? start : code + info.start;
+    Box** regs = vregs;
+    Box* const* consts = bytecode->constants.data();
+    const InternedString* names = bytecode->names.data();
+    Value last;
+
+    auto operand = [=](uint32_t arg) -> Box* {
+        if (arg & BYTECODE_CONST_BIT)
+            return consts[arg & ~BYTECODE_CONST_BIT];
+        Box* val = regs[arg];
+        if (unlikely(!val))
+            raiseUnboundLocal(arg);
+        return val;
+    };
+
+    static const void* const dispatch_table[] = {
+#define DISPATCH_LABEL(name) &&op_##name,
+        BYTECODE_OPCODES(DISPATCH_LABEL)
+#undef DISPATCH_LABEL
+    };
+    static_assert(sizeof(dispatch_table) / sizeof(dispatch_table[0]) == (int)BytecodeOp::NUM_OPCODES, "");
+
+// current_pc is what getCurrentStatement() uses to find the statement for tracebacks.
+#define DISPATCH()                                                                                                     \
+    do {                                                                                                               \
+        current_pc = pc;                                                                                               \
+        goto* dispatch_table[*pc];                                                                                     \
+    } while (0)
+#define NEXT(n)                                                                                                        \
+    do {                                                                                                               \
+        pc += (n);                                                                                                     \
+        if (unlikely(pc == stop))                                                                                      \
+            return last;                                                                                               \
+        DISPATCH();                                                                                                    \
+    } while (0)
+
+    // Operands get read in the order their expressions appear in the source, so that the first undefined local is
+    // the one that gets reported.  The destination only gets written once all operands have been read, since it
+    // can be one of them.
+    try {
+        DISPATCH();
+
+    op_MOVE:
+        regs[pc[1]] = operand(pc[2]);
+        NEXT(3);
+    op_LOAD_GLOBAL:
+        regs[pc[1]] = getGlobal(globals, &names[pc[2]].str());
+        NEXT(3);
+    op_STORE_GLOBAL:
+        setGlobal(globals, names[pc[1]].str(), operand(pc[2]));
+        NEXT(3);
+    op_LOAD_DEREF: {
+        assert(passed_closure);
+        BoxedClosure* closure = passed_closure;
+        for (uint32_t i = 0; i < pc[2]; i++)
+            closure = closure->parent;
+        Box* val = closure->elts[pc[3]];
+        if (val == NULL) {
+            raiseExcHelper(NameError, "free variable '%s' referenced before assignment in enclosing scope",
+                           names[pc[4]].c_str());
+        }
+        regs[pc[1]] = val;
+        NEXT(5);
+    }
+    op_LOAD_NAME:
+        regs[pc[1]] = boxedLocalsGet(frame_info.boxedLocals, names[pc[2]].c_str(), globals);
+        NEXT(3);
+    op_STORE_NAME:
+        assert(frame_info.boxedLocals != NULL);
+        setitem(frame_info.boxedLocals, operand(pc[1]), operand(pc[2]));
+        NEXT(3);
+    op_STORE_CLOSURE:
+        created_closure->elts[pc[1]] = operand(pc[2]);
+        NEXT(3);
+    op_GETATTR:
+        regs[pc[1]] = getattr(operand(pc[2]), names[pc[3]].c_str());
+        NEXT(4);
+    op_GETCLSATTR:
+        regs[pc[1]] = getclsattr(operand(pc[2]), names[pc[3]].c_str());
+        NEXT(4);
+    op_SETATTR: {
+        Box* value = operand(pc[3]);
+        Box* obj = operand(pc[1]);
+        setattr(obj, names[pc[2]].c_str(), value);
+        NEXT(4);
+    }
+    op_GETITEM: {
+        Box* obj = operand(pc[2]);
+        Box* slice = operand(pc[3]);
+        regs[pc[1]] = getitem(obj, slice);
+        NEXT(4);
+    }
+    op_SETITEM: {
+        Box* value = operand(pc[3]);
+        Box* obj = operand(pc[1]);
+        Box* slice = operand(pc[2]);
+        setitem(obj, slice, value);
+        NEXT(4);
+    }
+    op_BINOP: {
+        Box* lhs = operand(pc[2]);
+        Box* rhs = operand(pc[3]);
+        regs[pc[1]] = binop(lhs, rhs, pc[4]);
+        NEXT(5);
+    }
+    op_AUGBINOP: {
+        Box* lhs = operand(pc[2]);
+        Box* rhs = operand(pc[3]);
+        regs[pc[1]] = augbinop(lhs, rhs, pc[4]);
+        NEXT(5);
+    }
+    op_COMPARE: {
+        Box* lhs = operand(pc[2]);
+        Box* rhs = operand(pc[3]);
+        regs[pc[1]] = compare(lhs, rhs, pc[4]);
+        NEXT(5);
+    }
+    op_UNARYOP:
+        regs[pc[1]] = unaryop(operand(pc[2]), pc[3]);
+        NEXT(4);
+    op_NOT:
+        regs[pc[1]] = boxBool(!nonzero(operand(pc[2])));
+        NEXT(3);
+    op_NONZERO:
+        regs[pc[1]] = boxBool(nonzero(operand(pc[2])));
+        NEXT(3);
+    op_GET_ITER:
+        regs[pc[1]] = getPystonIter(operand(pc[2]));
+        NEXT(3);
+    op_HASNEXT:
+        regs[pc[1]] = boxBool(hasnext(operand(pc[2])));
+        NEXT(3);
+    op_CALL: {
+        Box* func = operand(pc[2]);
+        int nargs = pc[3];
+        llvm::SmallVector<Box*, 8> args;
+        for (int i = 0; i < nargs; i++)
+            args.push_back(operand(pc[4 + i]));
+        args.resize(std::max(nargs, 3), NULL);
+
+        regs[pc[1]]
+            = runtimeCall(func, ArgPassSpec(nargs), args[0], args[1], args[2], nargs > 3 ? &args[3] : NULL, NULL);
+        NEXT(4 + nargs);
+    }
+    op_CALLATTR: {
+        Box* obj = operand(pc[2]);
+        int nargs = pc[5];
+        llvm::SmallVector<Box*, 8> args;
+        for (int i = 0; i < nargs; i++)
+            args.push_back(operand(pc[6 + i]));
+        args.resize(std::max(nargs, 3), NULL);
+
+        regs[pc[1]] = callattr(obj, &names[pc[3]].str(),
+                               CallattrFlags({.cls_only = (bool)pc[4], .null_on_nonexistent = false }),
+                               ArgPassSpec(nargs), args[0], args[1], args[2], nargs > 3 ? &args[3] : NULL, NULL);
+        NEXT(6 + nargs);
+    }
+    op_BUILD_TUPLE: {
+        int n = pc[2];
+        BoxedTuple* rtn = BoxedTuple::create(n);
+        for (int i = 0; i < n; i++)
+            rtn->elts[i] = operand(pc[3 + i]);
+        regs[pc[1]] = rtn;
+        NEXT(3 + n);
+    }
+    op_BUILD_LIST: {
+        int n = pc[2];
+        BoxedList* rtn = new BoxedList;
+        rtn->ensure(n);
+        for (int i = 0; i < n; i++)
+            listAppendInternal(rtn, operand(pc[3 + i]));
+        regs[pc[1]] = rtn;
+        NEXT(3 + n);
+    }
+    op_BUILD_DICT: {
+        int n = pc[2];
+        BoxedDict* rtn = new BoxedDict();
+        for (int i = 0; i < n; i++) {
+            Box* v = operand(pc[3 + 2 * i]);
+            Box* k = operand(pc[4 + 2 * i]);
+            rtn->d[k] = v;
+        }
+        regs[pc[1]] = rtn;
+        NEXT(3 + 2 * n);
+    }
+    op_BUILD_SLICE: {
+        Box* lower = operand(pc[2]);
+        Box* upper = operand(pc[3]);
+        Box* step = operand(pc[4]);
+        regs[pc[1]] = createSlice(lower, upper, step);
+        NEXT(5);
+    }
+    op_UNPACK: {
+        int n = pc[2];
+        Box** array = unpackIntoArray(operand(pc[1]), n);
+        for (int i = 0; i < n; i++)
+            regs[pc[3 + i]] = array[i];
+        NEXT(3 + n);
+    }
+    op_EVAL:
+        regs[pc[1]] = visit_expr(bytecode->exprs[pc[2]]).o;
+        NEXT(3);
+    op_STORE_EXPR:
+        doStore(bytecode->exprs[pc[1]], operand(pc[2]));
+        NEXT(3);
+    op_STMT:
+        last = visit_stmt(bytecode->stmts[pc[1]]);
+        NEXT(2);
+    op_BRANCH: {
+        Box* cond = operand(pc[1]);
+        ASSERT(cond == True || cond == False, "Should have called NONZERO before this branch");
+        AST_Branch* branch = ast_cast<AST_Branch>(bytecode->stmts[pc[2]]);
+        next_block = cond == True ? branch->iftrue : branch->iffalse;
+        current_pc = NULL;
+        return Value();
+    }
+    op_JUMP: {
+        Value rtn = visit_jump(ast_cast<AST_Jump>(bytecode->stmts[pc[1]]));
+        current_pc = NULL;
+        return rtn;
+    }
+    op_INVOKE_DONE:
+        next_block = ast_cast<AST_Invoke>(bytecode->stmts[pc[1]])->normal_dest;
+        current_pc = NULL;
+        return last;
+    op_RETURN: {
+        Box* rtn = operand(pc[1]);
+        next_block = 0;
+        current_pc = NULL;
+        return rtn;
+    }
+    op_END:
+        current_pc = NULL;
+        return last;
+    } catch (ExcInfo e) {
+        if (start)
+            throw e;
+        return handleBytecodeException(block, e);
+    }
+
+#undef DISPATCH
+#undef NEXT
+}
+
+void ASTInterpreter::compileBlock(CFGBlock* block) {
+    // Other threads can be looking at the version's baseline_jit_code:
+    threading::GLPromoteRegion _gl_lock;
+    // promoteGL can drop the lock, so another thread might have compiled the block (or retired the version) already:
+    std::vector<JitCodeBlock*>& jit_code = compiled_func->baseline_jit_code;
+    if (compiled_func->retired || (block->idx < jit_code.size() && jit_code[block->idx]))
+        return;
+
+    const BytecodeFunction::BlockInfo& info = bytecode->blocks[block->idx];
+    const uint32_t* pc = &bytecode->code[info.start];
+    const InternedString* names = bytecode->names.data();
+
+    JitFragmentWriter writer;
+    // The instructions since the last one that got its own helper, which get run by the bytecode interpreter:
+    const uint32_t* run_start = pc;
+    while (true) {
+        BytecodeOp op = (BytecodeOp)*pc;
+        if (op == BytecodeOp::BRANCH || op == BytecodeOp::JUMP || op == BytecodeOp::INVOKE_DONE
+            || op == BytecodeOp::RETURN || op == BytecodeOp::END)
+            break;
+
+        void* helper = NULL;
+        void* ic = NULL;
+        switch (op) {
+            case BytecodeOp::GETATTR:
+                helper = (void*)jitGetattr;
+                ic = writer.addIC(new GetattrIC(names[pc[3]].str()));
+                break;
+            case BytecodeOp::SETATTR:
+                helper = (void*)jitSetattr;
+                ic = writer.addIC(new SetattrIC(names[pc[2]].str()));
+                break;
+            case BytecodeOp::GETITEM:
+                helper = (void*)jitGetitem;
+                ic = writer.addIC(new GetitemIC());
+                break;
+            case BytecodeOp::SETITEM:
+                helper = (void*)jitSetitem;
+                ic = writer.addIC(new SetitemIC());
+                break;
+            case BytecodeOp::BINOP:
+                helper = (void*)jitBinop;
+                ic = writer.addIC(new BinopIC());
+                break;
+            case BytecodeOp::COMPARE:
+                helper = (void*)jitCompare;
+                ic = writer.addIC(new CompareIC(pc[4]));
+                break;
+            case BytecodeOp::NONZERO:
+                helper = (void*)jitNonzero;
+                ic = writer.addIC(new NonzeroIC());
+                break;
+            case BytecodeOp::CALLATTR:
+                if (pc[5] <= 3) {
+                    helper = (void*)jitCallattr;
+                    ic = writer.addIC(new CallattrIC());
+                }
+                break;
+            default:
+                break;
+        }
+
+        if (helper) {
+            if (run_start != pc)
+                writer.emitCall((void*)jitRunBytecode, (void*)run_start, (void*)pc);
+            writer.emitCall(helper, (void*)pc, ic);
+        }
+
+        pc += BytecodeFunction::instructionLength(pc);
+        if (helper)
+            run_start = pc;
+    }
+    // The rest of the block, including its terminator, which sets next_block:
+    writer.emitCall((void*)jitRunBytecode, (void*)run_start, NULL);
+
+    LOCK_REGION(codegen_rwlock.asWrite());
+    noteBaselineJitCode(compiled_func, block->idx, writer.finish());
+}
+
+Box* ASTInterpreter::jitRunBytecode(ASTInterpreter* interp, const uint32_t* start, const uint32_t* stop) {
+    return interp->executeBytecode(interp->current_block, start, stop).o;
+}
+
+// These do the same as the corresponding instructions in executeBytecode, except through their IC; they read the
+// operands in the same order so that the same local gets reported as unbound.
+
+Box* ASTInterpreter::jitGetattr(ASTInterpreter* interp, const uint32_t* pc, GetattrIC* ic) {
+    interp->current_pc = pc;
+    interp->vregs[pc[1]] = ic->call(interp->getOperand(pc[2]));
+    return NULL;
+}
+
+Box* ASTInterpreter::jitSetattr(ASTInterpreter* interp, const uint32_t* pc, SetattrIC* ic) {
+    interp->current_pc = pc;
+    Box* value = interp->getOperand(pc[3]);
+    Box* obj = interp->getOperand(pc[1]);
+    ic->call(obj, value);
+    return NULL;
+}
+
+Box* ASTInterpreter::jitGetitem(ASTInterpreter* interp, const uint32_t* pc, GetitemIC* ic) {
+    interp->current_pc = pc;
+    Box* obj = interp->getOperand(pc[2]);
+    Box* slice = interp->getOperand(pc[3]);
+    interp->vregs[pc[1]] = ic->call(obj, slice);
+    return NULL;
+}
+
+Box* ASTInterpreter::jitSetitem(ASTInterpreter* interp, const uint32_t* pc, SetitemIC* ic) {
+    interp->current_pc = pc;
+    Box* value = interp->getOperand(pc[3]);
+    Box* obj = interp->getOperand(pc[1]);
+    Box* slice = interp->getOperand(pc[2]);
+    ic->call(obj, slice, value);
+    return NULL;
+}
+
+Box* ASTInterpreter::jitBinop(ASTInterpreter* interp, const uint32_t* pc, BinopIC* ic) {
+    interp->current_pc = pc;
+    Box* lhs = interp->getOperand(pc[2]);
+    Box* rhs = interp->getOperand(pc[3]);
+    interp->vregs[pc[1]] = ic->call(lhs, rhs, pc[4]);
+    return NULL;
+}
+
+Box* ASTInterpreter::jitCompare(ASTInterpreter* interp, const uint32_t* pc, CompareIC* ic) {
+    interp->current_pc = pc;
+    Box* lhs = interp->getOperand(pc[2]);
+    Box* rhs = interp->getOperand(pc[3]);
+    interp->vregs[pc[1]] = ic->call(lhs, rhs);
+    return NULL;
+}
+
+Box* ASTInterpreter::jitNonzero(ASTInterpreter* interp, const uint32_t* pc, NonzeroIC* ic) {
+    interp->current_pc = pc;
+    interp->vregs[pc[1]] = boxBool(ic->call(interp->getOperand(pc[2])));
+    return NULL;
+}
+
+Box* ASTInterpreter::jitCallattr(ASTInterpreter* interp, const uint32_t* pc, CallattrIC* ic) {
+    interp->current_pc = pc;
+    Box* obj = interp->getOperand(pc[2]);
+    int nargs = pc[5];
+    assert(nargs <= 3);
+    Box* args[3] = { NULL, NULL, NULL };
+    for (int i = 0; i < nargs; i++)
+        args[i] = interp->getOperand(pc[6 + i]);
+
+    interp->vregs[pc[1]] = ic->call(obj, &interp->bytecode->names[pc[3]].str(),
+                                    CallattrFlags({.cls_only = (bool)pc[4], .null_on_nonexistent = false }),
+                                    ArgPassSpec(nargs), args[0], args[1], args[2], NULL, NULL);
+    return NULL;
+}
+
 Value ASTInterpreter::doBinOp(Box* left, Box* right, int op, BinExpType exp_type) {
     if (op == AST_TYPE::Div && (source_info->parent_module->future_flags & FF_DIVISION)) {
         op = AST_TYPE::TrueDiv;
@@ -357,17 +889,31 @@ void ASTInterpreter::doStore(InternedString name, Value value) {
         // TODO should probably pre-box the names when it's a scope that usesNameLookup
         setitem(frame_info.boxedLocals, boxString(name.str()), value.o);
     } else {
-        sym_table[name] = value.o;
+        vregs[getLocalSlot(name)] = value.o;
         if (vst == ScopeInfo::VarScopeType::CLOSURE) {
             created_closure->elts[scope_info->getClosureOffset(name)] = value.o;
         }
     }
 }
 
+void ASTInterpreter::doStore(AST_Name* node, Value value) {
+    if (node->lookup_type == ScopeInfo::VarScopeType::UNKNOWN)
+        node->lookup_type = scope_info->getScopeTypeOfName(node->id);
+
+    if (node->lookup_type == ScopeInfo::VarScopeType::FAST) {
+        vregs[getLocalSlot(node)] = value.o;
+    } else if (node->lookup_type == ScopeInfo::VarScopeType::CLOSURE) {
+        vregs[getLocalSlot(node)] = value.o;
+        created_closure->elts[scope_info->getClosureOffset(node->id)] = value.o;
+    } else {
+        doStore(node->id, value);
+    }
+}
+
 void ASTInterpreter::doStore(AST_expr* node, Value value) {
     if (node->type == AST_TYPE::Name) {
         AST_Name* name = (AST_Name*)node;
-        doStore(name->id, value);
+        doStore(name, value);
     } else if (node->type == AST_TYPE::Attribute) {
         AST_Attribute* attr = (AST_Attribute*)node;
         setattr(visit_expr(attr->value).o, attr->attr.c_str(), value.o);
@@ -437,32 +983,34 @@ Value ASTInterpreter::visit_branch(AST_Branch* node) {
 
 Value ASTInterpreter::visit_jump(AST_Jump* node) {
     bool backedge = node->target->idx < current_block->idx && compiled_func;
-    if (backedge)
+    if (backedge) {
         threading::allowGLReadPreemption();
+        ++compiled_func->times_backedges;
+    }
 
     if (ENABLE_OSR && backedge && (globals->cls == module_cls)) {
         bool can_osr = !FORCE_INTERPRETER && (globals->cls == module_cls);
-        if (can_osr && edgecount++ == OSR_THRESHOLD_INTERPRETER) {
+        if (can_osr && compiled_func->osr_threshold == 0)
+            compiled_func->osr_threshold = getOSRThreshold(source_info, compiled_func->effort);
+        if (can_osr && edgecount++ == compiled_func->osr_threshold) {
             static StatCounter ast_osrs("num_ast_osrs");
             ast_osrs.log();
 
-            // TODO: we will immediately want the liveness info again in the jit, we should pass
-            // it through.
-            std::unique_ptr<LivenessAnalysis> liveness = computeLivenessInfo(source_info->cfg);
-            std::unique_ptr<PhiAnalysis> phis
-                = computeRequiredPhis(compiled_func->clfunc->param_names, source_info->cfg, liveness.get(), scope_info);
-
-            std::vector<InternedString> dead_symbols;
-            for (auto& it : sym_table) {
-                if (!liveness->isLiveAtEnd(it.first, current_block)) {
-                    dead_symbols.push_back(it.first);
-                } else if (phis->isRequiredAfter(it.first, current_block)) {
-                    assert(scope_info->getScopeTypeOfName(it.first) != ScopeInfo::VarScopeType::GLOBAL);
+            // These get cached on the SourceInfo, so the JIT will reuse them for the OSR compile:
+            LivenessAnalysis* liveness = getLivenessInfo(source_info);
+            PhiAnalysis* phis = getRequiredPhis(compiled_func->clfunc->param_names, source_info);
+
+            for (int slot = 0; slot < bytecode->num_locals; slot++) {
+                InternedString name = scope_info->getFastLocalName(slot);
+                if (!vregs[slot])
+                    continue;
+                if (!liveness->isLiveAtEnd(name, current_block)) {
+                    vregs[slot] = NULL;
+                } else if (phis->isRequiredAfter(name, current_block)) {
+                    assert(scope_info->getScopeTypeOfName(name) != ScopeInfo::VarScopeType::GLOBAL);
                 } else {
                 }
             }
-            for (auto&& dead : dead_symbols)
-                sym_table.erase(dead);
 
             const OSREntryDescriptor* found_entry = nullptr;
             for (auto& p : compiled_func->clfunc->osr_versions) {
@@ -477,27 +1025,21 @@ Value ASTInterpreter::visit_jump(AST_Jump* node) {
             std::map<InternedString, Box*> sorted_symbol_table;
 
             for (auto& name : phis->definedness.getDefinedNamesAtEnd(current_block)) {
-                auto it = sym_table.find(name);
                 if (!liveness->isLiveAtEnd(name, current_block))
                     continue;
 
+                Box* val = vregs[getLocalSlot(name)];
                 if (phis->isPotentiallyUndefinedAfter(name, current_block)) {
-                    bool is_defined = it != sym_table.end();
+                    bool is_defined = val != NULL;
                     // TODO only mangle once
                     sorted_symbol_table[getIsDefinedName(name, source_info->getInternedStrings())] = (Box*)is_defined;
-                    if (is_defined)
-                        assert(sym_table.getMapped(it->second) != NULL);
-                    sorted_symbol_table[name] = is_defined ? sym_table.getMapped(it->second) : NULL;
+                    sorted_symbol_table[name] = val;
                 } else {
-                    ASSERT(it != sym_table.end(), "%s", name.c_str());
-                    sorted_symbol_table[it->first] = sym_table.getMapped(it->second);
+                    ASSERT(val, "%s", name.c_str());
+                    sorted_symbol_table[name] = val;
                 }
             }
 
-            // Manually free these here, since we might not return from this scope for a long time.
-            liveness.reset(nullptr);
-            phis.reset(nullptr);
-
             // LLVM has a limit on the number of operands a machine instruction can have (~255),
             // in order to not hit the limit with the patchpoints cancel OSR when we have a high number of symbols.
             if (sorted_symbol_table.size() > 225) {
@@ -864,8 +1406,11 @@ Value ASTInterpreter::visit_assert(AST_Assert* node) {
 }
 
 Value ASTInterpreter::visit_global(AST_Global* node) {
-    for (auto name : node->names)
-        sym_table.erase(name);
+    for (auto name : node->names) {
+        int slot = scope_info->getFastLocalSlot(name);
+        if (slot >= 0)
+            vregs[slot] = NULL;
+    }
     return Value();
 }
 
@@ -908,12 +1453,13 @@ Value ASTInterpreter::visit_delete(AST_Delete* node) {
                 } else {
                     assert(vst == ScopeInfo::VarScopeType::FAST);
 
-                    if (sym_table.count(target->id) == 0) {
+                    int slot = getLocalSlot(target);
+                    if (vregs[slot] == NULL) {
                         assertNameDefined(0, target->id.c_str(), NameError, true /* local_var_msg */);
                         return Value();
                     }
 
-                    sym_table.erase(target->id);
+                    vregs[slot] = NULL;
                 }
                 break;
             }
@@ -1182,9 +1728,9 @@ Value ASTInterpreter::visit_name(AST_Name* node) {
         }
         case ScopeInfo::VarScopeType::FAST:
         case ScopeInfo::VarScopeType::CLOSURE: {
-            SymMap::iterator it = sym_table.find(node->id);
-            if (it != sym_table.end())
-                return sym_table.getMapped(it->second);
+            Box* val = vregs[getLocalSlot(node)];
+            if (val)
+                return val;
 
             assertNameDefined(0, node->id.c_str(), UnboundLocalError, true);
             return Value();
@@ -1225,13 +1771,19 @@ Value ASTInterpreter::visit_attribute(AST_Attribute* node) {
 }
 }
 
-const void* interpreter_instr_addr = (void*)&ASTInterpreter::execute;
+const void* interpreter_instr_addr = (void*)&executeInnerFromASM;
 
 Box* astInterpretFunction(CompiledFunction* cf, int nargs, Box* closure, Box* generator, Box* globals, Box* arg1,
                           Box* arg2, Box* arg3, Box** args) {
     assert((!globals) == cf->clfunc->source->scoping->areGlobalsFromModule());
     bool can_reopt = ENABLE_REOPT && !FORCE_INTERPRETER && (globals == NULL);
-    if (unlikely(can_reopt && cf->times_called > REOPT_THRESHOLD_INTERPRETER)) {
+    if (unlikely(can_reopt && cf->reopt_threshold == 0)) {
+        // The threshold depends on the size of the cfg, which the interpreter would compute below anyway:
+        ensureBytecode(cf->clfunc);
+        cf->reopt_threshold = getReoptThreshold(cf->clfunc->source.get(), cf->effort);
+        assert(cf->reopt_threshold > 0);
+    }
+    if (unlikely(can_reopt && getHotness(cf) > cf->reopt_threshold)) {
         assert(!globals);
         CompiledFunction* optimized = reoptCompiledFuncInternal(cf);
         if (closure && generator)
@@ -1371,52 +1923,46 @@ Box* astInterpretFrom(CompiledFunction* cf, AST_expr* after_expr, AST_stmt* encl
 }
 
 AST_stmt* getCurrentStatementForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterFromFramePtr(frame_ptr);
     return interpreter->getCurrentStatement();
 }
 
 Box* getGlobalsForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterFromFramePtr(frame_ptr);
     return interpreter->getGlobals();
 }
 
 CompiledFunction* getCFForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterFromFramePtr(frame_ptr);
     return interpreter->getCF();
 }
 
 FrameInfo* getFrameInfoForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterFromFramePtr(frame_ptr);
     return interpreter->getFrameInfo();
 }
 
 BoxedDict* localsForInterpretedFrame(void* frame_ptr, bool only_user_visible) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterFromFramePtr(frame_ptr);
     BoxedDict* rtn = new BoxedDict();
-    for (auto& l : interpreter->getSymbolTable()) {
-        if (only_user_visible && (l.first.str()[0] == '!' || l.first.str()[0] == '#'))
+    ScopeInfo* scope_info = interpreter->getScopeInfo();
+    for (int slot = 0; slot < interpreter->getBytecode()->num_locals; slot++) {
+        Box* val = interpreter->getLocal(slot);
+        if (!val)
+            continue;
+
+        InternedString name = scope_info->getFastLocalName(slot);
+        if (only_user_visible && (name.str()[0] == '!' || name.str()[0] == '#'))
             continue;
 
-        rtn->d[boxString(l.first.str())] = interpreter->getSymbolTable().getMapped(l.second);
+        rtn->d[boxString(name.str())] = val;
     }
 
     return rtn;
 }
 
 BoxedClosure* passedClosureForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterFromFramePtr(frame_ptr);
     return interpreter->getPassedClosure();
 }
-
-void gatherInterpreterRoots(GCVisitor* visitor) {
-    for (const auto& p : s_interpreterMap) {
-        p.second->gcVisit(visitor);
-    }
-}
 }
@@ -19,10 +19,6 @@
 
 namespace pyston {
 
-namespace gc {
-class GCVisitor;
-}
-
 class AST_expr;
 class AST_stmt;
 class Box;
@@ -46,7 +42,6 @@ struct FrameInfo;
 FrameInfo* getFrameInfoForInterpretedFrame(void* frame_ptr);
 BoxedClosure* passedClosureForInterpretedFrame(void* frame_ptr);
 
-void gatherInterpreterRoots(gc::GCVisitor* visitor);
 BoxedDict* localsForInterpretedFrame(void* frame_ptr, bool only_user_visible);
 }
 
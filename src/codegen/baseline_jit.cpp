@@ -0,0 +1,85 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/baseline_jit.h"
+
+#include "asm_writing/assembler.h"
+#include "core/common.h"
+#include "core/options.h"
+#include "core/stats.h"
+#include "core/util.h"
+
+namespace pyston {
+
+// The generated code uses the same frame layout as the runtime ICs, so that it can reuse their unwind info
+// (see _eh_frame_template in runtime/ics.cpp): the prologue must be exactly "sub $0x28, %rsp".
+// We use the bottom of the scratch area to hold on to the interpreter pointer across the calls.
+#define SCRATCH_BYTES 0x28
+
+static const int PROLOGUE_SIZE = 8;  // sub $0x28, %rsp; mov %rdi, (%rsp)
+static const int EPILOGUE_SIZE = 5;  // add $0x28, %rsp; retq
+static const int MAX_CALL_SIZE = 37; // mov (%rsp), %rdi; 2x movabs; movabs + callq *%r11
+
+JitCodeBlock::JitCodeBlock(void* code, int code_size, std::vector<std::unique_ptr<RuntimeIC>> ics)
+    : code(code), code_size(code_size), ics(std::move(ics)) {
+    eh_frame.writeAndRegister(code, code_size);
+}
+
+JitCodeBlock::~JitCodeBlock() {
+    free(code);
+}
+
+int64_t JitCodeBlock::getMemoryBytes() const {
+    int64_t bytes = code_size;
+    for (auto& ic : ics)
+        bytes += ic->getCodeSize();
+    return bytes;
+}
+
+JitCodeBlock* JitFragmentWriter::finish() {
+    Timer _t("baseline jit", 1000);
+
+    int total_size = PROLOGUE_SIZE + calls.size() * MAX_CALL_SIZE + EPILOGUE_SIZE;
+    // Like the runtime ICs, we rely on malloc'd memory being executable.
+    uint8_t* code = (uint8_t*)malloc(total_size);
+
+    assembler::Assembler assem(code, total_size);
+    assem.sub(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
+    assert(assem.bytesWritten() == 4);
+    assem.mov(assembler::RDI, assembler::Indirect(assembler::RSP, 0));
+
+    for (const Call& c : calls) {
+        assem.mov(assembler::Indirect(assembler::RSP, 0), assembler::RDI);
+        assem.mov(assembler::Immediate(c.arg1), assembler::RSI);
+        assem.mov(assembler::Immediate(c.arg2), assembler::RDX);
+        assem.emitCall(c.func, assembler::R11);
+    }
+
+    assem.add(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
+    assem.retq();
+    assem.fillWithNops();
+    RELEASE_ASSERT(!assem.hasFailed(), "");
+
+    JitCodeBlock* rtn = new JitCodeBlock(code, total_size, std::move(ics));
+
+    static StatCounter num_blocks("num_baselinejit_blocks");
+    num_blocks.log();
+    static StatCounter code_bytes("baselinejit_code_bytes");
+    code_bytes.log(total_size);
+    static StatCounter us_compiling("us_compiling_baselinejit");
+    us_compiling.log(_t.end());
+
+    return rtn;
+}
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_BASELINEJIT_H
+#define PYSTON_CODEGEN_BASELINEJIT_H
+
+#include <memory>
+#include <vector>
+
+#include "core/common.h"
+#include "runtime/ics.h"
+
+namespace pyston {
+
+// The baseline JIT is the tier between the bytecode interpreter and the LLVM tiers.
+//
+// It compiles one CFG block's bytecode at a time into a straight-line sequence of calls to interpreter helpers.
+// Instructions that can use a runtime IC (attribute and item accesses, binops, compares, nonzero checks and
+// callattrs) each get a helper call with their own IC, which reads its operands straight from the registers; the
+// runs of instructions in between, including the block's terminator, get handed back to the bytecode interpreter.
+// Since no real code generation happens, compiling a block only takes a few microseconds.
+//
+// The generated function takes the interpreter as its only argument and returns whatever the last helper returned.
+// Blocks belong to the CompiledFunction they were compiled for, and get freed along with its code (see
+// codegen/code_cache.h).
+class JitCodeBlock {
+private:
+    void* code;
+    int code_size;
+    EHFrameManager eh_frame;
+    std::vector<std::unique_ptr<RuntimeIC>> ics;
+
+    JitCodeBlock(const JitCodeBlock&) = delete;
+    void operator=(const JitCodeBlock&) = delete;
+
+    JitCodeBlock(void* code, int code_size, std::vector<std::unique_ptr<RuntimeIC>> ics);
+
+    friend class JitFragmentWriter;
+
+public:
+    ~JitCodeBlock();
+
+    Box* call(void* interpreter) { return reinterpret_cast<Box* (*)(void*)>(code)(interpreter); }
+    int getCodeSize() const { return code_size; }
+    // The code plus the ICs' code:
+    int64_t getMemoryBytes() const;
+};
+
+class JitFragmentWriter {
+private:
+    struct Call {
+        void* func;
+        void* arg1;
+        void* arg2;
+    };
+    std::vector<Call> calls;
+    std::vector<std::unique_ptr<RuntimeIC>> ics;
+
+public:
+    // Emits a call to func(interpreter, arg1, arg2); the arguments are baked into the code as constants.
+    void emitCall(void* func, void* arg1, void* arg2 = NULL) { calls.push_back(Call{ func, arg1, arg2 }); }
+    // The IC gets freed along with the block:
+    template <typename IC> IC* addIC(IC* ic) {
+        ics.emplace_back(ic);
+        return ic;
+    }
+
+    JitCodeBlock* finish();
+};
+
+} // namespace pyston
+
+#endif
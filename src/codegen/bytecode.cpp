@@ -0,0 +1,750 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/bytecode.h"
+
+#include <algorithm>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include "analysis/scoping_analysis.h"
+#include "codegen/irgen/future.h"
+#include "core/ast.h"
+#include "core/cfg.h"
+#include "core/common.h"
+#include "core/stats.h"
+#include "core/types.h"
+#include "gc/collector.h"
+#include "runtime/inline/boxing.h"
+#include "runtime/long.h"
+#include "runtime/types.h"
+
+namespace pyston {
+
+AST_stmt* BytecodeFunction::getStatementAt(const uint32_t* pc) const {
+    uint32_t offset = pc - &code[0];
+    auto it = std::upper_bound(stmt_starts.begin(), stmt_starts.end(), std::make_pair(offset, (AST_stmt*)NULL),
+                               [](const std::pair<uint32_t, AST_stmt*>& lhs,
+                                  const std::pair<uint32_t, AST_stmt*>& rhs) { return lhs.first < rhs.first; });
+    assert(it != stmt_starts.begin());
+    return (it - 1)->second;
+}
+
+int BytecodeFunction::instructionLength(const uint32_t* pc) {
+    switch ((BytecodeOp)pc[0]) {
+        case BytecodeOp::END:
+            return 1;
+        case BytecodeOp::STMT:
+        case BytecodeOp::JUMP:
+        case BytecodeOp::INVOKE_DONE:
+        case BytecodeOp::RETURN:
+            return 2;
+        case BytecodeOp::MOVE:
+        case BytecodeOp::LOAD_GLOBAL:
+        case BytecodeOp::STORE_GLOBAL:
+        case BytecodeOp::LOAD_NAME:
+        case BytecodeOp::STORE_NAME:
+        case BytecodeOp::STORE_CLOSURE:
+        case BytecodeOp::NOT:
+        case BytecodeOp::NONZERO:
+        case BytecodeOp::GET_ITER:
+        case BytecodeOp::HASNEXT:
+        case BytecodeOp::EVAL:
+        case BytecodeOp::STORE_EXPR:
+        case BytecodeOp::BRANCH:
+            return 3;
+        case BytecodeOp::GETATTR:
+        case BytecodeOp::GETCLSATTR:
+        case BytecodeOp::SETATTR:
+        case BytecodeOp::GETITEM:
+        case BytecodeOp::SETITEM:
+        case BytecodeOp::UNARYOP:
+            return 4;
+        case BytecodeOp::LOAD_DEREF:
+        case BytecodeOp::BINOP:
+        case BytecodeOp::AUGBINOP:
+        case BytecodeOp::COMPARE:
+        case BytecodeOp::BUILD_SLICE:
+            return 5;
+        case BytecodeOp::CALL:
+            return 4 + pc[3];
+        case BytecodeOp::CALLATTR:
+            return 6 + pc[5];
+        case BytecodeOp::BUILD_TUPLE:
+        case BytecodeOp::BUILD_LIST:
+        case BytecodeOp::UNPACK:
+            return 3 + pc[2];
+        case BytecodeOp::BUILD_DICT:
+            return 3 + 2 * pc[2];
+        default:
+            RELEASE_ASSERT(0, "%d", pc[0]);
+    }
+}
+
+namespace {
+
+// Finds the names that get used in this scope, without going into the bodies of nested scopes
+// (the CFG has already moved everything that gets evaluated in this scope out of the nested scopes' nodes).
+class NameCollector : public ASTVisitor {
+public:
+    std::vector<AST_Name*> names;
+
+    bool visit_name(AST_Name* node) override {
+        names.push_back(node);
+        return false;
+    }
+
+    bool visit_makefunction(AST_MakeFunction* node) override {
+        for (AST_expr* d : node->function_def->decorator_list)
+            d->accept(this);
+        for (AST_expr* d : node->function_def->args->defaults)
+            d->accept(this);
+        return true;
+    }
+
+    bool visit_makeclass(AST_MakeClass* node) override {
+        for (AST_expr* b : node->class_def->bases)
+            b->accept(this);
+        for (AST_expr* d : node->class_def->decorator_list)
+            d->accept(this);
+        return true;
+    }
+
+    bool visit_lambda(AST_Lambda* node) override {
+        for (AST_expr* d : node->args->defaults)
+            d->accept(this);
+        return true;
+    }
+};
+
+class BytecodeLowering {
+private:
+    SourceInfo* source;
+    const ParamNames& param_names;
+    ScopeInfo* scope_info;
+    BytecodeFunction* bc;
+    bool future_division;
+
+    int next_temp;
+    llvm::DenseMap<Box*, int> constant_indices;
+    llvm::DenseMap<InternedString, int> name_indices;
+
+    void emit(BytecodeOp op) { bc->code.push_back((uint32_t)op); }
+    void emit(uint32_t arg) { bc->code.push_back(arg); }
+
+    uint32_t allocTemp() {
+        int r = next_temp++;
+        bc->num_regs = std::max(bc->num_regs, next_temp);
+        return r;
+    }
+
+    uint32_t addConstant(Box* b) {
+        auto it = constant_indices.find(b);
+        if (it != constant_indices.end())
+            return it->second | BYTECODE_CONST_BIT;
+
+        gc::registerPermanentRoot(b, /* allow_duplicates */ true);
+        int idx = bc->constants.size();
+        bc->constants.push_back(b);
+        constant_indices[b] = idx;
+        return idx | BYTECODE_CONST_BIT;
+    }
+
+    uint32_t addName(InternedString name) {
+        auto it = name_indices.find(name);
+        if (it != name_indices.end())
+            return it->second;
+
+        int idx = bc->names.size();
+        bc->names.push_back(name);
+        name_indices[name] = idx;
+        return idx;
+    }
+
+    uint32_t addStmt(AST_stmt* node) {
+        bc->stmts.push_back(node);
+        return bc->stmts.size() - 1;
+    }
+
+    uint32_t addExpr(AST_expr* node) {
+        bc->exprs.push_back(node);
+        return bc->exprs.size() - 1;
+    }
+
+    ScopeInfo::VarScopeType getScopeType(AST_Name* node) {
+        // Same caching as the tree-walking interpreter does:
+        if (node->lookup_type == ScopeInfo::VarScopeType::UNKNOWN)
+            node->lookup_type = scope_info->getScopeTypeOfName(node->id);
+        return node->lookup_type;
+    }
+
+    // Returns the register of a FAST or CLOSURE name, or -1.
+    int getLocalSlot(AST_expr* node) {
+        if (node->type != AST_TYPE::Name)
+            return -1;
+        AST_Name* name = ast_cast<AST_Name>(node);
+        ScopeInfo::VarScopeType vst = getScopeType(name);
+        if (vst != ScopeInfo::VarScopeType::FAST && vst != ScopeInfo::VarScopeType::CLOSURE)
+            return -1;
+        if (name->vreg == -1)
+            name->vreg = scope_info->getFastLocalSlot(name->id);
+        assert(name->vreg >= 0);
+        return name->vreg;
+    }
+
+    bool getConstant(AST_expr* node, uint32_t* operand) {
+        if (node->type == AST_TYPE::Num) {
+            AST_Num* num = ast_cast<AST_Num>(node);
+            if (num->num_type == AST_Num::INT)
+                *operand = addConstant(boxInt(num->n_int));
+            else if (num->num_type == AST_Num::FLOAT)
+                *operand = addConstant(boxFloat(num->n_float));
+            else if (num->num_type == AST_Num::LONG)
+                *operand = addConstant(createLong(&num->n_long));
+            else if (num->num_type == AST_Num::COMPLEX)
+                *operand = addConstant(boxComplex(0.0, num->n_float));
+            else
+                return false;
+            return true;
+        }
+
+        if (node->type == AST_TYPE::Str) {
+            AST_Str* str = ast_cast<AST_Str>(node);
+            if (str->str_type == AST_Str::STR)
+                *operand = addConstant(source->parent_module->getStringConstant(str->str_data));
+            else if (str->str_type == AST_Str::UNICODE)
+                *operand = addConstant(decodeUTF8StringPtr(&str->str_data));
+            else
+                return false;
+            return true;
+        }
+
+        if (node->type == AST_TYPE::LangPrimitive
+            && ast_cast<AST_LangPrimitive>(node)->opcode == AST_LangPrimitive::NONE) {
+            *operand = addConstant(None);
+            return true;
+        }
+
+        return false;
+    }
+
+    static bool isConstant(AST_expr* node) {
+        if (node->type == AST_TYPE::Num)
+            return true;
+        if (node->type == AST_TYPE::Str)
+            return true;
+        return node->type == AST_TYPE::LangPrimitive
+               && ast_cast<AST_LangPrimitive>(node)->opcode == AST_LangPrimitive::NONE;
+    }
+
+    bool isSimpleOperand(AST_expr* node) { return isConstant(node) || getLocalSlot(node) >= 0; }
+
+    // Returns an operand holding the value of node: a constant, the register of a local, or a temporary that
+    // the value gets computed into.
+    uint32_t lowerOperand(AST_expr* node) {
+        uint32_t operand;
+        if (getConstant(node, &operand))
+            return operand;
+
+        int slot = getLocalSlot(node);
+        if (slot >= 0)
+            return slot;
+
+        uint32_t tmp = allocTemp();
+        lowerExpr(node, tmp);
+        return tmp;
+    }
+
+    // Lowers the nodes left to right.
+    // Locals don't get copied into a temporary, so they get read when the instruction runs; if anything after
+    // them has to be evaluated first, copy them, so that they get read (and checked for being defined) in order.
+    void lowerOperands(llvm::ArrayRef<AST_expr*> nodes, llvm::SmallVectorImpl<uint32_t>& operands) {
+        int last_complex = -1;
+        for (int i = 0; i < nodes.size(); i++) {
+            if (!isSimpleOperand(nodes[i]))
+                last_complex = i;
+        }
+
+        for (int i = 0; i < nodes.size(); i++) {
+            int slot = getLocalSlot(nodes[i]);
+            if (slot >= 0 && i < last_complex) {
+                uint32_t tmp = allocTemp();
+                emit(BytecodeOp::MOVE);
+                emit(tmp);
+                emit(slot);
+                operands.push_back(tmp);
+            } else {
+                operands.push_back(lowerOperand(nodes[i]));
+            }
+        }
+    }
+
+    void emitEval(AST_expr* node, uint32_t dst) {
+        static StatCounter num_fallbacks("interpreter_bytecode_eval_fallbacks");
+        num_fallbacks.log();
+
+        emit(BytecodeOp::EVAL);
+        emit(dst);
+        emit(addExpr(node));
+    }
+
+    int getOpType(int op_type) {
+        if (op_type == AST_TYPE::Div && future_division)
+            return AST_TYPE::TrueDiv;
+        return op_type;
+    }
+
+    void lowerName(AST_Name* node, uint32_t dst) {
+        switch (getScopeType(node)) {
+            case ScopeInfo::VarScopeType::FAST:
+            case ScopeInfo::VarScopeType::CLOSURE:
+                emit(BytecodeOp::MOVE);
+                emit(dst);
+                emit(getLocalSlot(node));
+                break;
+            case ScopeInfo::VarScopeType::GLOBAL:
+                emit(BytecodeOp::LOAD_GLOBAL);
+                emit(dst);
+                emit(addName(node->id));
+                break;
+            case ScopeInfo::VarScopeType::DEREF: {
+                DerefInfo deref_info = scope_info->getDerefInfo(node->id);
+                emit(BytecodeOp::LOAD_DEREF);
+                emit(dst);
+                emit(deref_info.num_parents_from_passed_closure);
+                emit(deref_info.offset);
+                emit(addName(node->id));
+                break;
+            }
+            case ScopeInfo::VarScopeType::NAME:
+                emit(BytecodeOp::LOAD_NAME);
+                emit(dst);
+                emit(addName(node->id));
+                break;
+            default:
+                RELEASE_ASSERT(0, "%d", (int)node->lookup_type);
+        }
+    }
+
+    void lowerCall(AST_Call* node, uint32_t dst) {
+        if (!node->keywords.empty() || node->starargs || node->kwargs) {
+            emitEval(node, dst);
+            return;
+        }
+
+        bool is_callattr = node->func->type == AST_TYPE::Attribute || node->func->type == AST_TYPE::ClsAttribute;
+
+        std::vector<AST_expr*> nodes;
+        InternedString attr;
+        if (node->func->type == AST_TYPE::Attribute) {
+            nodes.push_back(ast_cast<AST_Attribute>(node->func)->value);
+            attr = ast_cast<AST_Attribute>(node->func)->attr;
+        } else if (node->func->type == AST_TYPE::ClsAttribute) {
+            nodes.push_back(ast_cast<AST_ClsAttribute>(node->func)->value);
+            attr = ast_cast<AST_ClsAttribute>(node->func)->attr;
+        } else {
+            nodes.push_back(node->func);
+        }
+        nodes.insert(nodes.end(), node->args.begin(), node->args.end());
+
+        llvm::SmallVector<uint32_t, 8> operands;
+        lowerOperands(nodes, operands);
+
+        if (is_callattr) {
+            emit(BytecodeOp::CALLATTR);
+            emit(dst);
+            emit(operands[0]);
+            emit(addName(attr));
+            emit(node->func->type == AST_TYPE::ClsAttribute);
+        } else {
+            emit(BytecodeOp::CALL);
+            emit(dst);
+            emit(operands[0]);
+        }
+        emit(node->args.size());
+        for (int i = 1; i < operands.size(); i++)
+            emit(operands[i]);
+    }
+
+    void lowerSequence(BytecodeOp op, const std::vector<AST_expr*>& elts, uint32_t dst) {
+        llvm::SmallVector<uint32_t, 8> operands;
+        lowerOperands(elts, operands);
+
+        emit(op);
+        emit(dst);
+        emit(elts.size());
+        for (uint32_t operand : operands)
+            emit(operand);
+    }
+
+    void lowerExpr(AST_expr* node, uint32_t dst) {
+        uint32_t constant;
+        if (getConstant(node, &constant)) {
+            emit(BytecodeOp::MOVE);
+            emit(dst);
+            emit(constant);
+            return;
+        }
+
+        llvm::SmallVector<uint32_t, 4> operands;
+        switch (node->type) {
+            case AST_TYPE::Name:
+                lowerName(ast_cast<AST_Name>(node), dst);
+                return;
+            case AST_TYPE::Attribute: {
+                AST_Attribute* attr = ast_cast<AST_Attribute>(node);
+                uint32_t obj = lowerOperand(attr->value);
+                emit(BytecodeOp::GETATTR);
+                emit(dst);
+                emit(obj);
+                emit(addName(attr->attr));
+                return;
+            }
+            case AST_TYPE::ClsAttribute: {
+                AST_ClsAttribute* attr = ast_cast<AST_ClsAttribute>(node);
+                uint32_t obj = lowerOperand(attr->value);
+                emit(BytecodeOp::GETCLSATTR);
+                emit(dst);
+                emit(obj);
+                emit(addName(attr->attr));
+                return;
+            }
+            case AST_TYPE::Subscript: {
+                AST_Subscript* subscript = ast_cast<AST_Subscript>(node);
+                lowerOperands({ subscript->value, subscript->slice }, operands);
+                emit(BytecodeOp::GETITEM);
+                emit(dst);
+                emit(operands[0]);
+                emit(operands[1]);
+                return;
+            }
+            case AST_TYPE::Index:
+                lowerExpr(ast_cast<AST_Index>(node)->value, dst);
+                return;
+            case AST_TYPE::Slice: {
+                AST_Slice* slice = ast_cast<AST_Slice>(node);
+                uint32_t none = addConstant(None);
+                for (AST_expr* e : { slice->lower, slice->upper, slice->step })
+                    operands.push_back(e ? lowerOperand(e) : none);
+                emit(BytecodeOp::BUILD_SLICE);
+                emit(dst);
+                for (uint32_t operand : operands)
+                    emit(operand);
+                return;
+            }
+            case AST_TYPE::BinOp: {
+                AST_BinOp* binop = ast_cast<AST_BinOp>(node);
+                lowerOperands({ binop->left, binop->right }, operands);
+                emit(BytecodeOp::BINOP);
+                emit(dst);
+                emit(operands[0]);
+                emit(operands[1]);
+                emit(getOpType(binop->op_type));
+                return;
+            }
+            case AST_TYPE::AugBinOp: {
+                AST_AugBinOp* binop = ast_cast<AST_AugBinOp>(node);
+                lowerOperands({ binop->left, binop->right }, operands);
+                emit(BytecodeOp::AUGBINOP);
+                emit(dst);
+                emit(operands[0]);
+                emit(operands[1]);
+                emit(getOpType(binop->op_type));
+                return;
+            }
+            case AST_TYPE::Compare: {
+                AST_Compare* cmp = ast_cast<AST_Compare>(node);
+                if (cmp->comparators.size() != 1)
+                    break;
+                lowerOperands({ cmp->left, cmp->comparators[0] }, operands);
+                emit(BytecodeOp::COMPARE);
+                emit(dst);
+                emit(operands[0]);
+                emit(operands[1]);
+                emit(cmp->ops[0]);
+                return;
+            }
+            case AST_TYPE::UnaryOp: {
+                AST_UnaryOp* unaryop = ast_cast<AST_UnaryOp>(node);
+                uint32_t operand = lowerOperand(unaryop->operand);
+                if (unaryop->op_type == AST_TYPE::Not) {
+                    emit(BytecodeOp::NOT);
+                    emit(dst);
+                    emit(operand);
+                } else {
+                    emit(BytecodeOp::UNARYOP);
+                    emit(dst);
+                    emit(operand);
+                    emit(unaryop->op_type);
+                }
+                return;
+            }
+            case AST_TYPE::Call:
+                lowerCall(ast_cast<AST_Call>(node), dst);
+                return;
+            case AST_TYPE::Tuple:
+                lowerSequence(BytecodeOp::BUILD_TUPLE, ast_cast<AST_Tuple>(node)->elts, dst);
+                return;
+            case AST_TYPE::List:
+                lowerSequence(BytecodeOp::BUILD_LIST, ast_cast<AST_List>(node)->elts, dst);
+                return;
+            case AST_TYPE::Dict: {
+                AST_Dict* dict = ast_cast<AST_Dict>(node);
+                if (dict->keys.size() != dict->values.size())
+                    break;
+                // Each value gets evaluated before its key:
+                std::vector<AST_expr*> nodes;
+                for (int i = 0; i < dict->keys.size(); i++) {
+                    nodes.push_back(dict->values[i]);
+                    nodes.push_back(dict->keys[i]);
+                }
+                lowerOperands(nodes, operands);
+                emit(BytecodeOp::BUILD_DICT);
+                emit(dst);
+                emit(dict->keys.size());
+                for (uint32_t operand : operands)
+                    emit(operand);
+                return;
+            }
+            case AST_TYPE::LangPrimitive: {
+                AST_LangPrimitive* primitive = ast_cast<AST_LangPrimitive>(node);
+                BytecodeOp op;
+                if (primitive->opcode == AST_LangPrimitive::NONZERO)
+                    op = BytecodeOp::NONZERO;
+                else if (primitive->opcode == AST_LangPrimitive::GET_ITER)
+                    op = BytecodeOp::GET_ITER;
+                else if (primitive->opcode == AST_LangPrimitive::HASNEXT)
+                    op = BytecodeOp::HASNEXT;
+                else
+                    break;
+                assert(primitive->args.size() == 1);
+                uint32_t operand = lowerOperand(primitive->args[0]);
+                emit(op);
+                emit(dst);
+                emit(operand);
+                return;
+            }
+            default:
+                break;
+        }
+
+        emitEval(node, dst);
+    }
+
+    void lowerStore(AST_expr* target, AST_expr* value) {
+        llvm::SmallVector<uint32_t, 4> operands;
+
+        if (target->type == AST_TYPE::Name) {
+            AST_Name* name = ast_cast<AST_Name>(target);
+            switch (getScopeType(name)) {
+                case ScopeInfo::VarScopeType::FAST:
+                    lowerExpr(value, getLocalSlot(name));
+                    return;
+                case ScopeInfo::VarScopeType::CLOSURE: {
+                    int slot = getLocalSlot(name);
+                    lowerExpr(value, slot);
+                    emit(BytecodeOp::STORE_CLOSURE);
+                    emit(scope_info->getClosureOffset(name->id));
+                    emit(slot);
+                    return;
+                }
+                case ScopeInfo::VarScopeType::GLOBAL: {
+                    uint32_t src = lowerOperand(value);
+                    emit(BytecodeOp::STORE_GLOBAL);
+                    emit(addName(name->id));
+                    emit(src);
+                    return;
+                }
+                case ScopeInfo::VarScopeType::NAME: {
+                    uint32_t src = lowerOperand(value);
+                    emit(BytecodeOp::STORE_NAME);
+                    emit(addConstant(boxString(name->id.str())));
+                    emit(src);
+                    return;
+                }
+                default:
+                    break;
+            }
+        } else if (target->type == AST_TYPE::Attribute) {
+            AST_Attribute* attr = ast_cast<AST_Attribute>(target);
+            lowerOperands({ value, attr->value }, operands);
+            emit(BytecodeOp::SETATTR);
+            emit(operands[1]);
+            emit(addName(attr->attr));
+            emit(operands[0]);
+            return;
+        } else if (target->type == AST_TYPE::Subscript) {
+            AST_Subscript* subscript = ast_cast<AST_Subscript>(target);
+            lowerOperands({ value, subscript->value, subscript->slice }, operands);
+            emit(BytecodeOp::SETITEM);
+            emit(operands[1]);
+            emit(operands[2]);
+            emit(operands[0]);
+            return;
+        } else if (target->type == AST_TYPE::Tuple || target->type == AST_TYPE::List) {
+            const std::vector<AST_expr*>& elts = target->type == AST_TYPE::Tuple ? ast_cast<AST_Tuple>(target)->elts
+                                                                                 : ast_cast<AST_List>(target)->elts;
+            bool all_locals = true;
+            for (AST_expr* e : elts)
+                all_locals = all_locals && getLocalSlot(e) >= 0;
+
+            if (all_locals) {
+                uint32_t src = lowerOperand(value);
+                emit(BytecodeOp::UNPACK);
+                emit(src);
+                emit(elts.size());
+                for (AST_expr* e : elts)
+                    emit(getLocalSlot(e));
+
+                for (AST_expr* e : elts) {
+                    AST_Name* name = ast_cast<AST_Name>(e);
+                    if (getScopeType(name) == ScopeInfo::VarScopeType::CLOSURE) {
+                        emit(BytecodeOp::STORE_CLOSURE);
+                        emit(scope_info->getClosureOffset(name->id));
+                        emit(getLocalSlot(name));
+                    }
+                }
+                return;
+            }
+        }
+
+        uint32_t src = lowerOperand(value);
+        emit(BytecodeOp::STORE_EXPR);
+        emit(addExpr(target));
+        emit(src);
+    }
+
+    void lowerStmt(AST_stmt* node, BytecodeFunction::BlockInfo& info) {
+        next_temp = bc->num_locals;
+
+        switch (node->type) {
+            case AST_TYPE::Assign: {
+                AST_Assign* asgn = ast_cast<AST_Assign>(node);
+                assert(asgn->targets.size() == 1 && "cfg should have lowered it to a single target");
+                lowerStore(asgn->targets[0], asgn->value);
+                return;
+            }
+            case AST_TYPE::Expr: {
+                AST_expr* value = ast_cast<AST_Expr>(node)->value;
+                // Docstrings don't get evaluated:
+                if (value->type != AST_TYPE::Str)
+                    lowerExpr(value, allocTemp());
+                return;
+            }
+            case AST_TYPE::Pass:
+                return;
+            case AST_TYPE::Return: {
+                AST_Return* ret = ast_cast<AST_Return>(node);
+                uint32_t src = ret->value ? lowerOperand(ret->value) : addConstant(None);
+                emit(BytecodeOp::RETURN);
+                emit(src);
+                return;
+            }
+            case AST_TYPE::Branch: {
+                AST_Branch* branch = ast_cast<AST_Branch>(node);
+                uint32_t cond = lowerOperand(branch->test);
+                emit(BytecodeOp::BRANCH);
+                emit(cond);
+                emit(addStmt(node));
+                return;
+            }
+            case AST_TYPE::Jump:
+                emit(BytecodeOp::JUMP);
+                emit(addStmt(node));
+                return;
+            case AST_TYPE::Invoke: {
+                AST_Invoke* invoke = ast_cast<AST_Invoke>(node);
+                info.invoke_start = bc->code.size();
+                info.invoke = invoke;
+                lowerStmt(invoke->stmt, info);
+                emit(BytecodeOp::INVOKE_DONE);
+                emit(addStmt(node));
+                return;
+            }
+            default: {
+                static StatCounter num_fallbacks("interpreter_bytecode_stmt_fallbacks");
+                num_fallbacks.log();
+
+                emit(BytecodeOp::STMT);
+                emit(addStmt(node));
+                return;
+            }
+        }
+    }
+
+    void assignLocalSlots() {
+        NameCollector collector;
+        for (CFGBlock* block : source->cfg->blocks) {
+            for (AST_stmt* stmt : block->body)
+                stmt->accept(&collector);
+        }
+
+        // This also caches the slots in the nodes that get handed to the tree-walking interpreter:
+        for (AST_Name* name : collector.names)
+            getLocalSlot(name);
+
+        // The arguments get stored even if they don't get used:
+        for (llvm::StringRef s : param_names.args)
+            scope_info->getFastLocalSlot(source->getInternedStrings().get(s));
+        if (!param_names.vararg.empty())
+            scope_info->getFastLocalSlot(source->getInternedStrings().get(param_names.vararg));
+        if (!param_names.kwarg.empty())
+            scope_info->getFastLocalSlot(source->getInternedStrings().get(param_names.kwarg));
+
+        bc->num_locals = scope_info->getNumFastLocals();
+        bc->num_regs = bc->num_locals;
+    }
+
+public:
+    BytecodeLowering(SourceInfo* source, const ParamNames& param_names)
+        : source(source),
+          param_names(param_names),
+          scope_info(source->getScopeInfo()),
+          bc(new BytecodeFunction()),
+          next_temp(0) {
+        future_division = source->parent_module->future_flags & FF_DIVISION;
+    }
+
+    BytecodeFunction* lower() {
+        assert(source->cfg);
+        assignLocalSlots();
+
+        int num_blocks = 0;
+        for (CFGBlock* block : source->cfg->blocks)
+            num_blocks = std::max(num_blocks, block->idx + 1);
+        bc->blocks.resize(num_blocks);
+
+        for (CFGBlock* block : source->cfg->blocks) {
+            BytecodeFunction::BlockInfo& info = bc->blocks[block->idx];
+            info.start = bc->code.size();
+            for (AST_stmt* stmt : block->body) {
+                bc->stmt_starts.push_back(std::make_pair((uint32_t)bc->code.size(), stmt));
+                lowerStmt(stmt, info);
+            }
+            emit(BytecodeOp::END);
+        }
+
+        static StatCounter num_words("interpreter_bytecode_words");
+        num_words.log(bc->code.size());
+        return bc;
+    }
+};
+}
+
+BytecodeFunction* lowerToBytecode(SourceInfo* source, const ParamNames& param_names) {
+    STAT_TIMER(t0, "us_timer_lower_to_bytecode");
+    return BytecodeLowering(source, param_names).lower();
+}
+}
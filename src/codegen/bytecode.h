@@ -0,0 +1,132 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_BYTECODE_H
+#define PYSTON_CODEGEN_BYTECODE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "core/stringpool.h"
+
+namespace pyston {
+
+class AST_expr;
+class AST_Invoke;
+class AST_stmt;
+class Box;
+class SourceInfo;
+struct ParamNames;
+
+// The interpreter tier runs a register-based bytecode that gets lowered from the CFG the first time a function
+// gets interpreted.
+//
+// Every FAST or CLOSURE name of the scope (including the CFG's temporaries) gets a register, numbered by the
+// scoping analysis, and the registers after those hold the temporaries of nested expressions.  Instructions are a
+// sequence of 32-bit words: the opcode followed by its operands.  An operand that gets read is either a register, or
+// (if BYTECODE_CONST_BIT is set) an index into the constant pool; names and AST nodes are indices into the tables
+// below.
+//
+// Anything the lowering doesn't handle gets evaluated by handing the AST node to the tree-walking interpreter
+// (EVAL, STMT and STORE_EXPR), which shares the register file, so every CFG can be lowered.
+//
+// Each CFG block gets lowered separately, and running a block's code ends with next_block set, same as walking the
+// block's statements; this keeps the OSR and baseline JIT logic, which works on whole blocks, the same for both.
+//
+// Operands, in order (dst is a register, anything else that holds a value is an operand):
+#define BYTECODE_OPCODES(X)                                                                                            \
+    X(MOVE)          /* dst, src */                                                                                    \
+    X(LOAD_GLOBAL)   /* dst, name */                                                                                   \
+    X(STORE_GLOBAL)  /* name, src */                                                                                   \
+    X(LOAD_DEREF)    /* dst, parents, closure offset, name */                                                          \
+    X(LOAD_NAME)     /* dst, name */                                                                                   \
+    X(STORE_NAME)    /* name constant, src */                                                                          \
+    X(STORE_CLOSURE) /* closure offset, src */                                                                         \
+    X(GETATTR)       /* dst, obj, name */                                                                              \
+    X(GETCLSATTR)    /* dst, obj, name */                                                                              \
+    X(SETATTR)       /* obj, name, value */                                                                            \
+    X(GETITEM)       /* dst, obj, slice */                                                                             \
+    X(SETITEM)       /* obj, slice, value */                                                                           \
+    X(BINOP)         /* dst, lhs, rhs, op type */                                                                      \
+    X(AUGBINOP)      /* dst, lhs, rhs, op type */                                                                      \
+    X(COMPARE)       /* dst, lhs, rhs, op type */                                                                      \
+    X(UNARYOP)       /* dst, operand, op type */                                                                       \
+    X(NOT)           /* dst, operand */                                                                                \
+    X(NONZERO)       /* dst, operand */                                                                                \
+    X(GET_ITER)      /* dst, operand */                                                                                \
+    X(HASNEXT)       /* dst, operand */                                                                                \
+    X(CALL)          /* dst, func, nargs, args... */                                                                   \
+    X(CALLATTR)      /* dst, obj, name, cls_only, nargs, args... */                                                    \
+    X(BUILD_TUPLE)   /* dst, n, elts... */                                                                             \
+    X(BUILD_LIST)    /* dst, n, elts... */                                                                             \
+    X(BUILD_DICT)    /* dst, n, (value, key)... */                                                                     \
+    X(BUILD_SLICE)   /* dst, lower, upper, step */                                                                     \
+    X(UNPACK)        /* src, n, dsts... */                                                                             \
+    X(EVAL)          /* dst, expr */                                                                                   \
+    X(STORE_EXPR)    /* target expr, src */                                                                            \
+    X(STMT)          /* stmt */                                                                                        \
+    X(BRANCH)        /* cond, Branch stmt */                                                                           \
+    X(JUMP)          /* Jump stmt */                                                                                   \
+    X(INVOKE_DONE)   /* Invoke stmt */                                                                                 \
+    X(RETURN)        /* src */                                                                                         \
+    X(END)           /* */
+
+enum class BytecodeOp : uint32_t {
+#define BYTECODE_ENUM(name) name,
+    BYTECODE_OPCODES(BYTECODE_ENUM)
+#undef BYTECODE_ENUM
+        NUM_OPCODES
+};
+
+static const uint32_t BYTECODE_CONST_BIT = 1u << 31;
+
+class BytecodeFunction {
+public:
+    struct BlockInfo {
+        uint32_t start;
+        // If the block ends in an Invoke, exceptions from the code starting at invoke_start go to its exc_dest:
+        uint32_t invoke_start;
+        AST_Invoke* invoke;
+
+        BlockInfo() : start(0), invoke_start(0), invoke(NULL) {}
+    };
+
+    std::vector<uint32_t> code;
+    // Indexed by CFGBlock::idx:
+    std::vector<BlockInfo> blocks;
+
+    // The constants get registered as permanent GC roots, since the bytecode never gets freed.
+    std::vector<Box*> constants;
+    std::vector<InternedString> names;
+    std::vector<AST_stmt*> stmts;
+    std::vector<AST_expr*> exprs;
+
+    // The first registers hold the locals, numbered by ScopeInfo::getFastLocalSlot:
+    int num_locals;
+    int num_regs;
+
+    // Where the code for each statement starts, in order:
+    std::vector<std::pair<uint32_t, AST_stmt*>> stmt_starts;
+
+    BytecodeFunction() : num_locals(0), num_regs(0) {}
+
+    AST_stmt* getStatementAt(const uint32_t* pc) const;
+    // The number of words in the instruction at pc, including the opcode:
+    static int instructionLength(const uint32_t* pc);
+};
+
+BytecodeFunction* lowerToBytecode(SourceInfo* source, const ParamNames& param_names);
+}
+
+#endif
@@ -0,0 +1,175 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/code_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "asm_writing/icinfo.h"
+#include "codegen/baseline_jit.h"
+#include "codegen/codegen.h"
+#include "codegen/memmgr.h"
+#include "codegen/osrentry.h"
+#include "codegen/unwinding.h"
+#include "core/common.h"
+#include "core/options.h"
+#include "core/stats.h"
+#include "core/types.h"
+
+namespace pyston {
+
+// Versions that have code, oldest first:
+static std::vector<CompiledFunction*> live_versions;
+static std::vector<CompiledFunction*> retired_versions;
+static int64_t code_memory_bytes;
+
+int64_t getJITCodeMemoryBytes() {
+    return code_memory_bytes;
+}
+
+static bool canEvict(CompiledFunction* cf) {
+    CLFunction* clfunc = cf->clfunc;
+    // OSR versions only get retired along with the version they OSR out of.
+    return !cf->pinned && !cf->entry_descriptor && clfunc->source && clfunc->always_use_version != cf;
+}
+
+static void evictOldVersions(CompiledFunction* just_compiled) {
+    int64_t limit = (int64_t)JIT_CODE_CACHE_LIMIT_KB * 1024;
+
+    std::vector<CompiledFunction*> to_evict;
+    int64_t bytes = code_memory_bytes;
+    for (CompiledFunction* cf : live_versions) {
+        if (bytes <= limit)
+            break;
+        if (cf == just_compiled || !canEvict(cf))
+            continue;
+        to_evict.push_back(cf);
+        bytes -= cf->code_memory_bytes;
+    }
+
+    for (CompiledFunction* cf : to_evict) {
+        FunctionList& versions = cf->clfunc->versions;
+        auto it = std::find(versions.begin(), versions.end(), cf);
+        assert(it != versions.end());
+        versions.erase(it);
+        cf->dependent_callsites.invalidateAll();
+
+        static StatCounter num_evicted("jit_versions_evicted");
+        num_evicted.log();
+        retireCompiledFunction(cf);
+    }
+}
+
+void noteCompiledCode(CompiledFunction* cf) {
+    assert(!cf->is_interpreted);
+
+    live_versions.push_back(cf);
+    code_memory_bytes += cf->code_memory_bytes;
+
+    if (JIT_CODE_CACHE_LIMIT_KB > 0 && code_memory_bytes > (int64_t)JIT_CODE_CACHE_LIMIT_KB * 1024)
+        evictOldVersions(cf);
+}
+
+void noteBaselineJitCode(CompiledFunction* cf, int block_idx, JitCodeBlock* block) {
+    assert(!cf->retired);
+
+    if (cf->baseline_jit_code.size() <= block_idx)
+        cf->baseline_jit_code.resize(block_idx + 1, NULL);
+    assert(!cf->baseline_jit_code[block_idx]);
+    cf->baseline_jit_code[block_idx] = block;
+    code_memory_bytes += block->getMemoryBytes();
+
+    if (JIT_CODE_CACHE_LIMIT_KB > 0 && code_memory_bytes > (int64_t)JIT_CODE_CACHE_LIMIT_KB * 1024)
+        evictOldVersions(NULL);
+}
+
+void retireCompiledFunction(CompiledFunction* cf) {
+    if (cf->retired)
+        return;
+    cf->retired = true;
+
+    if (cf->is_interpreted) {
+        // The interpreter doesn't have any code of its own; all there's to free is what the baseline JIT emitted.
+        if (!cf->baseline_jit_code.empty())
+            retired_versions.push_back(cf);
+        return;
+    }
+
+    auto it = std::find(live_versions.begin(), live_versions.end(), cf);
+    if (it == live_versions.end())
+        return;
+    live_versions.erase(it);
+    retired_versions.push_back(cf);
+
+    // Nothing can OSR into these anymore:
+    auto& osr_versions = cf->clfunc->osr_versions;
+    for (auto osr_it = osr_versions.begin(); osr_it != osr_versions.end();) {
+        if (osr_it->first->cf == cf) {
+            CompiledFunction* osr_cf = osr_it->second;
+            osr_it = osr_versions.erase(osr_it);
+            retireCompiledFunction(osr_cf);
+        } else {
+            ++osr_it;
+        }
+    }
+}
+
+static void freeBaselineJitCode(CompiledFunction* cf) {
+    static StatCounter num_freed("baselinejit_blocks_freed");
+    for (JitCodeBlock* block : cf->baseline_jit_code) {
+        if (!block)
+            continue;
+        code_memory_bytes -= block->getMemoryBytes();
+        delete block;
+        num_freed.log();
+    }
+    cf->baseline_jit_code.clear();
+}
+
+static void freeCode(CompiledFunction* cf) {
+    freeBaselineJitCode(cf);
+    if (cf->is_interpreted)
+        return;
+
+    if (VERBOSITY("irgen") >= 1)
+        printf("Freeing the code of %p (%ld bytes)\n", cf->code, cf->code_memory_bytes);
+
+    for (ICInfo* ic : cf->ics) {
+        deregisterCompiledPatchpoint(ic);
+        delete ic;
+    }
+    cf->ics.clear();
+
+    deregisterCompiledCode(cf);
+    g.func_addr_registry.deregisterFunctions(cf->code, cf->code_size);
+
+    delete cf->location_map;
+    cf->location_map = NULL;
+
+    code_memory_bytes -= cf->code_memory_bytes;
+    releaseJITMemory(cf);
+
+    static StatCounter num_freed("jit_versions_freed");
+    num_freed.log();
+}
+
+void reclaimRetiredCode() {
+    auto still_running = std::partition(retired_versions.begin(), retired_versions.end(),
+                                        [](CompiledFunction* cf) { return cf->num_inside > 0 || cf->pinned; });
+    for (auto it = still_running; it != retired_versions.end(); ++it)
+        freeCode(*it);
+    retired_versions.erase(still_running, retired_versions.end());
+}
+}
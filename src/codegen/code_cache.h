@@ -0,0 +1,49 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_CODECACHE_H
+#define PYSTON_CODEGEN_CODECACHE_H
+
+#include <cstdint>
+
+namespace pyston {
+
+class CompiledFunction;
+class JitCodeBlock;
+
+// Keeps track of how much memory JIT'd code is using, and frees the code of versions that we're done with.
+//
+// The baseline JIT code that the interpreter compiles for a version (see codegen/baseline_jit.h) counts towards the
+// limit too, and gets freed along with the version; interpreted versions get retired when they get reoptimized.
+//
+// A version gets retired once it's no longer in its CLFunction's list of versions: when it gets reoptimized,
+// killed after too many failed speculations, or evicted to stay under JIT_CODE_CACHE_LIMIT_KB (oldest first).
+// Its code gets freed once no frame is executing it anymore (see CompiledFunction::num_inside); the
+// CompiledFunction object itself stays around, since there can still be pointers to it.
+//
+// All of these need the codegen lock.
+
+// Called after a version's code has been emitted.
+void noteCompiledCode(CompiledFunction* cf);
+// Hands the code for one of cf's CFG blocks over to the cache.
+void noteBaselineJitCode(CompiledFunction* cf, int block_idx, JitCodeBlock* block);
+// cf must already have been removed from its CLFunction's versions.
+void retireCompiledFunction(CompiledFunction* cf);
+// Frees the code of the retired versions that aren't running anymore.
+void reclaimRetiredCode();
+
+int64_t getJITCodeMemoryBytes();
+}
+
+#endif
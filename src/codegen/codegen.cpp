@@ -25,7 +25,9 @@
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/FileSystem.h"
 
+#include "analysis/function_analysis.h"
 #include "analysis/scoping_analysis.h"
+#include "analysis/type_analysis.h"
 #include "codegen/compvars.h"
 #include "core/ast.h"
 #include "core/util.h"
@@ -35,9 +37,19 @@ namespace pyston {
 DS_DEFINE_RWLOCK(codegen_rwlock);
 
 SourceInfo::SourceInfo(BoxedModule* m, ScopingAnalysis* scoping, AST* ast, std::vector<AST_stmt*> body, std::string fn)
-    : parent_module(m), scoping(scoping), ast(ast), cfg(NULL), fn(std::move(fn)), body(std::move(body)) {
+    : parent_module(m),
+      scoping(scoping),
+      ast(ast),
+      cfg(NULL),
+      bytecode(NULL),
+      fn(std::move(fn)),
+      body(std::move(body)),
+      lazy_body(NULL) {
     assert(this->fn.size());
 
+    if (ast->type == AST_TYPE::FunctionDef)
+        lazy_body = ast_cast<AST_FunctionDef>(ast)->lazy_body;
+
     switch (ast->type) {
         case AST_TYPE::ClassDef:
         case AST_TYPE::Lambda:
@@ -55,6 +67,9 @@ SourceInfo::SourceInfo(BoxedModule* m, ScopingAnalysis* scoping, AST* ast, std::
     }
 }
 
+SourceInfo::~SourceInfo() {
+}
+
 void FunctionAddressRegistry::registerFunction(const std::string& name, void* addr, int length,
                                                llvm::Function* llvm_func) {
     assert(addr);
@@ -62,6 +77,16 @@ void FunctionAddressRegistry::registerFunction(const std::string& name, void* ad
     functions.insert(std::make_pair(addr, FuncInfo(name, length, llvm_func)));
 }
 
+void FunctionAddressRegistry::deregisterFunctions(void* start, int64_t length) {
+    for (auto it = functions.begin(); it != functions.end();) {
+        if (it->first >= start && it->first < (char*)start + length)
+            it = functions.erase(it);
+        else
+            ++it;
+    }
+    lookup_neg_cache.clear();
+}
+
 void FunctionAddressRegistry::dumpPerfMap() {
     std::string out_path = "perf_map";
     removeDirectoryIfExists(out_path);
@@ -48,6 +48,8 @@ public:
     std::string getFuncNameAtAddress(void* addr, bool demangle, bool* out_success = NULL);
     llvm::Function* getLLVMFuncAtAddress(void* addr);
     void registerFunction(const std::string& name, void* addr, int length, llvm::Function* llvm_func);
+    // Forgets about all the functions that start in [start, start + length).
+    void deregisterFunctions(void* start, int64_t length);
     void dumpPerfMap();
 };
 
@@ -629,6 +629,87 @@ static ConcreteCompilerVariable* _call(IREmitter& emitter, const OpInfo& info, l
     return new ConcreteCompilerVariable(rtn_type, rtn, true);
 }
 
+CompiledFunction* findDirectCallVersion(BoxedFunction* func, const std::vector<CompilerVariable*>& args) {
+    CLFunction* cl = func->f;
+    assert(cl);
+    assert(!cl->takes_varargs && !cl->takes_kwargs);
+    assert(args.size() >= cl->num_args - cl->num_defaults && args.size() <= cl->num_args);
+
+    // TODO have to find the right version.. similar to resolveclfunc?
+    for (CompiledFunction* cf : cl->versions) {
+        assert(cf->spec->arg_types.size() == cl->numReceivedArgs());
+        if (cf->is_interpreted)
+            continue;
+        // Whatever retires a version is supposed to take it out of the list, but a direct call to one would
+        // end up in code that's about to get freed:
+        if (cf->retired)
+            continue;
+
+        bool fits = true;
+        for (int j = 0; j < args.size(); j++) {
+            if (!args[j]->canConvertTo(cf->spec->arg_types[j])) {
+                fits = false;
+                break;
+            }
+        }
+        if (fits)
+            return cf;
+    }
+    return NULL;
+}
+
+ConcreteCompilerVariable* callCompiledVersionDirectly(IREmitter& emitter, const OpInfo& info, BoxedFunction* func,
+                                                      CompiledFunction* cf, ArgPassSpec argspec,
+                                                      const std::vector<CompilerVariable*>& args) {
+    CLFunction* cl = func->f;
+    assert(cf->clfunc == cl);
+    assert(!cf->is_interpreted);
+    assert(cf->code);
+    assert(!func->closure);
+
+    std::vector<llvm::Type*> arg_types;
+    RELEASE_ASSERT(cl->num_args == cl->numReceivedArgs(), "");
+    for (int i = 0; i < cl->num_args; i++) {
+        // TODO support passing unboxed values as arguments
+        assert(cf->spec->arg_types[i]->llvmType() == g.llvm_value_type_ptr);
+
+        if (i == 3) {
+            arg_types.push_back(g.llvm_value_type_ptr->getPointerTo());
+            break;
+        } else {
+            arg_types.push_back(g.llvm_value_type_ptr);
+        }
+    }
+    llvm::FunctionType* ft = llvm::FunctionType::get(cf->spec->rtn_type->llvmType(), arg_types, false);
+
+    llvm::Value* linked_function;
+    if (cf->func) // for JITed functions we need to make the desination address relocatable.
+        linked_function = embedRelocatablePtr(cf->code, ft->getPointerTo());
+    else
+        linked_function = embedConstantPtr(cf->code, ft->getPointerTo());
+
+    std::vector<CompilerVariable*> new_args(args);
+    for (int i = args.size(); i < cl->num_args; i++) {
+        // TODO should _call() be able to take llvm::Value's directly?
+        auto value = func->defaults->elts[i - cl->num_args + cl->num_defaults];
+        llvm::Value* llvm_value;
+        if (value)
+            llvm_value = embedRelocatablePtr(value, g.llvm_value_type_ptr);
+        else
+            llvm_value = getNullPtr(g.llvm_value_type_ptr);
+
+        new_args.push_back(new ConcreteCompilerVariable(UNKNOWN, llvm_value, true));
+    }
+
+    std::vector<llvm::Value*> other_args;
+
+    ConcreteCompilerVariable* rtn
+        = _call(emitter, info, linked_function, cf->code, other_args, argspec, new_args, NULL, cf->spec->rtn_type);
+    assert(rtn->getType() == cf->spec->rtn_type);
+    assert(rtn->getType() != UNDEF);
+    return rtn;
+}
+
 CompilerVariable* UnknownType::call(IREmitter& emitter, const OpInfo& info, ConcreteCompilerVariable* var,
                                     ArgPassSpec argspec, const std::vector<CompilerVariable*>& args,
                                     const std::vector<const std::string*>* keyword_names) {
@@ -1544,74 +1625,16 @@ public:
         RELEASE_ASSERT(args.size() + 1 >= cl->num_args - cl->num_defaults && args.size() + 1 <= cl->num_args, "%d",
                        info.unw_info.current_stmt->lineno);
 
-        CompiledFunction* cf = NULL;
-        bool found = false;
-        // TODO have to find the right version.. similar to resolveclfunc?
-        for (int i = 0; i < cl->versions.size(); i++) {
-            cf = cl->versions[i];
-            assert(cf->spec->arg_types.size() == cl->numReceivedArgs());
-
-            bool fits = true;
-            for (int j = 0; j < args.size(); j++) {
-                if (!args[j]->canConvertTo(cf->spec->arg_types[j + 1])) {
-                    fits = false;
-                    break;
-                }
-            }
-            if (!fits)
-                continue;
-
-            found = true;
-            break;
-        }
-
-        assert(found);
-        assert(!cf->is_interpreted);
-        assert(cf->code);
-
-        std::vector<llvm::Type*> arg_types;
-        RELEASE_ASSERT(cl->num_args == cl->numReceivedArgs(), "");
-        for (int i = 0; i < cl->num_args; i++) {
-            // TODO support passing unboxed values as arguments
-            assert(cf->spec->arg_types[i]->llvmType() == g.llvm_value_type_ptr);
-
-            if (i == 3) {
-                arg_types.push_back(g.llvm_value_type_ptr->getPointerTo());
-                break;
-            } else {
-                arg_types.push_back(g.llvm_value_type_ptr);
-            }
-        }
-        llvm::FunctionType* ft = llvm::FunctionType::get(cf->spec->rtn_type->llvmType(), arg_types, false);
-
-        llvm::Value* linked_function;
-        if (cf->func) // for JITed functions we need to make the desination address relocatable.
-            linked_function = embedRelocatablePtr(cf->code, ft->getPointerTo());
-        else
-            linked_function = embedConstantPtr(cf->code, ft->getPointerTo());
-
         std::vector<CompilerVariable*> new_args;
         new_args.push_back(var);
         new_args.insert(new_args.end(), args.begin(), args.end());
 
-        for (int i = args.size() + 1; i < cl->num_args; i++) {
-            // TODO should _call() be able to take llvm::Value's directly?
-            auto value = rtattr_func->defaults->elts[i - cl->num_args + cl->num_defaults];
-            llvm::Value* llvm_value;
-            if (value)
-                llvm_value = embedRelocatablePtr(value, g.llvm_value_type_ptr);
-            else
-                llvm_value = getNullPtr(g.llvm_value_type_ptr);
-
-            new_args.push_back(new ConcreteCompilerVariable(UNKNOWN, llvm_value, true));
-        }
-
-        std::vector<llvm::Value*> other_args;
+        CompiledFunction* cf = findDirectCallVersion(rtattr_func, new_args);
+        assert(cf);
+        // We're about to embed the address of its code, and there's no way to invalidate that:
+        cf->pinned = true;
 
-        ConcreteCompilerVariable* rtn = _call(emitter, info, linked_function, cf->code, other_args, argspec, new_args,
-                                              keyword_names, cf->spec->rtn_type);
-        assert(rtn->getType() == cf->spec->rtn_type);
-        assert(rtn->getType() != UNDEF);
+        ConcreteCompilerVariable* rtn = callCompiledVersionDirectly(emitter, info, rtattr_func, cf, argspec, new_args);
 
         // We should provide unboxed versions of these rather than boxing then unboxing:
         // TODO is it more efficient to unbox here, or should we leave it boxed?
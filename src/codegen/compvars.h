@@ -27,6 +27,7 @@
 
 namespace pyston {
 
+class BoxedFunction;
 class OpInfo;
 
 class CompilerType;
@@ -407,6 +408,15 @@ CompilerType* typeOfClassobj(BoxedClass*);
 CompilerType* makeTupleType(const std::vector<CompilerType*>& elt_types);
 CompilerType* makeFuncType(ConcreteCompilerType* rtn_type, const std::vector<ConcreteCompilerType*>& arg_types);
 
+// Support for calling straight into the compiled code of a known function, skipping the generic call path.
+// findDirectCallVersion returns NULL if there's no compiled version that can take these (positional) args.
+CompiledFunction* findDirectCallVersion(BoxedFunction* func, const std::vector<CompilerVariable*>& args);
+// The result is returned as cf's (boxed) return type.  The caller has to make sure that cf's code stays around for
+// as long as the call can happen, by either pinning cf or guarding on it not being retired.
+ConcreteCompilerVariable* callCompiledVersionDirectly(IREmitter& emitter, const OpInfo& info, BoxedFunction* func,
+                                                      CompiledFunction* cf, ArgPassSpec argspec,
+                                                      const std::vector<CompilerVariable*>& args);
+
 ConcreteCompilerVariable* boolFromI1(IREmitter&, llvm::Value*);
 llvm::Value* i1FromBool(IREmitter&, ConcreteCompilerVariable*);
 
@@ -14,9 +14,11 @@
 
 #include "codegen/entry.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <lz4frame.h>
+#include <map>
 #include <openssl/evp.h>
 #include <unordered_map>
 
@@ -32,6 +34,7 @@
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetSelect.h"
@@ -40,6 +43,8 @@
 
 #include "codegen/codegen.h"
 #include "codegen/memmgr.h"
+#include "codegen/parser.h"
+#include "codegen/persistent_profile.h"
 #include "codegen/profiling/profiling.h"
 #include "codegen/stackmaps.h"
 #include "core/options.h"
@@ -202,6 +207,125 @@ public:
     }
 };
 
+// A read-only pack of cached objects, meant to be built once (for example during a deploy's build step, by running
+// a representative workload with PYSTON_OBJECT_CACHE_WRITE_PACK set) and then shipped along with the code.
+// It gets memory-mapped, and the objects are stored uncompressed so that they can be handed to MCJIT without
+// any copying.
+//
+// Layout: a PackHeader, then num_entries PackIndexEntries sorted by hash, followed by the object data.  Each object
+// starts at a multiple of OBJECT_ALIGNMENT, since the object file readers expect their buffer to be aligned.
+class ObjectCachePack {
+private:
+    struct PackHeader {
+        char magic[8];
+        uint64_t num_entries;
+    };
+    struct PackIndexEntry {
+        char hash[64]; // hex SHA256 of the module's bitcode, not null-terminated
+        uint64_t offset;
+        uint64_t size;
+    };
+    static constexpr const char* MAGIC = "PYOCPK2";
+    static const uint64_t OBJECT_ALIGNMENT = 16;
+    static_assert(sizeof(PackHeader) % OBJECT_ALIGNMENT == 0 && sizeof(PackIndexEntry) % OBJECT_ALIGNMENT == 0,
+                  "the object data has to start aligned");
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    const PackIndexEntry* index;
+    uint64_t num_entries;
+
+    ObjectCachePack(std::unique_ptr<llvm::MemoryBuffer> buffer, const PackIndexEntry* index, uint64_t num_entries)
+        : buffer(std::move(buffer)), index(index), num_entries(num_entries) {}
+
+public:
+    // Returns NULL if the file doesn't exist or doesn't look like a valid pack.
+    static ObjectCachePack* open(llvm::StringRef file_name) {
+        auto buffer_or_error = llvm::MemoryBuffer::getFile(file_name, -1, false /* RequiresNullTerminator */);
+        if (!buffer_or_error)
+            return NULL;
+        std::unique_ptr<llvm::MemoryBuffer> buffer = std::move(*buffer_or_error);
+
+        uint64_t size = buffer->getBufferSize();
+        if (size < sizeof(PackHeader))
+            return NULL;
+        const PackHeader* header = reinterpret_cast<const PackHeader*>(buffer->getBufferStart());
+        if (memcmp(header->magic, MAGIC, sizeof(header->magic)) != 0)
+            return NULL;
+        if (header->num_entries > (size - sizeof(PackHeader)) / sizeof(PackIndexEntry))
+            return NULL;
+
+        const PackIndexEntry* index = reinterpret_cast<const PackIndexEntry*>(header + 1);
+        for (uint64_t i = 0; i < header->num_entries; i++) {
+            if (index[i].offset > size || index[i].size > size - index[i].offset)
+                return NULL;
+            if (index[i].offset % OBJECT_ALIGNMENT != 0)
+                return NULL;
+        }
+        return new ObjectCachePack(std::move(buffer), index, header->num_entries);
+    }
+
+    llvm::StringRef lookup(llvm::StringRef hash) const {
+        if (hash.size() != sizeof(PackIndexEntry::hash))
+            return llvm::StringRef();
+
+        const PackIndexEntry* end = index + num_entries;
+        const PackIndexEntry* it = std::lower_bound(index, end, hash, [](const PackIndexEntry& e, llvm::StringRef h) {
+            return memcmp(e.hash, h.data(), sizeof(e.hash)) < 0;
+        });
+        if (it == end || memcmp(it->hash, hash.data(), sizeof(it->hash)) != 0)
+            return llvm::StringRef();
+        return llvm::StringRef(buffer->getBufferStart() + it->offset, it->size);
+    }
+
+    template <typename Func> void forEach(Func func) const {
+        for (uint64_t i = 0; i < num_entries; i++) {
+            func(llvm::StringRef(index[i].hash, sizeof(index[i].hash)),
+                 llvm::StringRef(buffer->getBufferStart() + index[i].offset, index[i].size));
+        }
+    }
+
+    // entries has to be sorted by hash (which std::map takes care of).
+    static bool write(llvm::StringRef file_name, const std::map<std::string, std::string>& entries) {
+        // Write to a temporary file and rename it into place, so that a process that's reading the pack
+        // concurrently never sees a partial one.
+        std::string tmp_name = tempFileName(file_name.str());
+        {
+            std::error_code error_code;
+            llvm::raw_fd_ostream file(tmp_name, error_code, llvm::sys::fs::F_RW);
+            if (error_code)
+                return false;
+
+            PackHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, MAGIC, sizeof(header.magic));
+            header.num_entries = entries.size();
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+            uint64_t offset = sizeof(PackHeader) + entries.size() * sizeof(PackIndexEntry);
+            for (auto&& p : entries) {
+                PackIndexEntry entry;
+                RELEASE_ASSERT(p.first.size() == sizeof(entry.hash), "");
+                memcpy(entry.hash, p.first.data(), sizeof(entry.hash));
+                entry.offset = offset;
+                entry.size = p.second.size();
+                file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+                offset = llvm::RoundUpToAlignment(offset + entry.size, OBJECT_ALIGNMENT);
+            }
+            static const char padding[OBJECT_ALIGNMENT] = {};
+            for (auto&& p : entries) {
+                file.write(p.second.data(), p.second.size());
+                file.write(padding, llvm::OffsetToAlignment(p.second.size(), OBJECT_ALIGNMENT));
+            }
+
+            if (file.has_error()) {
+                file.clear_error();
+                return false;
+            }
+        }
+        return !llvm::sys::fs::rename(tmp_name, file_name);
+    }
+};
+
 class PystonObjectCache : public llvm::ObjectCache {
 private:
     // Stream which calculates the SHA256 hash of the data writen to.
@@ -240,14 +364,54 @@ private:
     std::string module_identifier;
     std::string hash_before_codegen;
 
+    // Set once we added a file to the cache directory, in which case it might need to get trimmed at shutdown:
+    bool wrote_cache_files;
+
+    std::unique_ptr<ObjectCachePack> pack;
+    // If we're building a pack, every object that gets used during this run, keyed by hash:
+    std::string write_pack_file;
+    std::map<std::string, std::string> pack_entries;
+
+    void recordForPack(llvm::StringRef hash, llvm::StringRef obj) {
+        if (!write_pack_file.empty())
+            pack_entries[hash.str()] = obj.str();
+    }
+
 public:
-    PystonObjectCache() {
+    PystonObjectCache() : wrote_cache_files(false) {
         llvm::sys::path::home_directory(cache_dir);
         llvm::sys::path::append(cache_dir, ".cache");
         llvm::sys::path::append(cache_dir, "pyston");
         llvm::sys::path::append(cache_dir, "object_cache");
 
-        cleanupCacheDirectory();
+        if (const char* pack_file = getenv("PYSTON_OBJECT_CACHE_PACK")) {
+            pack.reset(ObjectCachePack::open(pack_file));
+            if (!pack && VERBOSITY() >= 1)
+                fprintf(stderr, "Couldn't load the object cache pack '%s'\n", pack_file);
+        }
+        if (const char* write_pack = getenv("PYSTON_OBJECT_CACHE_WRITE_PACK")) {
+            write_pack_file = write_pack;
+            // Building on top of an existing pack keeps its entries around:
+            if (pack)
+                pack->forEach([this](llvm::StringRef hash, llvm::StringRef obj) { recordForPack(hash, obj); });
+        }
+    }
+
+    // Trims the cache directory and writes out the pack, if one was requested.  Called at shutdown, so that
+    // startup doesn't have to pay for listing the directory.
+    void finish() {
+        if (wrote_cache_files)
+            cleanupCacheDirectory();
+
+        if (write_pack_file.empty())
+            return;
+
+        bool success = ObjectCachePack::write(write_pack_file, pack_entries);
+        if (!success)
+            fprintf(stderr, "Warning: failed to write the object cache pack '%s'\n", write_pack_file.c_str());
+        else if (VERBOSITY() >= 1)
+            fprintf(stderr, "Wrote %ld objects to the object cache pack '%s'\n", pack_entries.size(),
+                    write_pack_file.c_str());
     }
 
 
@@ -260,12 +424,17 @@ public:
         RELEASE_ASSERT(module_identifier == M->getModuleIdentifier(), "");
         RELEASE_ASSERT(!hash_before_codegen.empty(), "");
 
+        static StatCounter jit_objectcache_bytes_compiled("jit_objectcache_bytes_compiled");
+        jit_objectcache_bytes_compiled.log(Obj.getBufferSize());
+        recordForPack(hash_before_codegen, Obj.getBuffer());
+
         llvm::SmallString<128> cache_file = cache_dir;
         llvm::sys::path::append(cache_file, hash_before_codegen);
         if (!llvm::sys::fs::exists(cache_dir.str()) && llvm::sys::fs::create_directories(cache_dir.str()))
             return;
 
         CompressedFile::writeFile(cache_file, Obj.getBuffer());
+        wrote_cache_files = true;
     }
 
 #if LLVMREV < 215566
@@ -275,7 +444,9 @@ public:
 #endif
     {
         static StatCounter jit_objectcache_hits("num_jit_objectcache_hits");
+        static StatCounter jit_objectcache_pack_hits("num_jit_objectcache_pack_hits");
         static StatCounter jit_objectcache_misses("num_jit_objectcache_misses");
+        static StatCounter jit_objectcache_bytes_loaded("jit_objectcache_bytes_loaded");
 
         module_identifier = M->getModuleIdentifier();
 
@@ -284,6 +455,18 @@ public:
         llvm::WriteBitcodeToFile(M, hash_stream);
         hash_before_codegen = hash_stream.getHash();
 
+        if (pack) {
+            llvm::StringRef obj = pack->lookup(hash_before_codegen);
+            if (obj.data()) {
+                jit_objectcache_hits.log();
+                jit_objectcache_pack_hits.log();
+                jit_objectcache_bytes_loaded.log(obj.size());
+                recordForPack(hash_before_codegen, obj);
+                // The pack stays mapped for the rest of the process, so there's no need to copy the object:
+                return llvm::MemoryBuffer::getMemBuffer(obj, module_identifier, false /* RequiresNullTerminator */);
+            }
+        }
+
         llvm::SmallString<128> cache_file = cache_dir;
         llvm::sys::path::append(cache_file, hash_before_codegen);
         if (!llvm::sys::fs::exists(cache_file.str())) {
@@ -320,6 +503,8 @@ public:
         }
 
         jit_objectcache_hits.log();
+        jit_objectcache_bytes_loaded.log(mem_buff->getBufferSize());
+        recordForPack(hash_before_codegen, mem_buff->getBuffer());
         return mem_buff;
     }
 
@@ -350,6 +535,8 @@ public:
     }
 };
 
+static PystonObjectCache* object_cache;
+
 static void handle_sigusr1(int signum) {
     assert(signum == SIGUSR1);
     fprintf(stderr, "SIGUSR1, printing stack trace\n");
@@ -407,8 +594,10 @@ void initCodegen() {
     g.engine = eb.create(g.tm);
     assert(g.engine && "engine creation failed?");
 
-    if (ENABLE_JIT_OBJECT_CACHE)
-        g.engine->setObjectCache(new PystonObjectCache());
+    if (ENABLE_JIT_OBJECT_CACHE) {
+        object_cache = new PystonObjectCache();
+        g.engine->setObjectCache(object_cache);
+    }
 
     g.i1 = llvm::Type::getInt1Ty(g.context);
     g.i8 = llvm::Type::getInt8Ty(g.context);
@@ -456,6 +645,7 @@ void initCodegen() {
     initGlobalFuncs(g);
 
     setupRuntime();
+    loadPersistentProfile();
 
     // signal(SIGFPE, &handle_sigfpe);
     signal(SIGUSR1, &handle_sigusr1);
@@ -495,6 +685,12 @@ void teardownCodegen() {
     }
     g.jit_listeners.clear();
     delete g.engine;
+
+    if (object_cache) {
+        object_cache->finish();
+        delete object_cache;
+        object_cache = NULL;
+    }
 }
 
 void printAllIR() {
@@ -509,6 +705,8 @@ int joinRuntime() {
     if (PROFILE)
         g.func_addr_registry.dumpPerfMap();
 
+    savePersistentProfile();
+    writeModuleBundle();
     teardownRuntime();
     teardownCodegen();
 
@@ -49,6 +49,7 @@
 #include "codegen/osrentry.h"
 #include "codegen/patchpoints.h"
 #include "codegen/stackmaps.h"
+#include "codegen/tiering.h"
 #include "core/ast.h"
 #include "core/cfg.h"
 #include "core/options.h"
@@ -92,6 +93,8 @@ static void optimizeIR(llvm::Function* f, EffortLevel effort) {
     if (ENABLE_PYSTON_PASSES) {
         fpm.add(createRemoveUnnecessaryBoxingPass());
         fpm.add(createRemoveDuplicateBoxingPass());
+        fpm.add(createUnboxThroughPhisPass());
+        fpm.add(createSinkBoxingPass());
     }
 
     if (ENABLE_INLINING && effort >= EffortLevel::MAXIMAL)
@@ -133,6 +136,8 @@ static void optimizeIR(llvm::Function* f, EffortLevel effort) {
         fpm.add(llvm::createCFGSimplificationPass());   // Merge & remove BBs
         fpm.add(llvm::createReassociatePass());         // Reassociate expressions
         fpm.add(llvm::createLoopRotatePass());          // Rotate Loop
+        if (ENABLE_PYSTON_PASSES)
+            fpm.add(createHoistClassGuardsPass());
         fpm.add(llvm::createLICMPass());                // Hoist loop invariants
         fpm.add(llvm::createLoopUnswitchPass(true /*optimize_for_size*/));
         fpm.add(llvm::createInstructionCombiningPass());
@@ -543,13 +548,7 @@ static void emitBBs(IRGenState* irstate, TypeAnalysis* types, const OSREntryDesc
                     = emitter->getBuilder()->CreateAdd(cur_call_count, getConstantInt(1, g.i64));
                 emitter->getBuilder()->CreateStore(new_call_count, call_count_ptr);
 
-                int reopt_threshold;
-                if (effort == EffortLevel::MINIMAL)
-                    reopt_threshold = REOPT_THRESHOLD_BASELINE;
-                else if (effort == EffortLevel::MODERATE)
-                    reopt_threshold = REOPT_THRESHOLD_T2;
-                else
-                    RELEASE_ASSERT(0, "Unknown effort: %d", (int)effort);
+                int64_t reopt_threshold = getReoptThreshold(source, effort);
 
                 llvm::Value* reopt_test
                     = emitter->getBuilder()->CreateICmpSGT(new_call_count, getConstantInt(reopt_threshold, g.i64));
@@ -875,6 +874,78 @@ static void emitBBs(IRGenState* irstate, TypeAnalysis* types, const OSREntryDesc
     }
 }
 
+// Keeps cf->num_inside up to date, so that we know when it's safe to free the code (see codegen/code_cache.h).
+// We decrement it on the normal return paths, and on the unwind path too: every call that might throw and doesn't
+// already unwind to one of our own landing pads gets turned into an invoke of a cleanup landing pad, which decrements
+// the counter and resumes the unwinding.  Calls that unwind to an existing landing pad don't leave the frame, and
+// anything that gets thrown out of those handlers goes through a call that we'll have converted.
+static void emitFrameCounting(llvm::Function* f, CompiledFunction* cf) {
+    llvm::Constant* counter_ptr = embedRelocatablePtr(&cf->num_inside, g.i64->getPointerTo());
+
+    std::vector<llvm::ReturnInst*> returns;
+    std::vector<llvm::CallInst*> throwing_calls;
+    for (llvm::BasicBlock& bb : *f) {
+        if (llvm::ReturnInst* ret = llvm::dyn_cast<llvm::ReturnInst>(bb.getTerminator()))
+            returns.push_back(ret);
+
+        for (llvm::Instruction& inst : bb) {
+            llvm::CallInst* call = llvm::dyn_cast<llvm::CallInst>(&inst);
+            if (!call || call->doesNotThrow() || call->isInlineAsm())
+                continue;
+
+            // Patchpoints can be invoked, but the other intrinsics can't (and don't throw):
+            if (llvm::Function* callee = call->getCalledFunction()) {
+                llvm::Intrinsic::ID id = (llvm::Intrinsic::ID)callee->getIntrinsicID();
+                if (id != llvm::Intrinsic::not_intrinsic && id != llvm::Intrinsic::experimental_patchpoint_i64
+                    && id != llvm::Intrinsic::experimental_patchpoint_void
+                    && id != llvm::Intrinsic::experimental_patchpoint_double)
+                    continue;
+            }
+            throwing_calls.push_back(call);
+        }
+    }
+
+    llvm::IRBuilder<> builder(&*f->getEntryBlock().getFirstInsertionPt());
+    builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, counter_ptr, getConstantInt(1, g.i64), llvm::Monotonic);
+
+    for (llvm::ReturnInst* ret : returns) {
+        builder.SetInsertPoint(ret);
+        builder.CreateAtomicRMW(llvm::AtomicRMWInst::Sub, counter_ptr, getConstantInt(1, g.i64), llvm::Monotonic);
+    }
+
+    if (throwing_calls.empty())
+        return;
+
+    llvm::BasicBlock* cleanup = llvm::BasicBlock::Create(g.context, "frame_counting_cleanup", f);
+    builder.SetInsertPoint(cleanup);
+    // Has to match the personality of the landing pads that irgen emits for try blocks:
+    llvm::Function* _personality_func = g.stdlib_module->getFunction("__gxx_personality_v0");
+    assert(_personality_func);
+    llvm::Value* personality_func
+        = g.cur_module->getOrInsertFunction(_personality_func->getName(), _personality_func->getFunctionType());
+    llvm::LandingPadInst* landing_pad = builder.CreateLandingPad(
+        llvm::StructType::create(std::vector<llvm::Type*>{ g.i8_ptr, g.i64 }), personality_func, 0);
+    landing_pad->setCleanup(true);
+    builder.CreateAtomicRMW(llvm::AtomicRMWInst::Sub, counter_ptr, getConstantInt(1, g.i64), llvm::Monotonic);
+    builder.CreateResume(landing_pad);
+
+    for (llvm::CallInst* call : throwing_calls) {
+        // Same approach as llvm::InlineFunction uses for calls that get inlined through an invoke:
+        llvm::BasicBlock* bb = call->getParent();
+        llvm::BasicBlock* normal_dest = bb->splitBasicBlock(call, bb->getName());
+        bb->getInstList().pop_back(); // remove the branch that splitBasicBlock added
+
+        llvm::SmallVector<llvm::Value*, 8> args(call->op_begin(), call->op_end() - 1);
+        llvm::InvokeInst* invoke
+            = llvm::InvokeInst::Create(call->getCalledValue(), normal_dest, cleanup, args, call->getName(), bb);
+        invoke->setDebugLoc(call->getDebugLoc());
+        invoke->setCallingConv(call->getCallingConv());
+        invoke->setAttributes(call->getAttributes());
+        call->replaceAllUsesWith(invoke);
+        normal_dest->getInstList().pop_front(); // erase the call
+    }
+}
+
 static void computeBlockSetClosure(BlockSet& blocks) {
     if (VERBOSITY("irgen") >= 2) {
         printf("Initial:");
@@ -952,7 +1023,8 @@ static std::string getUniqueFunctionName(std::string nameprefix, EffortLevel eff
 }
 
 CompiledFunction* doCompile(SourceInfo* source, ParamNames* param_names, const OSREntryDescriptor* entry_descriptor,
-                            EffortLevel effort, FunctionSpecialization* spec, std::string nameprefix) {
+                            EffortLevel effort, FunctionSpecialization* spec, std::string nameprefix,
+                            long* analysis_us) {
     Timer _t("in doCompile");
     Timer _t2;
     long irgen_us = 0;
@@ -1037,13 +1109,9 @@ CompiledFunction* doCompile(SourceInfo* source, ParamNames* param_names, const O
         speculation_level = TypeAnalysis::SOME;
     TypeAnalysis* types;
     if (entry_descriptor)
-        types = doTypeAnalysis(entry_descriptor, effort, speculation_level, source->getScopeInfo());
+        types = doTypeAnalysis(source, entry_descriptor, effort, speculation_level);
     else
-        types = doTypeAnalysis(source->cfg, *param_names, spec->arg_types, effort, speculation_level,
-                               source->getScopeInfo());
-
-
-    _t2.split();
+        types = doTypeAnalysis(source, *param_names, spec->arg_types, effort, speculation_level);
 
     BlockSet blocks;
     if (entry_descriptor == NULL) {
@@ -1055,17 +1123,23 @@ CompiledFunction* doCompile(SourceInfo* source, ParamNames* param_names, const O
         computeBlockSetClosure(blocks);
     }
 
-    std::unique_ptr<LivenessAnalysis> liveness = computeLivenessInfo(source->cfg);
-    std::unique_ptr<PhiAnalysis> phis;
+    LivenessAnalysis* liveness = getLivenessInfo(source);
+    // The phis needed for an OSR entry depend on the entry point, so those can't be reused:
+    std::unique_ptr<PhiAnalysis> osr_phis;
+    PhiAnalysis* phis;
+    if (entry_descriptor) {
+        osr_phis = computeRequiredPhis(entry_descriptor, liveness, source->getScopeInfo());
+        phis = osr_phis.get();
+    } else {
+        phis = getRequiredPhis(*param_names, source);
+    }
 
-    if (entry_descriptor)
-        phis = computeRequiredPhis(entry_descriptor, liveness.get(), source->getScopeInfo());
-    else
-        phis = computeRequiredPhis(*param_names, source->cfg, liveness.get(), source->getScopeInfo());
+    *analysis_us = _t2.split();
 
-    IRGenState irstate(cf, source, std::move(liveness), std::move(phis), param_names, getGCBuilder(), dbg_funcinfo);
+    IRGenState irstate(cf, source, liveness, phis, param_names, getGCBuilder(), dbg_funcinfo);
 
     emitBBs(&irstate, types, entry_descriptor, blocks);
+    emitFrameCounting(f, cf);
 
     // De-opt handling:
 
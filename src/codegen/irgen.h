@@ -97,8 +97,11 @@ extern const std::string PASSED_GENERATOR_NAME;
 InternedString getIsDefinedName(InternedString name, InternedStringPool& interned_strings);
 bool isIsDefinedName(const std::string& name);
 
+// Sets *analysis_us to the time that went into the (type, liveness and phi) analyses, as opposed to generating and
+// optimizing the IR.
 CompiledFunction* doCompile(SourceInfo* source, ParamNames* param_names, const OSREntryDescriptor* entry_descriptor,
-                            EffortLevel effort, FunctionSpecialization* spec, std::string nameprefix);
+                            EffortLevel effort, FunctionSpecialization* spec, std::string nameprefix,
+                            long* analysis_us);
 
 // A common pattern is to branch based off whether a variable is defined but only if it is
 // potentially-undefined.  If it is potentially-undefined, we have to generate control-flow
@@ -21,6 +21,7 @@
 #include "analysis/scoping_analysis.h"
 #include "asm_writing/icinfo.h"
 #include "codegen/ast_interpreter.h"
+#include "codegen/code_cache.h"
 #include "codegen/codegen.h"
 #include "codegen/compvars.h"
 #include "codegen/irgen.h"
@@ -29,7 +30,9 @@
 #include "codegen/osrentry.h"
 #include "codegen/parser.h"
 #include "codegen/patchpoints.h"
+#include "codegen/persistent_profile.h"
 #include "codegen/stackmaps.h"
+#include "codegen/tiering.h"
 #include "codegen/unwinding.h"
 #include "core/ast.h"
 #include "core/cfg.h"
@@ -105,9 +108,27 @@ const std::string SourceInfo::getName() {
     }
 }
 
+const std::vector<AST_stmt*>& SourceInfo::getBody() {
+    if (lazy_body) {
+        assert(body.empty());
+        static StatCounter num_materialized("num_lazy_function_bodies_materialized");
+        num_materialized.log();
+
+        body = lazy_body->getBody();
+        lazy_body = NULL;
+    }
+    return body;
+}
+
 Box* SourceInfo::getDocString() {
     AST_Str* first_str = NULL;
 
+    if (lazy_body) {
+        if (lazy_body->docstring)
+            return boxString(lazy_body->docstring->str_data);
+        return None;
+    }
+
     if (body.size() > 0 && body[0]->type == AST_TYPE::Expr
         && static_cast<AST_Expr*>(body[0])->value->type == AST_TYPE::Str) {
         return boxString(static_cast<AST_Str*>(static_cast<AST_Expr*>(body[0])->value)->str_data);
@@ -224,26 +245,36 @@ CompiledFunction* compileFunction(CLFunction* f, FunctionSpecialization* spec, E
     }
 #endif
 
+    reclaimRetiredCode();
+
     // Do the analysis now if we had deferred it earlier:
     if (source->cfg == NULL) {
-        source->cfg = computeCFG(source, source->body);
+        source->cfg = computeCFG(source, source->getBody());
     }
 
 
 
     CompiledFunction* cf = 0;
+    long analysis_us = 0;
     if (effort == EffortLevel::INTERPRETED) {
         assert(!entry_descriptor);
         cf = new CompiledFunction(0, spec, true, NULL, effort, 0);
     } else {
-        cf = doCompile(source, &f->param_names, entry_descriptor, effort, spec, name);
+        applyPersistentProfile(source);
+        cf = doCompile(source, &f->param_names, entry_descriptor, effort, spec, name, &analysis_us);
         compileIR(cf, effort);
+        // OSR compiles only cover a loop that got hot, so they don't say what the whole function should start at:
+        if (!entry_descriptor)
+            notePersistentEffort(source, effort);
     }
 
     f->addVersion(cf);
     assert(f->versions.size());
+    if (!cf->is_interpreted)
+        noteCompiledCode(cf);
 
     long us = _t.end();
+    noteCompileTime(source, effort, us);
     static StatCounter us_compiling("us_compiling");
     us_compiling.log(us);
     if (VERBOSITY() >= 1 && us > 100000) {
@@ -264,6 +295,10 @@ CompiledFunction* compileFunction(CLFunction* f, FunctionSpecialization* spec, E
         case EffortLevel::MINIMAL: {
             static StatCounter us_compiling("us_compiling_1_minimal");
             us_compiling.log(us);
+            static StatCounter us_analysis("us_compiling_1_minimal_analysis");
+            us_analysis.log(analysis_us);
+            static StatCounter us_llvm("us_compiling_1_minimal_llvm");
+            us_llvm.log(us - analysis_us);
             static StatCounter num_compiles("num_compiles_1_minimal");
             num_compiles.log();
             break;
@@ -271,6 +306,10 @@ CompiledFunction* compileFunction(CLFunction* f, FunctionSpecialization* spec, E
         case EffortLevel::MODERATE: {
             static StatCounter us_compiling("us_compiling_2_moderate");
             us_compiling.log(us);
+            static StatCounter us_analysis("us_compiling_2_moderate_analysis");
+            us_analysis.log(analysis_us);
+            static StatCounter us_llvm("us_compiling_2_moderate_llvm");
+            us_llvm.log(us - analysis_us);
             static StatCounter num_compiles("num_compiles_2_moderate");
             num_compiles.log();
             break;
@@ -278,6 +317,10 @@ CompiledFunction* compileFunction(CLFunction* f, FunctionSpecialization* spec, E
         case EffortLevel::MAXIMAL: {
             static StatCounter us_compiling("us_compiling_3_maximal");
             us_compiling.log(us);
+            static StatCounter us_analysis("us_compiling_3_maximal_analysis");
+            us_analysis.log(analysis_us);
+            static StatCounter us_llvm("us_compiling_3_maximal_llvm");
+            us_llvm.log(us - analysis_us);
             static StatCounter num_compiles("num_compiles_3_maximal");
             num_compiles.log();
             break;
@@ -652,12 +695,10 @@ void CompiledFunction::speculationFailed() {
             }
         }
 
-        if (!found) {
-            for (int i = 0; i < clfunc->versions.size(); i++) {
-                printf("%p\n", clfunc->versions[i]);
-            }
-        }
-        assert(found);
+        // If we didn't find it, this version has already been replaced (ex it got evicted from the code
+        // cache while this frame was running) and is already retired.
+        if (found)
+            retireCompiledFunction(this);
     }
 }
 
@@ -688,6 +729,7 @@ static CompiledFunction* _doReopt(CompiledFunction* cf, EffortLevel new_effort)
     for (int i = 0; i < versions.size(); i++) {
         if (versions[i] == cf) {
             versions.erase(versions.begin() + i);
+            retireCompiledFunction(cf);
 
             CompiledFunction* new_cf
                 = compileFunction(clfunc, cf->spec, new_effort,
@@ -722,8 +764,7 @@ CompiledFunction* compilePartialFuncInternal(OSRExit* exit) {
     assert(exit->parent_cf->clfunc);
     CompiledFunction*& new_cf = exit->parent_cf->clfunc->osr_versions[exit->entry];
     if (new_cf == NULL) {
-        EffortLevel new_effort = exit->parent_cf->effort == EffortLevel::INTERPRETED ? EffortLevel::MINIMAL
-                                                                                     : EffortLevel::MAXIMAL;
+        EffortLevel new_effort = getOSREffort(exit->parent_cf->clfunc->source.get(), exit->parent_cf->effort);
         CompiledFunction* compiled = compileFunction(exit->parent_cf->clfunc, NULL, new_effort, exit->entry);
         assert(compiled == new_cf);
 
@@ -747,15 +788,12 @@ extern "C" CompiledFunction* reoptCompiledFuncInternal(CompiledFunction* cf) {
     assert(cf->effort < EffortLevel::MAXIMAL);
     assert(cf->clfunc->versions.size());
 
-    EffortLevel new_effort;
-    if (cf->effort == EffortLevel::INTERPRETED)
-        new_effort = EffortLevel::MINIMAL;
-    else if (cf->effort == EffortLevel::MINIMAL)
-        new_effort = EffortLevel::MODERATE;
-    else if (cf->effort == EffortLevel::MODERATE)
-        new_effort = EffortLevel::MAXIMAL;
-    else
-        RELEASE_ASSERT(0, "unknown effort: %d", cf->effort);
+    SourceInfo* source = cf->clfunc->source.get();
+    EffortLevel new_effort = getReoptEffort(source, cf->effort);
+    if (LOG_TIERING_DECISIONS)
+        fprintf(stderr, "tiering: reoptimizing %s:%s from effort %d to %d after %ld calls and %ld backedges\n",
+                source->fn.c_str(), source->getName().c_str(), (int)cf->effort, (int)new_effort, cf->times_called,
+                cf->times_backedges);
 
     CompiledFunction* new_cf = _doReopt(cf, new_effort);
     assert(!new_cf->is_interpreted);
@@ -14,6 +14,8 @@
 
 #include "codegen/irgen/irgenerator.h"
 
+#include <functional>
+
 #include "llvm/IR/Module.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -26,11 +28,15 @@
 #include "codegen/irgen/util.h"
 #include "codegen/osrentry.h"
 #include "codegen/patchpoints.h"
+#include "codegen/tiering.h"
 #include "codegen/type_recording.h"
 #include "core/ast.h"
 #include "core/cfg.h"
+#include "core/options.h"
+#include "core/stats.h"
 #include "core/types.h"
 #include "core/util.h"
+#include "gc/collector.h"
 #include "runtime/generator.h"
 #include "runtime/objmodel.h"
 #include "runtime/types.h"
@@ -42,13 +48,12 @@ extern "C" void dumpLLVM(llvm::Value* v) {
     v->dump();
 }
 
-IRGenState::IRGenState(CompiledFunction* cf, SourceInfo* source_info, std::unique_ptr<LivenessAnalysis> liveness,
-                       std::unique_ptr<PhiAnalysis> phis, ParamNames* param_names, GCBuilder* gc,
-                       llvm::MDNode* func_dbg_info)
+IRGenState::IRGenState(CompiledFunction* cf, SourceInfo* source_info, LivenessAnalysis* liveness, PhiAnalysis* phis,
+                       ParamNames* param_names, GCBuilder* gc, llvm::MDNode* func_dbg_info)
     : cf(cf),
       source_info(source_info),
-      liveness(std::move(liveness)),
-      phis(std::move(phis)),
+      liveness(liveness),
+      phis(phis),
       param_names(param_names),
       gc(gc),
       func_dbg_info(func_dbg_info),
@@ -476,6 +481,13 @@ private:
 
     void createExprTypeGuard(llvm::Value* check_val, AST_expr* node, llvm::Value* node_value,
                              AST_stmt* current_statement) {
+        createExprGuard(check_val, node, current_statement, [=]() { return node_value; });
+    }
+
+    // Branches to a deopt block if check_val is false.  The deopt block calls get_deopt_value to emit the
+    // computation of node's value, which is what the interpreter will continue with.
+    void createExprGuard(llvm::Value* check_val, AST_expr* node, AST_stmt* current_statement,
+                         std::function<llvm::Value*()> get_deopt_value) {
         assert(check_val->getType() == g.i1);
 
         llvm::Metadata* md_vals[]
@@ -496,6 +508,7 @@ private:
 
         curblock = deopt_bb;
         emitter.getBuilder()->SetInsertPoint(curblock);
+        llvm::Value* node_value = get_deopt_value();
         llvm::Value* v = emitter.createCall2(UnwindInfo(current_statement, NULL), g.funcs.deopt,
                                              embedRelocatablePtr(node, g.i8->getPointerTo()), node_value);
         if (irstate->getReturnType() == VOID)
@@ -746,13 +759,254 @@ private:
         return left->binexp(emitter, getOpInfoForNode(node, unw_info), right, type, exp_type);
     }
 
+    // Type analysis speculates that int (op) int doesn't overflow (see speculateIntBinop); we do the operation
+    // unboxed, and if it does overflow, compute the (long) result the slow way and deopt with it.
+    bool isCheckedIntBinop(AST_expr* node, CompilerVariable* left, CompilerVariable* right,
+                           AST_TYPE::AST_TYPE op_type) {
+        if (op_type != AST_TYPE::Add && op_type != AST_TYPE::Sub && op_type != AST_TYPE::Mult)
+            return false;
+        return left->getType() == INT && right->getType() == INT && types->speculatedExprClass(node) == int_cls;
+    }
+
+    // Returns {result, overflowed}
+    llvm::Value* emitIntBinopWithOverflow(llvm::Value* l, llvm::Value* r, AST_TYPE::AST_TYPE op_type) {
+        llvm::Intrinsic::ID intrinsic;
+        switch (op_type) {
+            case AST_TYPE::Add:
+                intrinsic = llvm::Intrinsic::sadd_with_overflow;
+                break;
+            case AST_TYPE::Sub:
+                intrinsic = llvm::Intrinsic::ssub_with_overflow;
+                break;
+            case AST_TYPE::Mult:
+                intrinsic = llvm::Intrinsic::smul_with_overflow;
+                break;
+            default:
+                RELEASE_ASSERT(0, "%d", op_type);
+        }
+
+        llvm::Function* f
+            = llvm::Intrinsic::getDeclaration(g.cur_module, intrinsic, llvm::ArrayRef<llvm::Type*>(g.i64));
+        return emitter.getBuilder()->CreateCall2(f, l, r);
+    }
+
+    CompilerVariable* evalCheckedIntBinop(AST_expr* node, CompilerVariable* left, CompilerVariable* right,
+                                          AST_TYPE::AST_TYPE op_type, BinExpType exp_type, UnwindInfo unw_info) {
+        ConcreteCompilerVariable* converted_left = left->makeConverted(emitter, INT);
+        ConcreteCompilerVariable* converted_right = right->makeConverted(emitter, INT);
+        llvm::Value* l = converted_left->getValue();
+        llvm::Value* r = converted_right->getValue();
+
+        llvm::Value* result_and_overflow = emitIntBinopWithOverflow(l, r, op_type);
+        llvm::Value* result = emitter.getBuilder()->CreateExtractValue(result_and_overflow, { 0 });
+        llvm::Value* overflowed = emitter.getBuilder()->CreateExtractValue(result_and_overflow, { 1 });
+        llvm::Value* no_overflow = emitter.getBuilder()->CreateNot(overflowed);
+
+        createExprGuard(no_overflow, node, unw_info.current_stmt, [&]() {
+            llvm::Value* boxed_left = emitter.getBuilder()->CreateCall(g.funcs.boxInt, l);
+            llvm::Value* boxed_right = emitter.getBuilder()->CreateCall(g.funcs.boxInt, r);
+            return emitter.createCall3(UnwindInfo(unw_info.current_stmt, NULL),
+                                       exp_type == AugBinOp ? g.funcs.augbinop : g.funcs.binop, boxed_left,
+                                       boxed_right, getConstantInt(op_type, g.i32));
+        });
+
+        static StatCounter num_checked("num_checked_int_binops_emitted");
+        num_checked.log();
+
+        converted_left->decvref(emitter);
+        converted_right->decvref(emitter);
+        return new ConcreteCompilerVariable(INT, result, true);
+    }
+
+    // Sites that see a mix of ints and floats (ex numeric code that gets passed either) don't get speculated on,
+    // since no single class covers them.  If the type feedback says that's all they see, we switch on the classes
+    // of the operands instead: int (op) int and the float cases get done unboxed, and everything else (including
+    // int overflow) goes through the generic binop.  The result is boxed either way, so the type analysis doesn't
+    // need to know about it.
+    bool isNumericTypeSwitchBinop(AST_expr* node, CompilerVariable* left, CompilerVariable* right,
+                                  AST_TYPE::AST_TYPE op_type, bool* sees_ints, bool* sees_floats) {
+        if (!ENABLE_SPECULATION || irstate->getEffortLevel() < EffortLevel::MODERATE)
+            return false;
+        if (op_type != AST_TYPE::Add && op_type != AST_TYPE::Sub && op_type != AST_TYPE::Mult)
+            return false;
+        if (types->speculatedExprClass(node))
+            return false;
+
+        ConcreteCompilerType* left_type = left->getConcreteType();
+        ConcreteCompilerType* right_type = right->getConcreteType();
+        for (ConcreteCompilerType* t : { left_type, right_type }) {
+            if (t != UNKNOWN && t != INT && t != FLOAT)
+                return false;
+        }
+        if (left_type != UNKNOWN && right_type != UNKNOWN)
+            return false;
+
+        BoxedClass* classes[3];
+        int num_classes = predictClassesFor(node, classes, 3);
+        if (num_classes < 2)
+            return false;
+
+        *sees_ints = *sees_floats = false;
+        for (int i = 0; i < num_classes; i++) {
+            if (classes[i] == int_cls)
+                *sees_ints = true;
+            else if (classes[i] == float_cls)
+                *sees_floats = true;
+            else if (classes[i] != long_cls) // int overflow
+                return false;
+        }
+        return *sees_ints || *sees_floats;
+    }
+
+    // An operand of a numeric type switch: which of the cases it can take, as i1s, and its value.
+    struct NumericOperand {
+        CompilerVariable* var;
+        ConcreteCompilerVariable* converted;
+        llvm::Value* is_int, *is_float;
+    };
+
+    NumericOperand makeNumericOperand(CompilerVariable* var) {
+        NumericOperand rtn;
+        rtn.var = var;
+        rtn.converted = var->makeConverted(emitter, var->getConcreteType());
+        if (rtn.converted->getType() == UNKNOWN) {
+            rtn.is_int = rtn.converted->makeClassCheck(emitter, int_cls);
+            rtn.is_float = rtn.converted->makeClassCheck(emitter, float_cls);
+        } else {
+            rtn.is_int = getConstantInt(rtn.converted->getType() == INT, g.i1);
+            rtn.is_float = getConstantInt(rtn.converted->getType() == FLOAT, g.i1);
+        }
+        return rtn;
+    }
+
+    // Only valid if the operand is an int:
+    llvm::Value* getNumericOperandInt(const NumericOperand& op) {
+        if (op.converted->getType() == INT)
+            return op.converted->getValue();
+        assert(op.converted->getType() == UNKNOWN);
+        return emitter.getBuilder()->CreateCall(g.funcs.unboxInt, op.converted->getValue());
+    }
+
+    // Only valid if the operand is an int or a float:
+    llvm::Value* getNumericOperandDouble(const NumericOperand& op) {
+        if (op.converted->getType() == FLOAT)
+            return op.converted->getValue();
+        if (op.converted->getType() == INT)
+            return emitter.getBuilder()->CreateSIToFP(op.converted->getValue(), g.double_);
+
+        llvm::BasicBlock* float_bb = emitter.createBasicBlock("unbox_float");
+        llvm::BasicBlock* int_bb = emitter.createBasicBlock("unbox_int_as_float");
+        llvm::BasicBlock* join_bb = emitter.createBasicBlock("unboxed_float");
+        emitter.getBuilder()->CreateCondBr(op.is_float, float_bb, int_bb);
+
+        emitter.setCurrentBasicBlock(float_bb);
+        llvm::Value* d = emitter.getBuilder()->CreateCall(g.funcs.unboxFloat, op.converted->getValue());
+        emitter.getBuilder()->CreateBr(join_bb);
+
+        emitter.setCurrentBasicBlock(int_bb);
+        llvm::Value* i = emitter.getBuilder()->CreateSIToFP(getNumericOperandInt(op), g.double_);
+        emitter.getBuilder()->CreateBr(join_bb);
+
+        emitter.setCurrentBasicBlock(join_bb);
+        llvm::PHINode* phi = emitter.getBuilder()->CreatePHI(g.double_, 2);
+        phi->addIncoming(d, float_bb);
+        phi->addIncoming(i, int_bb);
+        return phi;
+    }
+
+    CompilerVariable* evalNumericTypeSwitchBinop(AST_expr* node, CompilerVariable* left, CompilerVariable* right,
+                                                 AST_TYPE::AST_TYPE op_type, BinExpType exp_type, bool sees_ints,
+                                                 bool sees_floats, UnwindInfo unw_info) {
+        static StatCounter num_switches("num_numeric_type_switches_emitted");
+        num_switches.log();
+
+        NumericOperand l = makeNumericOperand(left);
+        NumericOperand r = makeNumericOperand(right);
+
+        llvm::BasicBlock* generic_bb = emitter.createBasicBlock("numeric_binop_generic");
+        llvm::BasicBlock* join_bb = emitter.createBasicBlock("numeric_binop_done");
+        std::vector<std::pair<llvm::Value*, llvm::BasicBlock*>> results;
+
+        if (sees_ints) {
+            llvm::BasicBlock* int_bb = emitter.createBasicBlock("numeric_binop_int");
+            llvm::BasicBlock* next_bb = emitter.createBasicBlock("numeric_binop_not_int");
+            emitter.getBuilder()->CreateCondBr(emitter.getBuilder()->CreateAnd(l.is_int, r.is_int), int_bb, next_bb);
+
+            emitter.setCurrentBasicBlock(int_bb);
+            llvm::Value* result_and_overflow
+                = emitIntBinopWithOverflow(getNumericOperandInt(l), getNumericOperandInt(r), op_type);
+            llvm::Value* overflowed = emitter.getBuilder()->CreateExtractValue(result_and_overflow, { 1 });
+            llvm::BasicBlock* no_overflow_bb = emitter.createBasicBlock("numeric_binop_int_done");
+            emitter.getBuilder()->CreateCondBr(overflowed, generic_bb, no_overflow_bb);
+
+            emitter.setCurrentBasicBlock(no_overflow_bb);
+            llvm::Value* result = emitter.getBuilder()->CreateExtractValue(result_and_overflow, { 0 });
+            results.push_back(std::make_pair(emitter.getBuilder()->CreateCall(g.funcs.boxInt, result),
+                                             emitter.currentBasicBlock()));
+            emitter.getBuilder()->CreateBr(join_bb);
+
+            emitter.setCurrentBasicBlock(next_bb);
+        }
+
+        if (sees_floats) {
+            // Either operand can be an int, as long as one of them is a float:
+            llvm::Value* is_float_op = emitter.getBuilder()->CreateAnd(
+                emitter.getBuilder()->CreateOr(l.is_float, r.is_float),
+                emitter.getBuilder()->CreateAnd(emitter.getBuilder()->CreateOr(l.is_float, l.is_int),
+                                                emitter.getBuilder()->CreateOr(r.is_float, r.is_int)));
+            llvm::BasicBlock* float_bb = emitter.createBasicBlock("numeric_binop_float");
+            emitter.getBuilder()->CreateCondBr(is_float_op, float_bb, generic_bb);
+
+            emitter.setCurrentBasicBlock(float_bb);
+            llvm::Value* ld = getNumericOperandDouble(l);
+            llvm::Value* rd = getNumericOperandDouble(r);
+            llvm::Value* result;
+            if (op_type == AST_TYPE::Add)
+                result = emitter.getBuilder()->CreateFAdd(ld, rd);
+            else if (op_type == AST_TYPE::Sub)
+                result = emitter.getBuilder()->CreateFSub(ld, rd);
+            else
+                result = emitter.getBuilder()->CreateFMul(ld, rd);
+            results.push_back(std::make_pair(emitter.getBuilder()->CreateCall(g.funcs.boxFloat, result),
+                                             emitter.currentBasicBlock()));
+            emitter.getBuilder()->CreateBr(join_bb);
+        } else {
+            emitter.getBuilder()->CreateBr(generic_bb);
+        }
+
+        emitter.setCurrentBasicBlock(generic_bb);
+        CompilerVariable* generic_rtn = _evalBinExp(node, l.converted, r.converted, op_type, exp_type, unw_info);
+        ConcreteCompilerVariable* converted_generic = generic_rtn->makeConverted(emitter, UNKNOWN);
+        generic_rtn->decvref(emitter);
+        results.push_back(std::make_pair(converted_generic->getValue(), emitter.currentBasicBlock()));
+        emitter.getBuilder()->CreateBr(join_bb);
+
+        emitter.setCurrentBasicBlock(join_bb);
+        llvm::PHINode* phi = emitter.getBuilder()->CreatePHI(g.llvm_value_type_ptr, results.size());
+        for (auto& p : results)
+            phi->addIncoming(p.first, p.second);
+
+        converted_generic->decvref(emitter);
+        l.converted->decvref(emitter);
+        r.converted->decvref(emitter);
+        return new ConcreteCompilerVariable(UNKNOWN, phi, true);
+    }
+
     CompilerVariable* evalBinOp(AST_BinOp* node, UnwindInfo unw_info) {
         CompilerVariable* left = evalExpr(node->left, unw_info);
         CompilerVariable* right = evalExpr(node->right, unw_info);
 
         assert(node->op_type != AST_TYPE::Is && node->op_type != AST_TYPE::IsNot && "not tested yet");
 
-        CompilerVariable* rtn = this->_evalBinExp(node, left, right, node->op_type, BinOp, unw_info);
+        CompilerVariable* rtn;
+        bool sees_ints, sees_floats;
+        if (isCheckedIntBinop(node, left, right, node->op_type))
+            rtn = evalCheckedIntBinop(node, left, right, node->op_type, BinOp, unw_info);
+        else if (isNumericTypeSwitchBinop(node, left, right, node->op_type, &sees_ints, &sees_floats))
+            rtn = evalNumericTypeSwitchBinop(node, left, right, node->op_type, BinOp, sees_ints, sees_floats,
+                                             unw_info);
+        else
+            rtn = this->_evalBinExp(node, left, right, node->op_type, BinOp, unw_info);
         left->decvref(emitter);
         right->decvref(emitter);
         return rtn;
@@ -764,7 +1018,15 @@ private:
 
         assert(node->op_type != AST_TYPE::Is && node->op_type != AST_TYPE::IsNot && "not tested yet");
 
-        CompilerVariable* rtn = this->_evalBinExp(node, left, right, node->op_type, AugBinOp, unw_info);
+        CompilerVariable* rtn;
+        bool sees_ints, sees_floats;
+        if (isCheckedIntBinop(node, left, right, node->op_type))
+            rtn = evalCheckedIntBinop(node, left, right, node->op_type, AugBinOp, unw_info);
+        else if (isNumericTypeSwitchBinop(node, left, right, node->op_type, &sees_ints, &sees_floats))
+            rtn = evalNumericTypeSwitchBinop(node, left, right, node->op_type, AugBinOp, sees_ints, sees_floats,
+                                             unw_info);
+        else
+            rtn = this->_evalBinExp(node, left, right, node->op_type, AugBinOp, unw_info);
         left->decvref(emitter);
         right->decvref(emitter);
         return rtn;
@@ -785,6 +1047,110 @@ private:
         return rtn;
     }
 
+    // At the highest effort level, a call to a global Python function gets turned into a direct call into the
+    // callee's compiled code, guarded on the global still being the function we saw at compile time.
+    // Returns the version to call, or NULL if this call site doesn't qualify.
+    CompiledFunction* getDirectCallTarget(AST_Call* node, CompilerVariable* func,
+                                          const std::vector<CompilerVariable*>& args, BoxedFunction** target) {
+        if (!ENABLE_DIRECT_CALLS || irstate->getEffortLevel() != EffortLevel::MAXIMAL)
+            return NULL;
+        if (node->func->type != AST_TYPE::Name || node->keywords.size() || node->starargs || node->kwargs)
+            return NULL;
+        if (func->getType() != UNKNOWN)
+            return NULL;
+
+        AST_Name* name = ast_cast<AST_Name>(node->func);
+        if (irstate->getScopeInfo()->getScopeTypeOfName(name->id) != ScopeInfo::VarScopeType::GLOBAL)
+            return NULL;
+
+        Box* val = irstate->getSourceInfo()->parent_module->getattr(name->id.str());
+        if (!val || val->cls != function_cls)
+            return NULL;
+
+        BoxedFunction* f = static_cast<BoxedFunction*>(val);
+        CLFunction* cl = f->f;
+        if (!cl->source || cl->source->is_generator || f->closure || f->globals)
+            return NULL;
+        if (cl->takes_varargs || cl->takes_kwargs)
+            return NULL;
+        // Filling in defaults would mean embedding them, and they can be changed without changing the function:
+        if (args.size() != cl->num_args)
+            return NULL;
+        // Calling an older version of ourselves would skip the code we're generating right now:
+        if (cl == irstate->getCurFunction()->clfunc)
+            return NULL;
+
+        CompiledFunction* cf = findDirectCallVersion(f, args);
+        if (!cf)
+            return NULL;
+
+        *target = f;
+        return cf;
+    }
+
+    CompilerVariable* emitDirectCall(AST_Call* node, CompilerVariable* func, BoxedFunction* target,
+                                     CompiledFunction* cf, ArgPassSpec argspec,
+                                     const std::vector<CompilerVariable*>& args, UnwindInfo unw_info) {
+        static StatCounter num_direct_calls("num_direct_python_calls_emitted");
+        num_direct_calls.log();
+
+        // The guard compares against the function's address, so it must never get freed and reused:
+        gc::registerPermanentRoot(target, true);
+
+        ConcreteCompilerVariable* converted_func = func->makeConverted(emitter, UNKNOWN);
+        llvm::Value* is_target = emitter.getBuilder()->CreateICmpEQ(
+            converted_func->getValue(), embedRelocatablePtr(target, g.llvm_value_type_ptr));
+
+        // Once the callee version gets replaced (reoptimized, evicted, or killed for failing its speculations),
+        // calls go through the generic path, which picks the current version.  Since nothing can call into cf
+        // after that, it doesn't need to get pinned, and its code can get freed like any other.
+        static_assert(sizeof(cf->retired) == 1, "");
+        llvm::Value* retired
+            = emitter.getBuilder()->CreateLoad(embedRelocatablePtr(&cf->retired, g.i8->getPointerTo()), true);
+        llvm::Value* is_current
+            = emitter.getBuilder()->CreateICmpEQ(retired, llvm::ConstantInt::get(g.i8, 0, false));
+        is_target = emitter.getBuilder()->CreateAnd(is_target, is_current);
+
+        llvm::Metadata* md_vals[]
+            = { llvm::MDString::get(g.context, "branch_weights"), llvm::ConstantAsMetadata::get(getConstantInt(1000)),
+                llvm::ConstantAsMetadata::get(getConstantInt(1)) };
+        llvm::MDNode* branch_weights = llvm::MDNode::get(g.context, llvm::ArrayRef<llvm::Metadata*>(md_vals));
+
+        llvm::BasicBlock* direct_bb = emitter.createBasicBlock("direct_call");
+        llvm::BasicBlock* generic_bb = emitter.createBasicBlock("generic_call");
+        llvm::BasicBlock* join_bb = emitter.createBasicBlock("call_done");
+        emitter.getBuilder()->CreateCondBr(is_target, direct_bb, generic_bb, branch_weights);
+
+        // If the guard fails we just fall back to the normal call path, rather than deoptimizing the whole
+        // function; rebinding a global function is rare, but not rare enough to throw away this version for.
+        emitter.setCurrentBasicBlock(direct_bb);
+        ConcreteCompilerVariable* direct_rtn
+            = callCompiledVersionDirectly(emitter, getOpInfoForNode(node, unw_info), target, cf, argspec, args);
+        ConcreteCompilerVariable* converted_direct = direct_rtn->makeConverted(emitter, UNKNOWN);
+        direct_rtn->decvref(emitter);
+        llvm::BasicBlock* direct_end = emitter.currentBasicBlock();
+        emitter.getBuilder()->CreateBr(join_bb);
+
+        emitter.setCurrentBasicBlock(generic_bb);
+        CompilerVariable* generic_rtn
+            = converted_func->call(emitter, getOpInfoForNode(node, unw_info), argspec, args, NULL);
+        ConcreteCompilerVariable* converted_generic = generic_rtn->makeConverted(emitter, UNKNOWN);
+        generic_rtn->decvref(emitter);
+        llvm::BasicBlock* generic_end = emitter.currentBasicBlock();
+        emitter.getBuilder()->CreateBr(join_bb);
+
+        emitter.setCurrentBasicBlock(join_bb);
+        llvm::PHINode* phi = emitter.getBuilder()->CreatePHI(g.llvm_value_type_ptr, 2);
+        phi->addIncoming(converted_direct->getValue(), direct_end);
+        phi->addIncoming(converted_generic->getValue(), generic_end);
+
+        converted_direct->decvref(emitter);
+        converted_generic->decvref(emitter);
+        converted_func->decvref(emitter);
+
+        return new ConcreteCompilerVariable(UNKNOWN, phi, true);
+    }
+
     CompilerVariable* evalCall(AST_Call* node, UnwindInfo unw_info) {
         bool is_callattr;
         bool callattr_clsonly = false;
@@ -851,7 +1217,12 @@ private:
             CallattrFlags flags = {.cls_only = callattr_clsonly, .null_on_nonexistent = false };
             rtn = func->callattr(emitter, getOpInfoForNode(node, unw_info), attr, flags, argspec, args, keyword_names);
         } else {
-            rtn = func->call(emitter, getOpInfoForNode(node, unw_info), argspec, args, keyword_names);
+            BoxedFunction* target;
+            CompiledFunction* target_cf = getDirectCallTarget(node, func, args, &target);
+            if (target_cf)
+                rtn = emitDirectCall(node, func, target, target_cf, argspec, args, unw_info);
+            else
+                rtn = func->call(emitter, getOpInfoForNode(node, unw_info), argspec, args, keyword_names);
         }
 
         func->decvref(emitter);
@@ -1487,7 +1858,8 @@ private:
 
         // Out-guarding:
         BoxedClass* speculated_class = types->speculatedExprClass(node);
-        if (speculated_class != NULL) {
+        // (checked int arithmetic guards its own speculation)
+        if (speculated_class != NULL && !(speculated_class == int_cls && rtn->getType() == INT)) {
             assert(rtn);
 
             ConcreteCompilerType* speculated_type = typeFromClass(speculated_class);
@@ -1993,15 +2365,10 @@ private:
         llvm::Value* newcount = emitter.getBuilder()->CreateAdd(curcount, getConstantInt(1, g.i64));
         emitter.getBuilder()->CreateStore(newcount, edgecount_ptr);
 
-        auto effort = irstate->getEffortLevel();
-        int osr_threshold;
-        if (effort == EffortLevel::MINIMAL)
-            osr_threshold = OSR_THRESHOLD_BASELINE;
-        else if (effort == EffortLevel::MODERATE)
-            osr_threshold = OSR_THRESHOLD_T2;
-        else
-            RELEASE_ASSERT(0, "Unknown effort: %d", (int)effort);
-        llvm::Value* osr_test = emitter.getBuilder()->CreateICmpSGT(newcount, getConstantInt(osr_threshold));
+        CompiledFunction* cf = irstate->getCurFunction();
+        if (cf->osr_threshold == 0)
+            cf->osr_threshold = getOSRThreshold(irstate->getSourceInfo(), irstate->getEffortLevel());
+        llvm::Value* osr_test = emitter.getBuilder()->CreateICmpSGT(newcount, getConstantInt(cf->osr_threshold));
 
         llvm::Metadata* md_vals[]
             = { llvm::MDString::get(g.context, "branch_weights"), llvm::ConstantAsMetadata::get(getConstantInt(1)),
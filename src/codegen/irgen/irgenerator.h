@@ -56,8 +56,9 @@ class IRGenState {
 private:
     CompiledFunction* cf;
     SourceInfo* source_info;
-    std::unique_ptr<LivenessAnalysis> liveness;
-    std::unique_ptr<PhiAnalysis> phis;
+    // Not owned: these are either cached on the SourceInfo, or (for the phis of an OSR entry) owned by doCompile().
+    LivenessAnalysis* liveness;
+    PhiAnalysis* phis;
     ParamNames* param_names;
     GCBuilder* gc;
     llvm::MDNode* func_dbg_info;
@@ -70,8 +71,8 @@ private:
 
 
 public:
-    IRGenState(CompiledFunction* cf, SourceInfo* source_info, std::unique_ptr<LivenessAnalysis> liveness,
-               std::unique_ptr<PhiAnalysis> phis, ParamNames* param_names, GCBuilder* gc, llvm::MDNode* func_dbg_info);
+    IRGenState(CompiledFunction* cf, SourceInfo* source_info, LivenessAnalysis* liveness, PhiAnalysis* phis,
+               ParamNames* param_names, GCBuilder* gc, llvm::MDNode* func_dbg_info);
     ~IRGenState();
 
     CompiledFunction* getCurFunction() { return cf; }
@@ -90,8 +91,8 @@ public:
 
     SourceInfo* getSourceInfo() { return source_info; }
 
-    LivenessAnalysis* getLiveness() { return liveness.get(); }
-    PhiAnalysis* getPhis() { return phis.get(); }
+    LivenessAnalysis* getLiveness() { return liveness; }
+    PhiAnalysis* getPhis() { return phis; }
 
     ScopeInfo* getScopeInfo();
     ScopeInfo* getScopeInfoForNode(AST* node);
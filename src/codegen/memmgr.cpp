@@ -14,15 +14,19 @@
 
 #include "codegen/memmgr.h"
 
+#include <unordered_map>
+
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Memory.h"
 
+#include "codegen/codegen.h"
 #include "codegen/irgen/util.h"
 #include "core/common.h"
 #include "core/stats.h"
+#include "core/types.h"
 #include "core/util.h"
 
 // This code was copy-pasted from SectionMemoryManager.cpp;
@@ -34,7 +38,7 @@ namespace pyston {
 
 class PystonMemoryManager : public RTDyldMemoryManager {
 public:
-    PystonMemoryManager() {}
+    PystonMemoryManager() : FreeMemOwner(NULL) {}
     ~PystonMemoryManager() override;
 
     uint8_t* allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
@@ -45,15 +49,27 @@ public:
 
     bool finalizeMemory(std::string* ErrMsg = 0) override;
 
+    void registerEHFrames(uint8_t* Addr, uint64_t LoadAddr, size_t Size) override;
+
+    // pyston: frees everything that got allocated while compiling cf (see g.cur_cf).
+    void releaseMemoryFor(CompiledFunction* cf);
+
 private:
     void invalidateInstructionCache();
 
     struct MemoryGroup {
         SmallVector<sys::MemoryBlock, 16> AllocatedMem;
         SmallVector<sys::MemoryBlock, 16> FreeMem;
+        // pyston: whole blocks that got released (see releaseMemoryFor), to hand out again before mapping new ones.
+        SmallVector<sys::MemoryBlock, 16> RecycledMem;
         sys::MemoryBlock Near;
     };
 
+    // How many released blocks each group keeps around for reuse; the rest get unmapped.
+    static const int MAX_RECYCLED_BLOCKS = 64;
+
+    sys::MemoryBlock takeRecycledBlock(MemoryGroup& MemGroup, uintptr_t Size);
+
     uint8_t* allocateSection(MemoryGroup& MemGroup, uintptr_t Size, unsigned Alignment, StringRef SectionName);
 
     llvm_error_code applyMemoryGroupPermissions(MemoryGroup& MemGroup, unsigned Permissions);
@@ -63,8 +79,27 @@ private:
     MemoryGroup CodeMem;
     MemoryGroup RWDataMem;
     MemoryGroup RODataMem;
+
+    // pyston: the memory that got mapped for each CompiledFunction.  To be able to free it separately, each
+    // CompiledFunction gets its own blocks; FreeMemOwner is the one that the current free blocks belong to.  This is
+    // independent of the code cache limit, which only decides when versions get evicted (see codegen/code_cache.h):
+    // the code of retired versions always gets freed, and their blocks get reused by the versions compiled after
+    // them.
+    struct EHFrame {
+        uint8_t* Addr;
+        uint64_t LoadAddr;
+        size_t Size;
+    };
+    struct Allocation {
+        SmallVector<sys::MemoryBlock, 4> Blocks;
+        SmallVector<EHFrame, 1> EHFrames;
+    };
+    std::unordered_map<CompiledFunction*, Allocation> Allocations;
+    CompiledFunction* FreeMemOwner;
 };
 
+static PystonMemoryManager* jit_memory_manager;
+
 uint8_t* PystonMemoryManager::allocateDataSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
                                                   StringRef SectionName, bool IsReadOnly) {
     // printf("allocating data section: %ld %d %d %s %d\n", Size, Alignment, SectionID, SectionName.data(), IsReadOnly);
@@ -87,6 +122,14 @@ uint8_t* PystonMemoryManager::allocateSection(MemoryGroup& MemGroup, uintptr_t S
 
     assert(!(Alignment & (Alignment - 1)) && "Alignment must be a power of two.");
 
+    CompiledFunction* Owner = g.cur_cf;
+    if (Owner != FreeMemOwner) {
+        CodeMem.FreeMem.clear();
+        RWDataMem.FreeMem.clear();
+        RODataMem.FreeMem.clear();
+        FreeMemOwner = Owner;
+    }
+
     uintptr_t RequiredSize = Alignment * ((Size + Alignment - 1) / Alignment + 1);
     uintptr_t Addr = 0;
 
@@ -114,16 +157,24 @@ uint8_t* PystonMemoryManager::allocateSection(MemoryGroup& MemGroup, uintptr_t S
     //
     // FIXME: Initialize the Near member for each memory group to avoid
     // interleaving.
-    llvm_error_code ec;
-    sys::MemoryBlock MB = sys::Memory::allocateMappedMemory(RequiredSize, &MemGroup.Near,
-                                                            sys::Memory::MF_READ | sys::Memory::MF_WRITE, ec);
-    if (ec) {
-        // FIXME: Add error propogation to the interface.
-        return NULL;
+    sys::MemoryBlock MB = takeRecycledBlock(MemGroup, RequiredSize);
+    if (!MB.base()) {
+        llvm_error_code ec;
+        MB = sys::Memory::allocateMappedMemory(RequiredSize, &MemGroup.Near,
+                                               sys::Memory::MF_READ | sys::Memory::MF_WRITE, ec);
+        if (ec) {
+            // FIXME: Add error propogation to the interface.
+            return NULL;
+        }
+
+        std::string stat_name = "mem_section_" + std::string(SectionName);
+        Stats::log(Stats::getStatId(stat_name), MB.size());
     }
 
-    std::string stat_name = "mem_section_" + std::string(SectionName);
-    Stats::log(Stats::getStatId(stat_name), MB.size());
+    if (Owner) {
+        Allocations[Owner].Blocks.push_back(MB);
+        Owner->code_memory_bytes += MB.size();
+    }
 
     // Save this address as the basis for our next request
     MemGroup.Near = MB;
@@ -150,7 +201,7 @@ bool PystonMemoryManager::finalizeMemory(std::string* ErrMsg) {
     llvm_error_code ec;
 
     // Don't allow free memory blocks to be used after setting protection flags.
-    CodeMem.FreeMem.clear();
+    // pyston: code memory stays writeable, so the rest of the current owner's code block can still be used.
 
     // Make code memory executable.
     // pyston: also make it writeable so we can patch it later
@@ -206,6 +257,83 @@ void PystonMemoryManager::invalidateInstructionCache() {
         sys::Memory::InvalidateInstructionCache(CodeMem.AllocatedMem[i].base(), CodeMem.AllocatedMem[i].size());
 }
 
+void PystonMemoryManager::registerEHFrames(uint8_t* Addr, uint64_t LoadAddr, size_t Size) {
+    if (g.cur_cf)
+        Allocations[g.cur_cf].EHFrames.push_back(EHFrame{ Addr, LoadAddr, Size });
+    RTDyldMemoryManager::registerEHFrames(Addr, LoadAddr, Size);
+}
+
+static bool removeBlock(SmallVectorImpl<sys::MemoryBlock>& Blocks, const sys::MemoryBlock& MB) {
+    for (auto it = Blocks.begin(), end = Blocks.end(); it != end; ++it) {
+        if (it->base() == MB.base()) {
+            Blocks.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+sys::MemoryBlock PystonMemoryManager::takeRecycledBlock(MemoryGroup& MemGroup, uintptr_t Size) {
+    // Take the smallest one that fits:
+    auto best = MemGroup.RecycledMem.end();
+    for (auto it = MemGroup.RecycledMem.begin(), end = MemGroup.RecycledMem.end(); it != end; ++it) {
+        if (it->size() >= Size && (best == end || it->size() < best->size()))
+            best = it;
+    }
+    if (best == MemGroup.RecycledMem.end())
+        return sys::MemoryBlock();
+
+    sys::MemoryBlock MB = *best;
+    MemGroup.RecycledMem.erase(best);
+
+    // It has the permissions of its previous owner's group until it gets finalized again:
+    llvm_error_code ec = sys::Memory::protectMappedMemory(MB, sys::Memory::MF_READ | sys::Memory::MF_WRITE);
+    RELEASE_ASSERT(!ec, "%s", ec.message().c_str());
+
+    static StatCounter bytes_reused("jit_memory_bytes_reused");
+    bytes_reused.log(MB.size());
+    return MB;
+}
+
+void PystonMemoryManager::releaseMemoryFor(CompiledFunction* cf) {
+    auto it = Allocations.find(cf);
+    if (it == Allocations.end())
+        return;
+
+    for (const EHFrame& EH : it->second.EHFrames)
+        RTDyldMemoryManager::deregisterEHFrames(EH.Addr, EH.LoadAddr, EH.Size);
+
+    if (FreeMemOwner == cf) {
+        CodeMem.FreeMem.clear();
+        RWDataMem.FreeMem.clear();
+        RODataMem.FreeMem.clear();
+        FreeMemOwner = NULL;
+    }
+
+    static StatCounter bytes_released("jit_memory_bytes_released");
+    for (const sys::MemoryBlock& MB : it->second.Blocks) {
+        MemoryGroup* MemGroup = NULL;
+        for (MemoryGroup* G : { &CodeMem, &RWDataMem, &RODataMem }) {
+            if (removeBlock(G->AllocatedMem, MB)) {
+                MemGroup = G;
+                break;
+            }
+        }
+        assert(MemGroup);
+        bytes_released.log(MB.size());
+
+        if (MemGroup->RecycledMem.size() < MAX_RECYCLED_BLOCKS) {
+            MemGroup->RecycledMem.push_back(MB);
+        } else {
+            sys::MemoryBlock Block = MB;
+            sys::Memory::releaseMappedMemory(Block);
+        }
+    }
+    cf->code_memory_bytes = 0;
+
+    Allocations.erase(it);
+}
+
 uint64_t PystonMemoryManager::getSymbolAddress(const std::string& name) {
     uint64_t base = (uint64_t)getValueOfRelocatableSym(name);
     if (base)
@@ -230,19 +358,30 @@ PystonMemoryManager::~PystonMemoryManager() {
         sys::Memory::releaseMappedMemory(RWDataMem.AllocatedMem[i]);
     for (unsigned i = 0, e = RODataMem.AllocatedMem.size(); i != e; ++i)
         sys::Memory::releaseMappedMemory(RODataMem.AllocatedMem[i]);
+    for (MemoryGroup* G : { &CodeMem, &RWDataMem, &RODataMem }) {
+        for (sys::MemoryBlock& MB : G->RecycledMem)
+            sys::Memory::releaseMappedMemory(MB);
+    }
 }
 
 std::unique_ptr<llvm::RTDyldMemoryManager> createMemoryManager() {
-    return std::unique_ptr<llvm::RTDyldMemoryManager>(new PystonMemoryManager());
+    assert(!jit_memory_manager);
+    jit_memory_manager = new PystonMemoryManager();
+    return std::unique_ptr<llvm::RTDyldMemoryManager>(jit_memory_manager);
+}
+
+void releaseJITMemory(CompiledFunction* cf) {
+    assert(jit_memory_manager);
+    jit_memory_manager->releaseMemoryFor(cf);
 }
 
 // These functions exist as instance methods of the RTDyldMemoryManager class,
 // but it's tricky to access them since the class has pure-virtual methods.
 void registerEHFrames(uint8_t* addr, uint64_t load_addr, size_t size) {
-    PystonMemoryManager().registerEHFrames(addr, load_addr, size);
+    PystonMemoryManager().RTDyldMemoryManager::registerEHFrames(addr, load_addr, size);
 }
 
 void deregisterEHFrames(uint8_t* addr, uint64_t load_addr, size_t size) {
-    PystonMemoryManager().deregisterEHFrames(addr, load_addr, size);
+    PystonMemoryManager().RTDyldMemoryManager::deregisterEHFrames(addr, load_addr, size);
 }
 }
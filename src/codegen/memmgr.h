@@ -25,7 +25,11 @@ class RTDyldMemoryManager;
 
 namespace pyston {
 
+class CompiledFunction;
+
 std::unique_ptr<llvm::RTDyldMemoryManager> createMemoryManager();
+// Unmaps the code and data sections of a CompiledFunction, and deregisters its EH frames.
+void releaseJITMemory(CompiledFunction* cf);
 void registerEHFrames(uint8_t* addr, uint64_t load_addr, size_t size);
 void deregisterEHFrames(uint8_t* addr, uint64_t load_addr, size_t size);
 }
@@ -12,10 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/Passes.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instructions.h"
@@ -142,4 +146,251 @@ char RemoveDuplicateBoxingPass::ID = 0;
 BasicBlockPass* createRemoveDuplicateBoxingPass() {
     return new RemoveDuplicateBoxingPass();
 }
+
+// This pass scalar-replaces boxed ints, floats and bools that only get unboxed again, even when the box and the unbox
+// end up in different BBs, with phis in between (typically a loop-carried variable that has to be boxed across the
+// backedge).
+// E.g.:
+// %5 = call %"class.pyston::Box"* @boxFloat(double %4)
+// ...
+// %8 = phi %"class.pyston::Box"* [ %5, %bb1 ], [ %7, %bb2 ]
+// %9 = call double @unboxFloat(%"class.pyston::Box"* %8)
+// --> %9 will be replaced with a phi of the unboxed values, and the boxing calls become dead if that was their only
+// use.
+class UnboxThroughPhisPass : public FunctionPass {
+private:
+    // Checks whether v is (transitively, through phis) only ever the result of calls to box_func.
+    bool comesFromBoxing(Value* v, void* box_func, Type* unboxed_type, std::unordered_set<PHINode*>& phis) {
+        v = v->stripPointerCasts();
+
+        if (CallInst* CI = dyn_cast<CallInst>(v))
+            return getCalledFuncAddr(CI) == box_func && CI->getArgOperand(0)->getType() == unboxed_type;
+
+        if (PHINode* phi = dyn_cast<PHINode>(v)) {
+            if (!phis.insert(phi).second)
+                return true;
+            for (int i = 0; i < phi->getNumIncomingValues(); i++) {
+                if (!comesFromBoxing(phi->getIncomingValue(i), box_func, unboxed_type, phis))
+                    return false;
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    Value* getUnboxed(Value* v, std::unordered_map<PHINode*, PHINode*>& unboxed_phis) {
+        v = v->stripPointerCasts();
+
+        if (CallInst* CI = dyn_cast<CallInst>(v))
+            return CI->getArgOperand(0);
+
+        PHINode* phi = cast<PHINode>(v);
+        auto it = unboxed_phis.find(phi);
+        if (it != unboxed_phis.end())
+            return it->second;
+        return NULL;
+    }
+
+public:
+    static char ID;
+    UnboxThroughPhisPass() : FunctionPass(ID) {}
+
+    virtual void getAnalysisUsage(AnalysisUsage& info) const { info.setPreservesCFG(); }
+
+    virtual bool runOnFunction(Function& F) {
+        StatCounter sc_num_unboxes("opt_unboxes_through_phis");
+
+        std::vector<CallInst*> unbox_calls;
+        for (inst_iterator inst_it = inst_begin(F), _inst_end = inst_end(F); inst_it != _inst_end; ++inst_it) {
+            CallInst* CI = dyn_cast<CallInst>(&*inst_it);
+            if (!CI)
+                continue;
+
+            void* func = getCalledFuncAddr(CI);
+            if (func == unboxInt || func == unboxFloat || func == unboxBool)
+                unbox_calls.push_back(CI);
+        }
+
+        // Shared between all the unbox calls, so that a phi web only gets unboxed once:
+        std::unordered_map<PHINode*, PHINode*> unboxed_phis;
+
+        int num_changed = 0;
+        for (CallInst* CI : unbox_calls) {
+            void* unbox_func = getCalledFuncAddr(CI);
+            void* box_func;
+            if (unbox_func == unboxInt)
+                box_func = (void*)boxInt;
+            else if (unbox_func == unboxFloat)
+                box_func = (void*)boxFloat;
+            else
+                box_func = (void*)boxBool;
+
+            Value* boxed = CI->getArgOperand(0)->stripPointerCasts();
+            // The plain box->unbox case is handled by the other passes (and by instcombine after inlining):
+            if (!isa<PHINode>(boxed))
+                continue;
+
+            std::unordered_set<PHINode*> phis;
+            if (!comesFromBoxing(boxed, box_func, CI->getType(), phis))
+                continue;
+
+            // First create all the phis, then fill them in, since the phis can refer to each other:
+            for (PHINode* phi : phis) {
+                if (unboxed_phis.count(phi))
+                    continue;
+                unboxed_phis[phi] = PHINode::Create(CI->getType(), phi->getNumIncomingValues(),
+                                                    phi->getName() + ".unboxed", phi);
+            }
+            for (PHINode* phi : phis) {
+                PHINode* new_phi = unboxed_phis[phi];
+                if (new_phi->getNumIncomingValues())
+                    continue;
+                for (int i = 0; i < phi->getNumIncomingValues(); i++) {
+                    Value* v = getUnboxed(phi->getIncomingValue(i), unboxed_phis);
+                    assert(v);
+                    new_phi->addIncoming(v, phi->getIncomingBlock(i));
+                }
+            }
+
+            CI->replaceAllUsesWith(unboxed_phis[cast<PHINode>(boxed)]);
+            CI->eraseFromParent();
+            ++num_changed;
+            sc_num_unboxes.log();
+        }
+
+        // The boxed phis that we replaced are probably dead now, and they keep the boxing calls alive; they can
+        // refer to each other (in loops), so find out which ones are still needed from outside the phi web:
+        std::unordered_set<PHINode*> alive;
+        std::vector<PHINode*> worklist;
+        for (auto&& p : unboxed_phis) {
+            for (User* user : p.first->users()) {
+                PHINode* user_phi = dyn_cast<PHINode>(user);
+                if (!user_phi || !unboxed_phis.count(user_phi)) {
+                    alive.insert(p.first);
+                    worklist.push_back(p.first);
+                    break;
+                }
+            }
+        }
+        while (worklist.size()) {
+            PHINode* phi = worklist.back();
+            worklist.pop_back();
+            for (int i = 0; i < phi->getNumIncomingValues(); i++) {
+                PHINode* incoming_phi = dyn_cast<PHINode>(phi->getIncomingValue(i)->stripPointerCasts());
+                if (incoming_phi && unboxed_phis.count(incoming_phi) && alive.insert(incoming_phi).second)
+                    worklist.push_back(incoming_phi);
+            }
+        }
+        for (auto&& p : unboxed_phis) {
+            if (alive.count(p.first))
+                continue;
+            p.first->replaceAllUsesWith(UndefValue::get(p.first->getType()));
+        }
+        for (auto&& p : unboxed_phis) {
+            if (!alive.count(p.first))
+                p.first->eraseFromParent();
+        }
+
+        return num_changed > 0;
+    }
+};
+char UnboxThroughPhisPass::ID = 0;
+
+FunctionPass* createUnboxThroughPhisPass() {
+    return new UnboxThroughPhisPass();
+}
+
+// This pass moves boxing calls whose results are only needed on exit paths (the deopt blocks, error paths, the
+// final return) into those paths, so that the common path doesn't have to allocate.  Blocks without successors
+// run at most once per call, so this never increases the number of allocations, and boxing has no side effects
+// that we care about.  A box used from several exit blocks gets a copy in each of them.
+// It also deletes boxing calls that have no uses left.
+class SinkBoxingPass : public FunctionPass {
+public:
+    static char ID;
+    SinkBoxingPass() : FunctionPass(ID) {}
+
+    virtual void getAnalysisUsage(AnalysisUsage& info) const { info.setPreservesCFG(); }
+
+    virtual bool runOnFunction(Function& F) {
+        StatCounter sc_num_sunk("opt_sunk_boxes");
+        StatCounter sc_num_dead("opt_dead_boxes");
+
+        std::vector<CallInst*> boxing_calls;
+        for (inst_iterator inst_it = inst_begin(F), _inst_end = inst_end(F); inst_it != _inst_end; ++inst_it) {
+            CallInst* CI = dyn_cast<CallInst>(&*inst_it);
+            if (!CI)
+                continue;
+
+            void* func = getCalledFuncAddr(CI);
+            if (func == boxInt || func == boxFloat || func == boxBool)
+                boxing_calls.push_back(CI);
+        }
+
+        int num_changed = 0;
+        for (CallInst* CI : boxing_calls) {
+            if (CI->use_empty()) {
+                CI->eraseFromParent();
+                ++num_changed;
+                sc_num_dead.log();
+                continue;
+            }
+
+            // For each exit block that uses the box, the first instruction in it that does:
+            std::unordered_map<BasicBlock*, Instruction*> first_uses;
+            bool can_sink = true;
+            for (User* user : CI->users()) {
+                Instruction* I = dyn_cast<Instruction>(user);
+                if (!I || isa<PHINode>(I)) {
+                    can_sink = false;
+                    break;
+                }
+
+                BasicBlock* BB = I->getParent();
+                if (BB == CI->getParent() || succ_begin(BB) != succ_end(BB)) {
+                    can_sink = false;
+                    break;
+                }
+
+                Instruction*& first = first_uses[BB];
+                if (!first) {
+                    for (Instruction& inst : *BB) {
+                        if (std::find(inst.op_begin(), inst.op_end(), CI) != inst.op_end()) {
+                            first = &inst;
+                            break;
+                        }
+                    }
+                    assert(first);
+                }
+            }
+            if (!can_sink)
+                continue;
+
+            std::unordered_map<BasicBlock*, Instruction*> clones;
+            for (auto&& p : first_uses) {
+                Instruction* clone = CI->clone();
+                clone->insertBefore(p.second);
+                clones[p.first] = clone;
+            }
+
+            std::vector<Use*> uses;
+            for (Use& U : CI->uses())
+                uses.push_back(&U);
+            for (Use* U : uses)
+                U->set(clones[cast<Instruction>(U->getUser())->getParent()]);
+
+            CI->eraseFromParent();
+            ++num_changed;
+            sc_num_sunk.log();
+        }
+
+        return num_changed > 0;
+    }
+};
+char SinkBoxingPass::ID = 0;
+
+FunctionPass* createSinkBoxingPass() {
+    return new SinkBoxingPass();
+}
 }
@@ -0,0 +1,247 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "codegen/codegen.h"
+#include "codegen/irgen/util.h"
+#include "core/common.h"
+#include "core/options.h"
+#include "core/stats.h"
+#include "core/types.h"
+#include "runtime/objmodel.h"
+#include "runtime/types.h"
+
+using namespace llvm;
+
+namespace pyston {
+
+// This pass hoists class checks on loop-invariant objects out of loops:
+//   %cls = load %"class.pyston::BoxedClass"** %cls_ptr   ; %cls_ptr points into a loop-invariant object
+//   %check = icmp eq %"class.pyston::BoxedClass"* %cls, @float_cls
+// gets computed once in the preheader instead of once per iteration.
+//
+// This is only valid because the result of the check can't change while we're in the loop: we only do this
+// for checks against constant builtin classes without instance attributes, and __class__ assignment can't
+// turn an object into one of those or turn one of those into anything else.
+//
+// The hoisted load runs even if the loop would have exited (or thrown) before reaching the check, so we also need
+// the load to be safe to execute early: either LLVM knows that the pointer is dereferenceable, or the check is
+// guaranteed to run on every trip into the loop anyway.
+//
+// Once the condition is loop-invariant, the guard's branch is a loop-invariant branch, so the loop unswitching
+// pass (which runs later) can version the loop into a copy without the guard and a copy that goes to the deopt path.
+class HoistClassGuardsPass : public LoopPass {
+private:
+    static BoxedClass* getConstantClass(Value* v) {
+        v = v->stripPointerCasts();
+
+        if (ConstantExpr* ce = dyn_cast<ConstantExpr>(v)) {
+            if (ce->getOpcode() != Instruction::IntToPtr)
+                return NULL;
+            ConstantInt* ci = dyn_cast<ConstantInt>(ce->getOperand(0));
+            if (!ci)
+                return NULL;
+            return reinterpret_cast<BoxedClass*>(ci->getZExtValue());
+        }
+
+        if (GlobalVariable* gv = dyn_cast<GlobalVariable>(v))
+            return (BoxedClass*)getValueOfRelocatableSym(gv->getName());
+
+        return NULL;
+    }
+
+    // If li is a load of an object's class (see makeClassCheck), returns the object.
+    static Value* getClassLoadObject(LoadInst* li) {
+        if (li->isVolatile() || li->getType() != g.llvm_class_type_ptr)
+            return NULL;
+
+        Value* ptr = li->getPointerOperand();
+        if (GetElementPtrInst* gep = dyn_cast<GetElementPtrInst>(ptr)) {
+            if (gep->getNumIndices() != 2 || !gep->hasAllConstantIndices())
+                return NULL;
+            ConstantInt* idx0 = cast<ConstantInt>(gep->getOperand(1));
+            ConstantInt* idx1 = cast<ConstantInt>(gep->getOperand(2));
+            if (!idx0->isZero() || idx1->getZExtValue() != offsetof(Box, cls) / sizeof(void*))
+                return NULL;
+            return gep->getPointerOperand()->stripPointerCasts();
+        }
+
+        if (offsetof(Box, cls) == 0)
+            return ptr->stripPointerCasts();
+        return NULL;
+    }
+
+    // Makes a copy of the (side-effect-free) computation of v available at insert_pt, or returns NULL if we can't.
+    static Value* hoistValue(Value* v, Loop* L, Instruction* insert_pt) {
+        if (L->isLoopInvariant(v))
+            return v;
+
+        Instruction* I = cast<Instruction>(v);
+        if (!isa<GetElementPtrInst>(I) && !isa<BitCastInst>(I))
+            return NULL;
+
+        Instruction* clone = I->clone();
+        for (int i = 0; i < I->getNumOperands(); i++) {
+            Value* op = hoistValue(I->getOperand(i), L, insert_pt);
+            if (!op) {
+                delete clone;
+                return NULL;
+            }
+            clone->setOperand(i, op);
+        }
+        clone->insertBefore(insert_pt);
+        return clone;
+    }
+
+    // Whether I is guaranteed to execute (at least once) whenever the loop gets entered; like LICM's
+    // isGuaranteedToExecute.
+    static bool isGuaranteedToExecute(Instruction* I, Loop* L, DominatorTree* DT, bool loop_may_throw) {
+        BasicBlock* bb = I->getParent();
+
+        if (loop_may_throw) {
+            // Something might unwind out of the loop before we get here; the only instructions that we know
+            // will run are the ones in the header before the first instruction that can throw.
+            if (bb != L->getHeader())
+                return false;
+            for (Instruction& prev : *bb) {
+                if (&prev == I)
+                    return true;
+                if (prev.mayThrow())
+                    return false;
+            }
+            RELEASE_ASSERT(0, "");
+        }
+
+        if (bb == L->getHeader())
+            return true;
+
+        SmallVector<BasicBlock*, 8> exit_blocks;
+        L->getExitBlocks(exit_blocks);
+        // An infinite loop might never get to it:
+        if (exit_blocks.empty())
+            return false;
+        for (BasicBlock* exit : exit_blocks) {
+            if (!DT->dominates(bb, exit))
+                return false;
+        }
+        return true;
+    }
+
+public:
+    static char ID;
+    HoistClassGuardsPass() : LoopPass(ID) {}
+
+    virtual void getAnalysisUsage(AnalysisUsage& info) const {
+        info.addRequired<DominatorTreeWrapperPass>();
+        info.setPreservesCFG();
+    }
+
+    virtual bool runOnLoop(Loop* L, LPPassManager& LPM) {
+        BasicBlock* preheader = L->getLoopPreheader();
+        if (!preheader)
+            return false;
+
+        DominatorTree* DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+
+        bool loop_may_throw = false;
+        for (auto it = L->block_begin(), end = L->block_end(); it != end && !loop_may_throw; ++it) {
+            for (Instruction& I : **it) {
+                if (I.mayThrow()) {
+                    loop_may_throw = true;
+                    break;
+                }
+            }
+        }
+
+        std::vector<ICmpInst*> checks;
+        for (auto it = L->block_begin(), end = L->block_end(); it != end; ++it) {
+            for (Instruction& I : **it) {
+                ICmpInst* cmp = dyn_cast<ICmpInst>(&I);
+                if (!cmp || !cmp->isEquality())
+                    continue;
+
+                LoadInst* li = dyn_cast<LoadInst>(cmp->getOperand(0));
+                if (!li || !L->contains(li))
+                    continue;
+
+                Value* obj = getClassLoadObject(li);
+                if (!obj || !L->isLoopInvariant(obj) || isa<Constant>(obj))
+                    continue;
+
+                // Only now do we know that the other operand is supposed to be a class; make sure that it is one
+                // before looking inside it.
+                BoxedClass* cls = getConstantClass(cmp->getOperand(1));
+                if (!cls || !isSubclass(cls->cls, type_cls))
+                    continue;
+                if (!cls->is_constant || cls->attrs_offset != 0)
+                    continue;
+
+                if (!isSafeToSpeculativelyExecute(li) && !isGuaranteedToExecute(li, L, DT, loop_may_throw)) {
+                    static StatCounter sc_unsafe("opt_class_guards_not_hoisted_unsafe");
+                    sc_unsafe.log();
+                    continue;
+                }
+
+                checks.push_back(cmp);
+            }
+        }
+
+        StatCounter sc_num_hoisted("opt_hoisted_class_guards");
+        int num_changed = 0;
+        for (ICmpInst* cmp : checks) {
+            Instruction* insert_pt = preheader->getTerminator();
+            LoadInst* li = cast<LoadInst>(cmp->getOperand(0));
+
+            Value* ptr = hoistValue(li->getPointerOperand(), L, insert_pt);
+            if (!ptr)
+                continue;
+
+            Instruction* new_li = li->clone();
+            new_li->setOperand(0, ptr);
+            new_li->insertBefore(insert_pt);
+
+            Instruction* new_cmp = cmp->clone();
+            new_cmp->setOperand(0, new_li);
+            new_cmp->insertBefore(insert_pt);
+
+            if (VERBOSITY("opt") >= 2)
+                errs() << "Hoisting class guard out of loop: " << *cmp << '\n';
+
+            cmp->replaceAllUsesWith(new_cmp);
+            cmp->eraseFromParent();
+            if (li->use_empty())
+                li->eraseFromParent();
+
+            ++num_changed;
+            sc_num_hoisted.log();
+        }
+
+        return num_changed > 0;
+    }
+};
+char HoistClassGuardsPass::ID = 0;
+
+Pass* createHoistClassGuardsPass() {
+    return new HoistClassGuardsPass();
+}
+}
@@ -19,6 +19,7 @@ namespace llvm {
 class BasicBlockPass;
 class FunctionPass;
 class ImmutablePass;
+class Pass;
 }
 
 namespace pyston {
@@ -28,6 +29,9 @@ llvm::FunctionPass* createConstClassesPass();
 llvm::FunctionPass* createDeadAllocsPass();
 llvm::FunctionPass* createRemoveUnnecessaryBoxingPass();
 llvm::BasicBlockPass* createRemoveDuplicateBoxingPass();
+llvm::FunctionPass* createUnboxThroughPhisPass();
+llvm::FunctionPass* createSinkBoxingPass();
+llvm::Pass* createHoistClassGuardsPass();
 }
 
 #endif
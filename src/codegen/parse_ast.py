@@ -1,4 +1,5 @@
 import _ast
+import StringIO
 import struct
 import sys
 from types import NoneType
@@ -8,6 +9,17 @@ def _print_str(s, f):
     f.write(struct.pack(">H", len(s)))
     f.write(s)
 
+# Identifiers get written as indices into a table of strings at the end of the output, so that the reader
+# only has to intern each of them once:
+_string_indices = {}
+_strings = []
+def _print_interned(s, f):
+    idx = _string_indices.get(s)
+    if idx is None:
+        idx = _string_indices[s] = len(_strings)
+        _strings.append(s)
+    f.write(struct.pack(">I", idx))
+
 TYPE_MAP = {
         _ast.alias: 1,
         _ast.arguments: 2,
@@ -102,6 +114,39 @@ if sys.version_info >= (2,7):
     TYPE_MAP[_ast.DictComp] = 15
     TYPE_MAP[_ast.Set] = 43
 
+# Same as containsYield() in scoping_analysis.cpp:
+def _contains_yield(n):
+    if isinstance(n, _ast.Yield):
+        return True
+    if isinstance(n, _ast.FunctionDef):
+        return False
+    for k, v in n.__dict__.items():
+        if k.startswith('_'):
+            continue
+        children = v if isinstance(v, list) else [v]
+        for child in children:
+            if isinstance(child, _ast.AST) and _contains_yield(child):
+                return True
+    return False
+
+FUNCTION_BODY_CONTAINS_YIELD = 0x01
+
+# Function bodies are prefixed with their length and some flags; see writeFunctionBody() in serialize_ast.cpp.
+def _convert_function_body(n, f):
+    body = StringIO.StringIO()
+    flags = 0
+    if any(_contains_yield(s) for s in n.body):
+        flags |= FUNCTION_BODY_CONTAINS_YIELD
+    body.write(struct.pack(">B", flags))
+    assert len(n.body) < 2**16
+    body.write(struct.pack(">H", len(n.body)))
+    for el in n.body:
+        convert(el, body)
+
+    data = body.getvalue()
+    f.write(struct.pack(">Q", len(data)))
+    f.write(data)
+
 def convert(n, f):
     assert n is None or isinstance(n, _ast.AST), repr(n)
     type_idx = TYPE_MAP[type(n)] if n else 0
@@ -143,18 +188,23 @@ def convert(n, f):
         # elif k in ('col_offset', 'lineno'):
             # continue
 
-        if isinstance(v, list):
+        if isinstance(n, _ast.FunctionDef) and k == "body":
+            _convert_function_body(n, f)
+        elif isinstance(v, list):
             assert len(v) < 2**16
             f.write(struct.pack(">H", len(v)))
             if isinstance(n, _ast.Global):
                 assert k == "names"
                 for el in v:
-                    _print_str(el, f)
+                    _print_interned(el, f)
             else:
                 for el in v:
                     convert(el, f)
         elif isinstance(v, str):
-            _print_str(v, f)
+            if isinstance(n, _ast.Str):
+                _print_str(v, f)
+            else:
+                _print_interned(v, f)
         elif isinstance(v, unicode):
             _print_str(v.encode("utf8"), f)
         elif isinstance(v, bool):
@@ -175,12 +225,55 @@ def convert(n, f):
         else:
             raise Exception((n, k, repr(v)))
 
-if __name__ == "__main__":
-    import time
-    start = time.time()
-    fn = sys.argv[1]
-    s = open(fn).read()
+def serialize(fn, s=None):
+    del _strings[:]
+    _string_indices.clear()
+
+    if s is None:
+        s = open(fn).read()
     m = compile(s, fn, "exec", _ast.PyCF_ONLY_AST)
 
-    convert(m, sys.stdout)
+    # The output starts with the offset of the string table; see SerializeASTVisitor::write().
+    ast_data = StringIO.StringIO()
+    convert(m, ast_data)
+    ast_data = ast_data.getvalue()
 
+    out = StringIO.StringIO()
+    out.write(struct.pack(">I", 4 + len(ast_data)))
+    out.write(ast_data)
+    out.write(struct.pack(">I", len(_strings)))
+    for s in _strings:
+        _print_str(s, out)
+    return out.getvalue()
+
+# With --server, read one filename per line from stdin, and answer each of them with the length of the output
+# followed by the output (or a length of 0xffffffff if the file couldn't be parsed).  This saves starting a new
+# process for every file.  A line that starts with a NUL gives the length of source code that follows it instead
+# (ex: for compile()), which gets parsed as "<string>".
+def serve():
+    while True:
+        line = sys.stdin.readline()
+        if not line:
+            break
+        if line.startswith("\0"):
+            fn = "<string>"
+            s = sys.stdin.read(int(line[1:])) + "\n"
+        else:
+            fn = line.rstrip("\n")
+            s = None
+        try:
+            data = serialize(fn, s)
+        except Exception:
+            import traceback
+            traceback.print_exc()
+            sys.stdout.write(struct.pack(">I", 0xffffffff))
+        else:
+            sys.stdout.write(struct.pack(">I", len(data)))
+            sys.stdout.write(data)
+        sys.stdout.flush()
+
+if __name__ == "__main__":
+    if sys.argv[1] == "--server":
+        serve()
+    else:
+        sys.stdout.write(serialize(sys.argv[1]))
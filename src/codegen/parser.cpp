@@ -14,21 +14,37 @@
 
 #include "codegen/parser.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <dirent.h>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <pthread.h>
+#include <signal.h>
 #include <stdint.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
 
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 
 #include "codegen/pypa-parser.h"
 #include "codegen/serialize_ast.h"
+#include "core/arena.h"
 #include "core/ast.h"
 #include "core/options.h"
 #include "core/stats.h"
+#include "core/threading.h"
 #include "core/types.h"
 #include "core/util.h"
 
@@ -37,37 +53,147 @@
 
 namespace pyston {
 
-class BufferedReader {
+// A serialized AST in memory: usually a .pyc file that got mmap'd read-only, so that loading a module doesn't have
+// to copy it and processes share its pages through the page cache.  Function bodies that haven't been deserialized
+// yet keep a reference to it.
+//
+// We write cache files to a temporary name and rename them into place, which leaves existing mappings alone.  But
+// something else could change a mapped file in place, and truncating it would make reading the pages past the new
+// end raise SIGBUS; so before a lazy function body gets read, we check that the file is still the one we mapped
+// (see mayHaveChanged), and if it isn't, the body gets read from the module's source instead.
+//
+// The serialized AST starts with the offset of a table that holds every identifier once, and refers to them by
+// index; each of them gets interned once per module rather than every time it appears.
+class ASTCacheFile {
 private:
-    static const int BUFSIZE = 1024;
-    char buf[BUFSIZE];
-    int start, end;
-    FILE* fp;
+    const char* data;
+    size_t size;
+    bool mapped;
+    std::vector<char> owned_data;
+    // If this is a part of a larger file (see ModuleBundle), that file:
+    std::shared_ptr<ASTCacheFile> parent;
+
+    // If mapped, the file that we mapped and what it looked like then:
+    std::string path;
+    struct stat mapped_stat;
+    // The source that the AST came from, if we know it:
+    std::string source_fn;
+
+    int string_table_offset;
+    std::vector<InternedString> strings;
+    InternedStringPool* pool;
+
+    ASTCacheFile(const char* data, size_t size, bool mapped)
+        : data(data), size(size), mapped(mapped), string_table_offset(-1), pool(NULL) {}
 
-    InternedStringPool* intern_pool;
+public:
+    ~ASTCacheFile() {
+        if (mapped)
+            munmap(const_cast<char*>(data), size);
+    }
 
-    void ensure(int num) {
-        if (end - start < num) {
-            fill();
+    static std::shared_ptr<ASTCacheFile> map(FILE* fp, size_t size, const std::string& path) {
+        void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+        if (addr != MAP_FAILED) {
+            std::shared_ptr<ASTCacheFile> rtn(new ASTCacheFile((const char*)addr, size, true));
+            rtn->path = path;
+            int code = fstat(fileno(fp), &rtn->mapped_stat);
+            RELEASE_ASSERT(code == 0, "%d", errno);
+            return rtn;
         }
+
+        std::vector<char> bytes(size);
+        fseek(fp, 0, SEEK_SET);
+        size_t read = fread(bytes.data(), 1, size, fp);
+        RELEASE_ASSERT(read == size, "%ld", read);
+        return fromBytes(std::move(bytes));
     }
 
-public:
-    void fill() {
-        memmove(buf, buf + start, end - start);
-        end -= start;
-        start = 0;
-        end += fread(buf + end, 1, BUFSIZE - end, fp);
-        if (VERBOSITY("parsing") >= 3)
-            printf("filled, now at %d-%d\n", start, end);
+    static std::shared_ptr<ASTCacheFile> fromBytes(std::vector<char> bytes) {
+        std::shared_ptr<ASTCacheFile> rtn(new ASTCacheFile(NULL, bytes.size(), false));
+        rtn->owned_data = std::move(bytes);
+        rtn->data = rtn->owned_data.data();
+        return rtn;
     }
 
-    BufferedReader(FILE* fp) : start(0), end(0), fp(fp), intern_pool(NULL) {}
+    static std::shared_ptr<ASTCacheFile> slice(const std::shared_ptr<ASTCacheFile>& parent, size_t offset,
+                                               size_t size) {
+        RELEASE_ASSERT(offset <= parent->size && size <= parent->size - offset, "corrupt AST cache: %ld %ld", offset,
+                       size);
+        std::shared_ptr<ASTCacheFile> rtn(new ASTCacheFile(parent->data + offset, size, false));
+        rtn->parent = parent;
+        return rtn;
+    }
 
-    int bytesBuffered() { return (end - start); }
+    const char* getData() { return data; }
+    size_t getSize() { return size; }
+
+    // Whether the mapped file might have been changed in place since we mapped it, in which case the parts of the
+    // mapping that we haven't read yet might not be readable anymore, or hold something else.  If the file got
+    // replaced or deleted instead, the mapping still refers to the old one, which nobody can change anymore.
+    bool mayHaveChanged() {
+        if (parent)
+            return parent->mayHaveChanged();
+        if (!mapped)
+            return false;
+
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        if (st.st_dev != mapped_stat.st_dev || st.st_ino != mapped_stat.st_ino)
+            return false;
+        return st.st_size != mapped_stat.st_size || st.st_mtim.tv_sec != mapped_stat.st_mtim.tv_sec
+               || st.st_mtim.tv_nsec != mapped_stat.st_mtim.tv_nsec;
+    }
+
+    const std::string& getSourceFilename() { return source_fn; }
+    void setSourceFilename(std::string fn) { source_fn = std::move(fn); }
+
+    int getStringTableOffset() { return string_table_offset; }
+    void setStringTableOffset(int offset) {
+        RELEASE_ASSERT(offset >= 0 && (size_t)offset <= size, "corrupt AST cache: %d", offset);
+        string_table_offset = offset;
+    }
 
+    void setStrings(std::vector<InternedString> strings, InternedStringPool* pool) {
+        assert(this->strings.empty());
+        this->strings = std::move(strings);
+        this->pool = pool;
+    }
+    // The pool that the strings got interned into, which is the module's.
+    InternedStringPool* getPool() { return pool; }
+    InternedString getString(uint32_t idx) {
+        RELEASE_ASSERT(idx < strings.size(), "corrupt AST cache: %u", idx);
+        return strings[idx];
+    }
+};
+typedef std::shared_ptr<ASTCacheFile> ASTCacheData;
+
+class BufferedReader {
+private:
+    ASTCacheData file;
+    const char* buf;
+    int start, end;
+
+public:
+    // How many function or class bodies we are inside of.
+    int depth;
+
+    BufferedReader(ASTCacheData file, int offset)
+        : file(file), buf(file->getData()), start(offset), end(file->getSize()), depth(0) {}
+
+    const ASTCacheData& getFile() { return file; }
+    int getOffset() { return start; }
+    void seek(int offset) {
+        RELEASE_ASSERT(offset <= end, "premature eof");
+        start = offset;
+    }
+
+    uint8_t peekByte() {
+        RELEASE_ASSERT(end > start, "premature eof");
+        return buf[start];
+    }
     uint8_t readByte() {
-        ensure(1);
         RELEASE_ASSERT(end > start, "premature eof");
         return buf[start++];
     }
@@ -82,16 +208,31 @@ public:
         raw = readULL();
         return d;
     }
+    llvm::StringRef readBytes(int length) {
+        RELEASE_ASSERT(end - start >= length, "premature eof");
+        llvm::StringRef rtn(buf + start, length);
+        start += length;
+        return rtn;
+    }
 
-    std::unique_ptr<InternedStringPool> createInternedPool();
+    // Interns the file's string table into the given pool.
+    void readStringTable(InternedStringPool* pool);
     InternedString readAndInternString();
     void readAndInternStringVector(std::vector<InternedString>& v);
 };
 
-std::unique_ptr<InternedStringPool> BufferedReader::createInternedPool() {
-    assert(this->intern_pool == NULL);
-    this->intern_pool = new InternedStringPool();
-    return std::unique_ptr<InternedStringPool>(this->intern_pool);
+void BufferedReader::readStringTable(InternedStringPool* pool) {
+    int saved_offset = getOffset();
+    seek(file->getStringTableOffset());
+    int num_strings = readUInt();
+    std::vector<InternedString> strings;
+    strings.reserve(num_strings);
+    for (int i = 0; i < num_strings; i++) {
+        int length = readShort();
+        strings.push_back(pool->get(readBytes(length)));
+    }
+    file->setStrings(std::move(strings), pool);
+    seek(saved_offset);
 }
 
 AST* readASTMisc(BufferedReader* reader);
@@ -100,20 +241,11 @@ AST_stmt* readASTStmt(BufferedReader* reader);
 
 static std::string readString(BufferedReader* reader) {
     int strlen = reader->readShort();
-    llvm::SmallString<32> chars;
-    for (int i = 0; i < strlen; i++) {
-        chars.push_back(reader->readByte());
-    }
-    return chars.str().str();
+    return reader->readBytes(strlen).str();
 }
 
 InternedString BufferedReader::readAndInternString() {
-    int strlen = readShort();
-    llvm::SmallString<32> chars;
-    for (int i = 0; i < strlen; i++) {
-        chars.push_back(readByte());
-    }
-    return intern_pool->get(chars.str());
+    return file->getString(readUInt());
 }
 
 void BufferedReader::readAndInternStringVector(std::vector<InternedString>& v) {
@@ -319,7 +451,9 @@ AST_ClassDef* read_classdef(BufferedReader* reader) {
     AST_ClassDef* rtn = new AST_ClassDef();
 
     readExprVector(rtn->bases, reader);
+    reader->depth++;
     readStmtVector(rtn->body, reader);
+    reader->depth--;
     rtn->col_offset = readColOffset(reader);
     readExprVector(rtn->decorator_list, reader);
     rtn->lineno = reader->readULL();
@@ -424,13 +558,101 @@ AST_For* read_for(BufferedReader* reader) {
     return rtn;
 }
 
+static std::vector<AST_stmt*> readBodyFromSource(const std::string& source_fn, AST_FunctionDef* def,
+                                                 InternedStringPool* pool);
+
+namespace {
+class LazyFunctionBodyFromCache : public LazyFunctionBody {
+private:
+    AST_FunctionDef* def;
+    ASTCacheData file;
+    // The module's arena, which the rest of the body goes into too:
+    Arena* arena;
+    int num_stmts;
+    // The statements that already got read, and where the rest of them start:
+    std::vector<AST_stmt*> body;
+    int rest_offset;
+
+public:
+    LazyFunctionBodyFromCache(AST_FunctionDef* def, bool contains_yield, AST_Str* docstring, ASTCacheData file,
+                              int num_stmts, std::vector<AST_stmt*> first_stmts, int rest_offset)
+        : LazyFunctionBody(contains_yield, docstring),
+          def(def),
+          file(std::move(file)),
+          arena(ArenaScope::current()),
+          num_stmts(num_stmts),
+          body(std::move(first_stmts)),
+          rest_offset(rest_offset) {}
+
+    const std::vector<AST_stmt*>& getBody() override {
+        if (file) {
+            STAT_TIMER(t0, "us_timer_materialize_function_body");
+
+            ArenaScope _arena_scope(arena);
+            if (file->mayHaveChanged()) {
+                body = readBodyFromSource(file->getSourceFilename(), def, file->getPool());
+            } else {
+                BufferedReader reader(file, rest_offset);
+                // Nested functions get read eagerly:
+                reader.depth = 1;
+                while ((int)body.size() < num_stmts)
+                    body.push_back(readASTStmt(&reader));
+            }
+            file.reset();
+        }
+        return body;
+    }
+};
+}
+
+// Module-level function bodies that we read from the .pyc cache don't get deserialized until they're needed: most
+// functions of most modules never get called, and their AST and scoping info would just take time and memory.
+// We do read the first statement of the body if it could be the docstring, since that's needed as soon as the
+// function gets defined.
+static void readFunctionBody(AST_FunctionDef* def, BufferedReader* reader) {
+    uint64_t length = reader->readULL();
+    bool lazy = ENABLE_LAZY_FUNCTION_BODIES && reader->depth == 0;
+    int body_start = lazy ? reader->getOffset() : 0;
+
+    uint8_t flags = reader->readByte();
+
+    if (!lazy) {
+        reader->depth++;
+        readStmtVector(def->body, reader);
+        reader->depth--;
+        return;
+    }
+
+    int num_stmts = reader->readShort();
+    std::vector<AST_stmt*> first_stmts;
+    AST_Str* docstring = NULL;
+    if (num_stmts > 0 && reader->peekByte() == AST_TYPE::Expr) {
+        reader->depth++;
+        AST_stmt* first = readASTStmt(reader);
+        reader->depth--;
+        first_stmts.push_back(first);
+
+        AST_expr* value = ast_cast<AST_Expr>(first)->value;
+        if (value->type == AST_TYPE::Str)
+            docstring = ast_cast<AST_Str>(value);
+    }
+
+    def->lazy_body = new LazyFunctionBodyFromCache(def, flags & FUNCTION_BODY_CONTAINS_YIELD, docstring,
+                                                   reader->getFile(), num_stmts, std::move(first_stmts),
+                                                   reader->getOffset());
+    reader->seek(body_start + length);
+
+    static StatCounter num_lazy("num_lazy_function_bodies");
+    num_lazy.log();
+}
+
 AST_FunctionDef* read_functiondef(BufferedReader* reader) {
     if (VERBOSITY("parsing") >= 3)
         printf("reading functiondef\n");
     AST_FunctionDef* rtn = new AST_FunctionDef();
 
     rtn->args = ast_cast<AST_arguments>(readASTMisc(reader));
-    readStmtVector(rtn->body, reader);
+    readFunctionBody(rtn, reader);
     rtn->col_offset = readColOffset(reader);
     readExprVector(rtn->decorator_list, reader);
     rtn->lineno = reader->readULL();
@@ -553,7 +775,14 @@ AST_Module* read_module(BufferedReader* reader) {
     if (VERBOSITY("parsing") >= 3)
         printf("reading module\n");
 
-    AST_Module* rtn = new AST_Module(reader->createInternedPool());
+    // The strings normally go into a new pool for the module, unless they're meant to go into an existing one
+    // (see readBodyFromSource).
+    std::unique_ptr<InternedStringPool> pool;
+    if (!reader->getFile()->getPool()) {
+        pool.reset(new InternedStringPool());
+        reader->readStringTable(pool.get());
+    }
+    AST_Module* rtn = new AST_Module(std::move(pool));
 
     readStmtVector(rtn->body, reader);
     rtn->col_offset = -1;
@@ -944,7 +1173,7 @@ AST* readASTMisc(BufferedReader* reader) {
     }
 }
 
-static std::string getParserCommandLine(const char* fn) {
+static std::string getParserCommandLine(const char* args) {
     llvm::SmallString<128> parse_ast_fn;
     // TODO supposed to pass argv0, main_addr to this function:
     parse_ast_fn = llvm::sys::fs::getMainExecutable(NULL, NULL);
@@ -958,65 +1187,254 @@ static std::string getParserCommandLine(const char* fn) {
     // We may be running in an environment where "python" resolves to pyston (ex in
     // a virtualenv), so try to hard code the path to CPython.
     // This should probably be a configure-time check?
-    return std::string("/usr/bin/python -S ") + parse_ast_fn.str().str() + " " + fn;
-}
+    return std::string("/usr/bin/python -S ") + parse_ast_fn.str().str() + " " + args;
+}
+
+// Without pypa, files get parsed by CPython running parse_ast.py.  Starting CPython is most of what that costs, so
+// we start it once and keep it around (see serve() in parse_ast.py) rather than running it for each file.
+static FILE* cpython_parser_in = NULL;
+static FILE* cpython_parser_out = NULL;
+static pid_t cpython_parser_pid = -1;
+
+// Closing its input makes the parser exit; returns its exit status once it has.
+static int stopCPythonParser() {
+    fclose(cpython_parser_in);
+    fclose(cpython_parser_out);
+    cpython_parser_in = cpython_parser_out = NULL;
+
+    int status = 0;
+    pid_t r;
+    do {
+        r = waitpid(cpython_parser_pid, &status, 0);
+    } while (r == -1 && errno == EINTR);
+    cpython_parser_pid = -1;
+    return status;
+}
+
+static void stopCPythonParserAtExit() {
+    if (cpython_parser_in)
+        stopCPythonParser();
+}
+
+static void cpythonParserExited() {
+    int status = stopCPythonParser();
+    RELEASE_ASSERT(0, "the parser process exited (status %d)", status);
+}
+
+static void startCPythonParser() {
+    std::string cmd = getParserCommandLine("--server");
+
+    int to_parser[2], from_parser[2];
+    int code = pipe(to_parser);
+    RELEASE_ASSERT(code == 0, "%s", strerror(errno));
+    code = pipe(from_parser);
+    RELEASE_ASSERT(code == 0, "%s", strerror(errno));
+
+    pid_t pid = fork();
+    RELEASE_ASSERT(pid >= 0, "%s", strerror(errno));
+    if (pid == 0) {
+        dup2(to_parser[0], STDIN_FILENO);
+        dup2(from_parser[1], STDOUT_FILENO);
+        close(to_parser[0]);
+        close(to_parser[1]);
+        close(from_parser[0]);
+        close(from_parser[1]);
+        execl("/bin/sh", "sh", "-c", cmd.c_str(), (char*)NULL);
+        _exit(127);
+    }
 
-AST_Module* parse_string(const char* code) {
-    int size = strlen(code);
-    char buf[] = "pystontmp_XXXXXX";
-    char* tmpdir = mkdtemp(buf);
-    assert(tmpdir);
-    std::string tmp = std::string(tmpdir) + "/in.py";
-    if (VERBOSITY() >= 3) {
-        printf("writing %d bytes to %s\n", size, tmp.c_str());
+    close(to_parser[0]);
+    close(from_parser[1]);
+    fcntl(to_parser[1], F_SETFD, FD_CLOEXEC);
+    fcntl(from_parser[0], F_SETFD, FD_CLOEXEC);
+    cpython_parser_in = fdopen(to_parser[1], "w");
+    cpython_parser_out = fdopen(from_parser[0], "r");
+    assert(cpython_parser_in && cpython_parser_out);
+    cpython_parser_pid = pid;
+
+    static bool registered = false;
+    if (!registered) {
+        registered = true;
+        atexit(stopCPythonParserAtExit);
     }
+}
 
-    FILE* f = fopen(tmp.c_str(), "w");
-    fwrite(code, 1, size, f);
-    fputc('\n', f);
-    fclose(f);
+// Returns the serialized AST, in the format that readSerializedModule() reads.  If code is given, that gets sent
+// to the parser and parsed instead of the file.
+static std::vector<char> parseWithCPython(const char* fn, const char* code = NULL) {
+    if (!cpython_parser_in)
+        startCPythonParser();
+
+    RELEASE_ASSERT(code || !strchr(fn, '\n'), "can't parse '%s'", fn);
+
+    // Writing to the pipe once the parser is gone raises SIGPIPE, which would kill us without saying why:
+    struct sigaction ignore, prev;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPIPE, &ignore, &prev);
+    bool written;
+    if (code) {
+        // A filename can't start with a NUL, so that's what marks a request that's followed by its source:
+        size_t size = strlen(code);
+        written = fprintf(cpython_parser_in, "%c%zu\n", '\0', size) >= 0
+                  && fwrite(code, 1, size, cpython_parser_in) == size && fflush(cpython_parser_in) == 0;
+    } else {
+        written = fprintf(cpython_parser_in, "%s\n", fn) >= 0 && fflush(cpython_parser_in) == 0;
+    }
+    sigaction(SIGPIPE, &prev, NULL);
+    if (!written)
+        cpythonParserExited();
 
-    AST_Module* m = parse_file(tmp.c_str());
-    removeDirectoryIfExists(tmpdir);
+    uint8_t length_bytes[4];
+    size_t nread = fread(length_bytes, 1, sizeof(length_bytes), cpython_parser_out);
+    if (nread != sizeof(length_bytes))
+        cpythonParserExited();
+    uint32_t length = ((uint32_t)length_bytes[0] << 24) | (length_bytes[1] << 16) | (length_bytes[2] << 8)
+                      | length_bytes[3];
+    RELEASE_ASSERT(length != 0xffffffff, "failed to parse %s", fn);
 
-    return m;
+    std::vector<char> output(length);
+    nread = fread(output.data(), 1, length, cpython_parser_out);
+    if (nread != length)
+        cpythonParserExited();
+    return output;
 }
 
-AST_Module* parse_file(const char* fn) {
+static AST_Module* parseFileIntoCurrentArena(const char* fn);
+static AST_Module* readSerializedModule(ASTCacheData file, int start, std::string source_fn);
+
+AST_Module* parse_string(const char* code) {
     STAT_TIMER(t0, "us_timer_cpyton_parsing");
     Timer _t("parsing");
 
+    // These are mostly tiny (see core/arena.h):
+    ArenaScope _arena_scope(ArenaScope::global());
+
+    if (VERBOSITY() >= 3)
+        printf("parsing a %zu-byte string\n", strlen(code));
+
+    AST_Module* rtn;
     if (ENABLE_PYPA_PARSER) {
-        AST_Module* rtn = pypa_parse(fn);
+        rtn = pypa_parse_string(code);
         assert(rtn);
-        return rtn;
+    } else {
+        rtn = readSerializedModule(ASTCacheFile::fromBytes(parseWithCPython("<string>", code)), 0, "<string>");
     }
 
-    FILE* fp = popen(getParserCommandLine(fn).c_str(), "r");
+    long us = _t.end();
+    static StatCounter us_parsing("us_parsing");
+    us_parsing.log(us);
 
-    BufferedReader* reader = new BufferedReader(fp);
-    AST* rtn = readASTMisc(reader);
-    reader->fill();
-    ASSERT(reader->bytesBuffered() == 0, "%d", reader->bytesBuffered());
-    delete reader;
+    return rtn;
+}
 
-    int code = pclose(fp);
-    assert(code == 0);
+// Reads the output of serializeAST() (or parse_ast.py) that starts at the given offset.
+static AST_Module* readSerializedModule(ASTCacheData file, int start, std::string source_fn) {
+    file->setSourceFilename(std::move(source_fn));
+    BufferedReader reader(file, start);
+    file->setStringTableOffset(start + reader.readUInt());
 
+    AST* rtn = readASTMisc(&reader);
+    RELEASE_ASSERT(reader.getOffset() == file->getStringTableOffset(), "%d %d", reader.getOffset(),
+                   file->getStringTableOffset());
     assert(rtn->type == AST_TYPE::Module);
 
+    return ast_cast<AST_Module>(rtn);
+}
+
+// Runs the destructors of a module's nodes, for a module whose arena is about to go away.  Freeing the arena only
+// gives back the memory of the nodes themselves: the nodes don't own each other, so their destructors (which free
+// their vectors and strings) have to get run one by one.  The module's destructor frees its InternedStringPool,
+// which the nodes' names point into, so it has to go last.
+static void destroyModuleAST(AST_Module* module) {
+    std::vector<AST*> nodes;
+    flatten(module->body, nodes, true);
+    for (AST* node : nodes)
+        delete node;
+    delete module;
+}
+
+// Reads the body of a module-level function from the module's source, with its names interned into the module's
+// pool; for when the cache file that the rest of the module came from changed before the body got read.
+static std::vector<AST_stmt*> readBodyFromSource(const std::string& source_fn, AST_FunctionDef* def,
+                                                 InternedStringPool* pool) {
+    static StatCounter num_reparsed("num_lazy_function_bodies_reparsed");
+    num_reparsed.log();
+
+    RELEASE_ASSERT(!source_fn.empty(), "the AST cache that %s came from changed while it was in use",
+                   def->name.c_str());
+
+    // The parser interns names into a pool of its own, so the source goes through the serializer, and gets read
+    // back the same way as a cache file, but into the module's pool.
+    char* buf;
+    size_t len;
+    FILE* fp = open_memstream(&buf, &len);
+    RELEASE_ASSERT(fp, "%d", errno);
+    {
+        // This AST only lives until it's been serialized:
+        Arena arena;
+        ArenaScope _arena_scope(&arena);
+        AST_Module* parsed = parseFileIntoCurrentArena(source_fn.c_str());
+        serializeAST(parsed, fp);
+        destroyModuleAST(parsed);
+    }
+    fclose(fp);
+    ASTCacheData file = ASTCacheFile::fromBytes(std::vector<char>(buf, buf + len));
+    free(buf);
+
+    BufferedReader reader(file, 0);
+    file->setStringTableOffset(reader.readUInt());
+    reader.readStringTable(pool);
+    AST* module = readASTMisc(&reader);
+    assert(module->type == AST_TYPE::Module);
+
+    std::vector<AST*> nodes;
+    flatten(ast_cast<AST_Module>(module)->body, nodes, true);
+    for (AST* node : nodes) {
+        if (node->type != AST_TYPE::FunctionDef)
+            continue;
+        AST_FunctionDef* candidate = ast_cast<AST_FunctionDef>(node);
+        if (candidate->name == def->name && candidate->lineno == def->lineno
+            && candidate->col_offset == def->col_offset) {
+            candidate->ensureBody();
+            return candidate->body;
+        }
+    }
+    RELEASE_ASSERT(0, "the AST cache that %s came from changed while it was in use, and it's not in %s anymore",
+                   def->name.c_str(), source_fn.c_str());
+}
+
+AST_Module* parse_file(const char* fn) {
+    // Each module's AST goes into an arena of its own.  Module ASTs never get freed, so neither do their arenas.
+    ArenaScope _arena_scope(new Arena());
+    return parseFileIntoCurrentArena(fn);
+}
+
+static AST_Module* parseFileIntoCurrentArena(const char* fn) {
+    STAT_TIMER(t0, "us_timer_cpyton_parsing");
+    Timer _t("parsing");
+
+    AST_Module* rtn;
+    if (ENABLE_PYPA_PARSER) {
+        rtn = pypa_parse(fn);
+        assert(rtn);
+    } else {
+        rtn = readSerializedModule(ASTCacheFile::fromBytes(parseWithCPython(fn)), 0, fn);
+    }
+
     long us = _t.end();
     static StatCounter us_parsing("us_parsing");
     us_parsing.log(us);
 
-    return ast_cast<AST_Module>(rtn);
+    return rtn;
 }
 
 const char* getMagic() {
     if (ENABLE_PYPA_PARSER)
-        return "a\ncK";
+        return "a\ncM";
     else
-        return "a\nck";
+        return "a\ncm";
 }
 
 #define MAGIC_STRING_LENGTH 4
@@ -1027,11 +1445,9 @@ enum class ParseResult {
     FAILURE,
     PYC_UNWRITABLE,
 };
-static ParseResult _reparse(const char* fn, const std::string& cache_fn, AST_Module*& module) {
-    FILE* cache_fp = fopen(cache_fn.c_str(), "w");
-    if (!cache_fp)
-        return ParseResult::PYC_UNWRITABLE;
 
+// Returns where the checksum goes; finishCacheFile() fills it in.
+static int beginCacheFile(FILE* cache_fp) {
     fwrite(getMagic(), 1, MAGIC_STRING_LENGTH, cache_fp);
 
     int checksum_start = ftell(cache_fp);
@@ -1040,35 +1456,201 @@ static ParseResult _reparse(const char* fn, const std::string& cache_fn, AST_Mod
     // Currently just use the length as the checksum
     static_assert(sizeof(bytes_written) >= CHECKSUM_LENGTH, "");
     fwrite(&bytes_written, 1, CHECKSUM_LENGTH, cache_fp);
+    return checksum_start;
+}
+
+// Cache files get written under a temporary name and then renamed into place.  Besides nobody ever seeing a
+// partially-written file, this leaves the old file alone, which might still be mapped (see ASTCacheFile).
+static bool finishCacheFile(FILE* cache_fp, int checksum_start, int bytes_written, const std::string& tmp_fn,
+                            const std::string& cache_fn) {
+    fseek(cache_fp, checksum_start, SEEK_SET);
+    fwrite(&bytes_written, 1, CHECKSUM_LENGTH, cache_fp);
+
+    fclose(cache_fp);
+
+    if (rename(tmp_fn.c_str(), cache_fn.c_str()) != 0) {
+        unlink(tmp_fn.c_str());
+        return false;
+    }
+    return true;
+}
 
-    bytes_written = 0;
+static ParseResult _reparse(const char* fn, const std::string& cache_fn, AST_Module*& module) {
+    std::string tmp_fn = tempFileName(cache_fn);
+    FILE* cache_fp = fopen(tmp_fn.c_str(), "w");
+    if (!cache_fp)
+        return ParseResult::PYC_UNWRITABLE;
+
+    int checksum_start = beginCacheFile(cache_fp);
+    int bytes_written = 0;
 
     if (ENABLE_PYPA_PARSER) {
         module = pypa_parse(fn);
-        if (!module)
+        if (!module) {
+            fclose(cache_fp);
+            unlink(tmp_fn.c_str());
             return ParseResult::FAILURE;
+        }
         bytes_written += serializeAST(module, cache_fp);
     } else {
-        FILE* parser = popen(getParserCommandLine(fn).c_str(), "r");
-        char buf[80];
-        while (true) {
-            int nread = fread(buf, 1, 80, parser);
-            if (nread == 0)
-                break;
-            bytes_written += nread;
-            fwrite(buf, 1, nread, cache_fp);
-        }
-        int code = pclose(parser);
-        assert(code == 0);
+        std::vector<char> output = parseWithCPython(fn);
+        fwrite(output.data(), 1, output.size(), cache_fp);
+        bytes_written += output.size();
     }
 
-    fseek(cache_fp, checksum_start, SEEK_SET);
-    fwrite(&bytes_written, 1, CHECKSUM_LENGTH, cache_fp);
-
-    fclose(cache_fp);
+    if (!finishCacheFile(cache_fp, checksum_start, bytes_written, tmp_fn, cache_fn))
+        return ParseResult::PYC_UNWRITABLE;
     return ParseResult::SUCCESS;
 }
 
+static bool cacheIsStale(const char* fn, const std::string& cache_fn, struct stat* cache_stat) {
+    struct stat source_stat;
+    int code = stat(fn, &source_stat);
+    assert(code == 0);
+    code = stat(cache_fn.c_str(), cache_stat);
+    return code != 0 || cache_stat->st_mtime < source_stat.st_mtime
+           || (cache_stat->st_mtime == source_stat.st_mtime
+               && cache_stat->st_mtim.tv_nsec < source_stat.st_mtim.tv_nsec);
+}
+
+// When a package gets imported, its modules are likely to get imported soon after, so with PREPARSE_THREADS set
+// we have background threads bring their .pyc files up to date while the main thread keeps running.  The threads
+// only write the cache files; the main thread reads them the usual way.
+//
+// The threads run the parser without the GIL, and only take it for the parts that need the runtime.  To avoid
+// deadlocks, nobody tries to take the GIL while holding preparse_mutex.
+static pthread_mutex_t preparse_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Gets signaled whenever a thread finishes a file, and whenever something gets queued:
+static pthread_cond_t preparse_cond = PTHREAD_COND_INITIALIZER;
+static std::deque<std::string> preparse_queue;
+// The files that some thread is parsing right now:
+static std::unordered_set<std::string> preparse_active;
+// Every file that ever got queued, so that importing a package twice doesn't reparse it:
+static std::unordered_set<std::string> preparse_requested;
+static int num_preparse_threads = 0;
+
+static void preparseFile(const std::string& fn) {
+    std::string cache_fn = fn + "c";
+    struct stat cache_stat;
+    if (!cacheIsStale(fn.c_str(), cache_fn, &cache_stat))
+        return;
+
+    // Unlike the ones the main thread parses, this AST only lives until it's been written out:
+    Arena arena;
+    ArenaScope _arena_scope(&arena);
+
+    AST_Module* module;
+    try {
+        module = pypa_parse_without_gil(fn.c_str());
+    } catch (ExcInfo e) {
+        // Syntax errors get reported once the main thread gets to the module.
+        return;
+    }
+    if (!module)
+        return;
+
+    std::string tmp_fn = tempFileName(cache_fn);
+    FILE* cache_fp = fopen(tmp_fn.c_str(), "w");
+    if (cache_fp) {
+        int checksum_start = beginCacheFile(cache_fp);
+        int bytes_written = serializeAST(module, cache_fp);
+        finishCacheFile(cache_fp, checksum_start, bytes_written, tmp_fn, cache_fn);
+    }
+
+    destroyModuleAST(module);
+}
+
+static void* preparseThread(Box*, Box*, Box*) {
+    threading::GLAllowThreadsReadRegion _allow_threads;
+
+    pthread_mutex_lock(&preparse_mutex);
+    while (true) {
+        while (preparse_queue.empty())
+            pthread_cond_wait(&preparse_cond, &preparse_mutex);
+
+        std::string fn = std::move(preparse_queue.front());
+        preparse_queue.pop_front();
+        preparse_active.insert(fn);
+        pthread_mutex_unlock(&preparse_mutex);
+
+        preparseFile(fn);
+
+        pthread_mutex_lock(&preparse_mutex);
+        preparse_active.erase(fn);
+        static StatCounter num_preparsed("num_preparsed_files");
+        num_preparsed.log();
+        pthread_cond_broadcast(&preparse_cond);
+    }
+}
+
+void preparsePackage(const std::string& package_path) {
+    // The fallback parser writes the AST straight from its pipe, so only the pypa one gets run in the background.
+    if (PREPARSE_THREADS <= 0 || !ENABLE_PYPA_PARSER)
+        return;
+
+    DIR* dir = opendir(package_path.c_str());
+    if (!dir)
+        return;
+
+    std::vector<std::string> stale;
+    while (struct dirent* entry = readdir(dir)) {
+        llvm::StringRef name(entry->d_name);
+        if (!name.endswith(".py"))
+            continue;
+
+        std::string fn = package_path + "/" + name.str();
+        struct stat source_stat, cache_stat;
+        if (stat(fn.c_str(), &source_stat) != 0 || !S_ISREG(source_stat.st_mode))
+            continue;
+        if (cacheIsStale(fn.c_str(), fn + "c", &cache_stat))
+            stale.push_back(std::move(fn));
+    }
+    closedir(dir);
+
+    if (stale.empty())
+        return;
+
+    while (num_preparse_threads < PREPARSE_THREADS) {
+        threading::start_thread(&preparseThread, NULL, NULL, NULL);
+        num_preparse_threads++;
+    }
+
+    pthread_mutex_lock(&preparse_mutex);
+    for (auto& fn : stale) {
+        if (preparse_requested.insert(fn).second)
+            preparse_queue.push_back(fn);
+    }
+    pthread_cond_broadcast(&preparse_cond);
+    pthread_mutex_unlock(&preparse_mutex);
+}
+
+// Makes sure that no preparse thread is working on this file: either we get to it before a thread does, or we wait
+// for the thread to finish.
+static void claimFromPreparseThreads(const char* fn) {
+    if (num_preparse_threads == 0)
+        return;
+
+    pthread_mutex_lock(&preparse_mutex);
+    auto it = std::find(preparse_queue.begin(), preparse_queue.end(), fn);
+    if (it != preparse_queue.end())
+        preparse_queue.erase(it);
+    bool active = preparse_active.count(fn);
+    pthread_mutex_unlock(&preparse_mutex);
+
+    if (!active)
+        return;
+
+    static StatCounter num_waits("num_preparse_waits");
+    num_waits.log();
+
+    // The thread might need the GIL to finish:
+    threading::GLAllowThreadsReadRegion _allow_threads;
+    pthread_mutex_lock(&preparse_mutex);
+    while (preparse_active.count(fn))
+        pthread_cond_wait(&preparse_cond, &preparse_mutex);
+    pthread_mutex_unlock(&preparse_mutex);
+}
+
 // Parsing the file is somewhat expensive since we have to shell out to cpython;
 // it's not a huge deal right now, but this caching version can significantly cut down
 // on the startup time (40ms -> 10ms).
@@ -1078,15 +1660,16 @@ AST_Module* caching_parse_file(const char* fn) {
     Timer _t("parsing");
     _t.setExitCallback([](uint64_t t) { us_parsing.log(t); });
 
+    // Same as in parse_file():
+    ArenaScope _arena_scope(new Arena());
+
+    claimFromPreparseThreads(fn);
+
     int code;
     std::string cache_fn = std::string(fn) + "c";
 
-    struct stat source_stat, cache_stat;
-    code = stat(fn, &source_stat);
-    assert(code == 0);
-    code = stat(cache_fn.c_str(), &cache_stat);
-    if (code != 0 || cache_stat.st_mtime < source_stat.st_mtime
-        || (cache_stat.st_mtime == source_stat.st_mtime && cache_stat.st_mtim.tv_nsec < source_stat.st_mtim.tv_nsec)) {
+    struct stat cache_stat;
+    if (cacheIsStale(fn, cache_fn, &cache_stat)) {
         AST_Module* mod = 0;
         auto result = _reparse(fn, cache_fn, mod);
         if (mod)
@@ -1096,7 +1679,7 @@ AST_Module* caching_parse_file(const char* fn) {
             return NULL;
 
         if (result == ParseResult::PYC_UNWRITABLE)
-            return parse_file(fn);
+            return parseFileIntoCurrentArena(fn);
 
         code = stat(cache_fn.c_str(), &cache_stat);
         assert(code == 0);
@@ -1108,6 +1691,10 @@ AST_Module* caching_parse_file(const char* fn) {
     while (true) {
         bool good = true;
 
+        // Some other process might have replaced the file since we looked at it:
+        code = fstat(fileno(fp), &cache_stat);
+        assert(code == 0);
+
         if (good) {
             char buf[MAGIC_STRING_LENGTH];
             int read = fread(buf, 1, MAGIC_STRING_LENGTH, fp);
@@ -1146,7 +1733,7 @@ AST_Module* caching_parse_file(const char* fn) {
                 return NULL;
 
             if (result == ParseResult::PYC_UNWRITABLE)
-                return parse_file(fn);
+                return parseFileIntoCurrentArena(fn);
 
             code = stat(cache_fn.c_str(), &cache_stat);
             assert(code == 0);
@@ -1158,16 +1745,227 @@ AST_Module* caching_parse_file(const char* fn) {
         }
     }
 
-    BufferedReader* reader = new BufferedReader(fp);
-    AST* rtn = readASTMisc(reader);
-    reader->fill();
-    assert(reader->bytesBuffered() == 0);
-    delete reader;
-
+    // Map the file instead of reading it: most of it is function bodies that only get read if they're needed (see
+    // readFunctionBody).
+    ASTCacheData file = ASTCacheFile::map(fp, cache_stat.st_size, cache_fn);
     fclose(fp);
 
-    assert(rtn->type == AST_TYPE::Module);
+    return readSerializedModule(std::move(file), MAGIC_STRING_LENGTH + CHECKSUM_LENGTH, fn);
+}
 
-    return ast_cast<AST_Module>(rtn);
+// A module bundle holds the ASTs of all the modules that an application imports, so that a deployed application
+// can start up without having to look for, stat() and open each module's source and .pyc file.  Running with
+// PYSTON_WRITE_MODULE_BUNDLE=<file> writes one at exit with every module that got imported from its source, and
+// running with PYSTON_MODULE_BUNDLE=<file> imports the modules that are in it from it, without looking at sys.path
+// or checking whether their sources changed.  (PYSTON_OBJECT_CACHE_PACK does the same thing for the JIT'd code.)
+//
+// Layout: a BundleHeader, num_modules BundleIndexEntries sorted by module name, then the data they point to.  Each
+// module's AST is in the same format as the rest of a .pyc file after its header.
+namespace {
+struct BundleHeader {
+    char magic[8];
+    char ast_magic[MAGIC_STRING_LENGTH];
+    uint32_t unused;
+    uint64_t num_modules;
+};
+struct BundleIndexEntry {
+    // The module's name, immediately followed by the filename it got imported from:
+    uint64_t name_offset;
+    uint32_t name_size;
+    uint32_t fn_size;
+    uint64_t ast_offset;
+    uint64_t ast_size;
+    uint64_t is_package;
+};
+static const char BUNDLE_MAGIC[8] = { 'P', 'Y', 'M', 'O', 'D', 'B', 'N', '1' };
+
+class ModuleBundle {
+private:
+    ASTCacheData file;
+    const BundleIndexEntry* index;
+    uint64_t num_modules;
+
+    ModuleBundle(ASTCacheData file, const BundleIndexEntry* index, uint64_t num_modules)
+        : file(std::move(file)), index(index), num_modules(num_modules) {}
+
+public:
+    // Returns NULL if the file doesn't exist or doesn't look like a valid bundle for this parser.
+    static ModuleBundle* open(const char* bundle_fn) {
+        FILE* fp = fopen(bundle_fn, "r");
+        if (!fp)
+            return NULL;
+
+        struct stat st;
+        int code = fstat(fileno(fp), &st);
+        assert(code == 0);
+        if ((size_t)st.st_size < sizeof(BundleHeader)) {
+            fclose(fp);
+            return NULL;
+        }
+        ASTCacheData file = ASTCacheFile::map(fp, st.st_size, bundle_fn);
+        fclose(fp);
+
+        size_t size = file->getSize();
+        const BundleHeader* header = reinterpret_cast<const BundleHeader*>(file->getData());
+        if (memcmp(header->magic, BUNDLE_MAGIC, sizeof(header->magic)) != 0
+            || memcmp(header->ast_magic, getMagic(), MAGIC_STRING_LENGTH) != 0)
+            return NULL;
+        if (header->num_modules > (size - sizeof(BundleHeader)) / sizeof(BundleIndexEntry))
+            return NULL;
+
+        const BundleIndexEntry* index = reinterpret_cast<const BundleIndexEntry*>(header + 1);
+        for (uint64_t i = 0; i < header->num_modules; i++) {
+            const BundleIndexEntry& e = index[i];
+            if (e.name_offset > size || (uint64_t)e.name_size + e.fn_size > size - e.name_offset)
+                return NULL;
+            if (e.ast_offset > size || e.ast_size > size - e.ast_offset)
+                return NULL;
+        }
+        return new ModuleBundle(std::move(file), index, header->num_modules);
+    }
+
+    const BundleIndexEntry* lookup(llvm::StringRef name) const {
+        const BundleIndexEntry* end = index + num_modules;
+        const BundleIndexEntry* it = std::lower_bound(
+            index, end, name, [this](const BundleIndexEntry& e, llvm::StringRef n) { return getName(e) < n; });
+        if (it == end || getName(*it) != name)
+            return NULL;
+        return it;
+    }
+
+    llvm::StringRef getName(const BundleIndexEntry& e) const {
+        return llvm::StringRef(file->getData() + e.name_offset, e.name_size);
+    }
+    llvm::StringRef getFilename(const BundleIndexEntry& e) const {
+        return llvm::StringRef(file->getData() + e.name_offset + e.name_size, e.fn_size);
+    }
+
+    AST_Module* read(const BundleIndexEntry& e) const {
+        ArenaScope _arena_scope(new Arena());
+        return readSerializedModule(ASTCacheFile::slice(file, e.ast_offset, e.ast_size), 0, getFilename(e).str());
+    }
+};
+
+struct ModuleSource {
+    std::string fn;
+    bool is_package;
+};
+}
+
+static ModuleBundle* getModuleBundle() {
+    static bool opened = false;
+    static ModuleBundle* bundle = NULL;
+    if (!opened) {
+        opened = true;
+        if (const char* bundle_fn = getenv("PYSTON_MODULE_BUNDLE")) {
+            bundle = ModuleBundle::open(bundle_fn);
+            if (!bundle && VERBOSITY() >= 1)
+                fprintf(stderr, "Couldn't load the module bundle '%s'\n", bundle_fn);
+        }
+    }
+    return bundle;
+}
+
+// Every module that got imported from its source in this run, keyed by name:
+static std::map<std::string, ModuleSource> modules_for_bundle;
+
+bool findInModuleBundle(const std::string& name, std::string* fn, bool* is_package) {
+    ModuleBundle* bundle = getModuleBundle();
+    if (!bundle)
+        return false;
+
+    const BundleIndexEntry* e = bundle->lookup(name);
+    if (!e)
+        return false;
+    *fn = bundle->getFilename(*e).str();
+    *is_package = e->is_package;
+    return true;
+}
+
+AST_Module* parseFromModuleBundle(const std::string& name, const std::string& fn) {
+    ModuleBundle* bundle = getModuleBundle();
+    if (!bundle)
+        return NULL;
+
+    const BundleIndexEntry* e = bundle->lookup(name);
+    if (!e || bundle->getFilename(*e) != fn)
+        return NULL;
+
+    STAT_TIMER(t0, "us_timer_parse_from_module_bundle");
+    static StatCounter num_bundled("num_modules_from_bundle");
+    num_bundled.log();
+    return bundle->read(*e);
+}
+
+void noteModuleForBundle(const std::string& name, const std::string& fn, bool is_package) {
+    static bool writing_bundle = getenv("PYSTON_WRITE_MODULE_BUNDLE") != NULL;
+    if (writing_bundle)
+        modules_for_bundle[name] = ModuleSource{ fn, is_package };
+}
+
+void writeModuleBundle() {
+    const char* bundle_fn = getenv("PYSTON_WRITE_MODULE_BUNDLE");
+    if (!bundle_fn)
+        return;
+
+    std::string tmp_fn = tempFileName(bundle_fn);
+    FILE* fp = fopen(tmp_fn.c_str(), "w");
+    if (!fp) {
+        fprintf(stderr, "Warning: couldn't write the module bundle '%s'\n", bundle_fn);
+        return;
+    }
+
+    // The index goes in front of the data, so leave room for it and fill it in at the end:
+    std::vector<BundleIndexEntry> index;
+    fseek(fp, sizeof(BundleHeader) + modules_for_bundle.size() * sizeof(BundleIndexEntry), SEEK_SET);
+
+    for (auto& p : modules_for_bundle) {
+        const std::string& name = p.first;
+        const ModuleSource& source = p.second;
+
+        // We don't hold on to the ASTs, so the modules get parsed again (which their .pyc files make cheap):
+        AST_Module* module;
+        try {
+            module = caching_parse_file(source.fn.c_str());
+        } catch (ExcInfo e) {
+            module = NULL;
+        }
+        if (!module) {
+            fprintf(stderr, "Warning: couldn't parse %s again; leaving it out of the module bundle\n",
+                    source.fn.c_str());
+            continue;
+        }
+
+        BundleIndexEntry e;
+        memset(&e, 0, sizeof(e));
+        e.name_offset = ftell(fp);
+        e.name_size = name.size();
+        e.fn_size = source.fn.size();
+        fwrite(name.data(), 1, name.size(), fp);
+        fwrite(source.fn.data(), 1, source.fn.size(), fp);
+        e.ast_offset = ftell(fp);
+        e.ast_size = serializeAST(module, fp);
+        e.is_package = source.is_package;
+        index.push_back(e);
+    }
+
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    memcpy(header.ast_magic, getMagic(), MAGIC_STRING_LENGTH);
+    header.num_modules = index.size();
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(&header, 1, sizeof(header), fp);
+    fwrite(index.data(), sizeof(BundleIndexEntry), index.size(), fp);
+
+    bool failed = ferror(fp);
+    fclose(fp);
+    if (failed || rename(tmp_fn.c_str(), bundle_fn) != 0) {
+        unlink(tmp_fn.c_str());
+        fprintf(stderr, "Warning: couldn't write the module bundle '%s'\n", bundle_fn);
+    } else if (VERBOSITY() >= 1) {
+        fprintf(stderr, "Wrote %ld modules to the module bundle '%s'\n", index.size(), bundle_fn);
+    }
 }
 }
@@ -15,6 +15,8 @@
 #ifndef PYSTON_CODEGEN_PARSER_H
 #define PYSTON_CODEGEN_PARSER_H
 
+#include <string>
+
 namespace pyston {
 
 class AST_Module;
@@ -23,6 +25,19 @@ AST_Module* parse_string(const char* code);
 
 AST_Module* parse_file(const char* fn);
 AST_Module* caching_parse_file(const char* fn);
+
+// Have the PREPARSE_THREADS background threads update the .pyc files of the modules in this package directory.
+void preparsePackage(const std::string& package_path);
+
+// Module bundles (PYSTON_MODULE_BUNDLE and PYSTON_WRITE_MODULE_BUNDLE; see parser.cpp):
+// Whether the bundle has the module with this name, and if so, which file it got imported from.
+bool findInModuleBundle(const std::string& name, std::string* fn, bool* is_package);
+// Returns NULL unless the bundle has this module, imported from this file.
+AST_Module* parseFromModuleBundle(const std::string& name, const std::string& fn);
+// Remembers a module that got imported from its source, to put it in the bundle we're writing (if any).
+void noteModuleForBundle(const std::string& name, const std::string& fn, bool is_package);
+// Called at exit.
+void writeModuleBundle();
 }
 
 #endif
@@ -0,0 +1,219 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/persistent_profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "codegen/type_recording.h"
+#include "core/ast.h"
+#include "core/cfg.h"
+#include "core/options.h"
+#include "core/stats.h"
+#include "core/types.h"
+#include "core/util.h"
+#include "runtime/objmodel.h"
+#include "runtime/types.h"
+
+namespace pyston {
+
+// The file format is line based, with tab-separated fields:
+//   T <file> <lineno> <col_offset> <node type> <class module> <class name> <count>
+//   E <file> <lineno> <function name> <effort level>
+static const char* PROFILE_HEADER = "pyston-profile 1";
+
+struct PersistedType {
+    std::string module, name;
+    int64_t count;
+};
+
+static std::string profile_file;
+static std::unordered_map<std::string, PersistedType> persisted_types;
+static std::unordered_map<std::string, int> persisted_efforts;
+
+// The nodes of the functions that we compiled in this run, along with the file they came from,
+// so that we can find their keys again when saving the profile.
+static std::unordered_map<AST*, const std::string*> node_files;
+static std::unordered_set<SourceInfo*> applied_sources;
+
+static std::string nodeKey(const std::string& fn, AST* node) {
+    std::ostringstream os;
+    os << fn << '\t' << node->lineno << '\t' << node->col_offset << '\t' << (int)node->type;
+    return os.str();
+}
+
+static std::string functionKey(SourceInfo* source) {
+    std::ostringstream os;
+    os << source->fn << '\t' << source->ast->lineno << '\t' << source->getName();
+    return os.str();
+}
+
+static void getClassName(BoxedClass* cls, std::string& module, std::string& name) {
+    Box* m = cls->getattr("__module__");
+    if (m && m->cls == str_cls)
+        module = static_cast<BoxedString*>(m)->s.str();
+    else
+        module = "__builtin__";
+    name = cls->tp_name;
+}
+
+// Only finds classes that are reachable as module attributes, which covers the builtin types and most
+// user-defined classes; anything else just doesn't get seeded.
+static BoxedClass* resolveClass(const PersistedType& t) {
+    Box* module = getSysModulesDict()->getOrNull(boxString(t.module));
+    if (!module)
+        return NULL;
+    Box* cls = module->getattr(t.name);
+    if (!cls || !isSubclass(cls->cls, type_cls))
+        return NULL;
+    return static_cast<BoxedClass*>(cls);
+}
+
+void loadPersistentProfile() {
+    const char* fn = getenv("PYSTON_PERSISTENT_PROFILE");
+    if (!fn)
+        return;
+    profile_file = fn;
+
+    std::ifstream f(profile_file);
+    std::string line;
+    if (!f || !std::getline(f, line) || line != PROFILE_HEADER)
+        return;
+
+    while (std::getline(f, line)) {
+        llvm::SmallVector<llvm::StringRef, 8> fields;
+        llvm::StringRef(line).split(fields, "\t");
+
+        if (fields[0] == "T" && fields.size() == 8) {
+            PersistedType t;
+            t.module = fields[5].str();
+            t.name = fields[6].str();
+            if (fields[7].getAsInteger(10, t.count))
+                continue;
+            std::string key = (fields[1] + "\t" + fields[2] + "\t" + fields[3] + "\t" + fields[4]).str();
+            persisted_types[key] = std::move(t);
+        } else if (fields[0] == "E" && fields.size() == 5) {
+            int effort;
+            if (fields[4].getAsInteger(10, effort) || effort < (int)EffortLevel::INTERPRETED
+                || effort > (int)EffortLevel::MAXIMAL)
+                continue;
+            std::string key = (fields[1] + "\t" + fields[2] + "\t" + fields[3]).str();
+            persisted_efforts[key] = effort;
+        }
+    }
+
+    static StatCounter num_types("persistent_profile_types_loaded");
+    num_types.log(persisted_types.size());
+    static StatCounter num_efforts("persistent_profile_functions_loaded");
+    num_efforts.log(persisted_efforts.size());
+}
+
+void savePersistentProfile() {
+    if (profile_file.empty())
+        return;
+
+    // Start from what we loaded, so that functions that didn't run this time keep their entries:
+    for (auto&& p : node_files) {
+        TypeRecorder* recorder = lookupTypeRecorderForNode(p.first);
+        if (!recorder || !recorder->topClass() || recorder->topCount() == 0)
+            continue;
+
+        PersistedType t;
+        getClassName(recorder->topClass(), t.module, t.name);
+        if (t.module.find_first_of("\t\n") != std::string::npos || t.name.find_first_of("\t\n") != std::string::npos)
+            continue;
+        t.count = recorder->topCount();
+        persisted_types[nodeKey(*p.second, p.first)] = std::move(t);
+    }
+
+    std::string tmp_file = tempFileName(profile_file);
+    {
+        std::ofstream f(tmp_file);
+        if (!f)
+            return;
+
+        f << PROFILE_HEADER << '\n';
+        for (auto&& p : persisted_types)
+            f << "T\t" << p.first << '\t' << p.second.module << '\t' << p.second.name << '\t' << p.second.count
+              << '\n';
+        for (auto&& p : persisted_efforts)
+            f << "E\t" << p.first << '\t' << p.second << '\n';
+
+        if (!f)
+            return;
+    }
+    rename(tmp_file.c_str(), profile_file.c_str());
+}
+
+void applyPersistentProfile(SourceInfo* source) {
+    if (profile_file.empty())
+        return;
+    if (!applied_sources.insert(source).second)
+        return;
+
+    assert(source->cfg);
+    std::vector<AST*> nodes;
+    for (CFGBlock* block : source->cfg->blocks)
+        flatten(block->body, nodes, false);
+
+    for (AST* node : nodes) {
+        node_files[node] = &source->fn;
+
+        auto it = persisted_types.find(nodeKey(source->fn, node));
+        if (it == persisted_types.end())
+            continue;
+
+        BoxedClass* cls = resolveClass(it->second);
+        if (!cls)
+            continue;
+
+        TypeRecorder* recorder = getTypeRecorderForNode(node);
+        // Feedback from this run takes priority:
+        if (!recorder->topClass()) {
+            static StatCounter num_seeded("persistent_profile_types_seeded");
+            num_seeded.log();
+            recorder->seed(cls, it->second.count);
+        }
+    }
+}
+
+EffortLevel getPersistedEffort(SourceInfo* source) {
+    if (persisted_efforts.empty())
+        return EffortLevel::INTERPRETED;
+
+    auto it = persisted_efforts.find(functionKey(source));
+    if (it == persisted_efforts.end())
+        return EffortLevel::INTERPRETED;
+
+    static StatCounter num_applied("persistent_profile_efforts_applied");
+    num_applied.log();
+    return (EffortLevel)it->second;
+}
+
+void notePersistentEffort(SourceInfo* source, EffortLevel effort) {
+    if (profile_file.empty())
+        return;
+
+    int& saved = persisted_efforts[functionKey(source)];
+    saved = std::max(saved, (int)effort);
+}
+}
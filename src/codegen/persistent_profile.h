@@ -0,0 +1,41 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_PERSISTENTPROFILE_H
+#define PYSTON_CODEGEN_PERSISTENTPROFILE_H
+
+namespace pyston {
+
+class SourceInfo;
+enum class EffortLevel;
+
+// The persistent profile remembers the type feedback and the effort levels that functions ended up getting compiled
+// at, so that the next run can skip most of the warmup.  It's enabled by pointing PYSTON_PERSISTENT_PROFILE at a
+// file: the profile gets loaded from there at startup (if it exists), and the merged profile is written back at exit.
+//
+// Nodes are identified by their file and source position, and classes by their module and name, so the worst that
+// a stale profile can do is cause some failed speculations, which we recover from like any other.
+void loadPersistentProfile();
+void savePersistentProfile();
+
+// Called before compiling a function; seeds the type recorders of the function's nodes from the profile.
+void applyPersistentProfile(SourceInfo* source);
+
+// The highest effort level this function got compiled at in a previous run (INTERPRETED if we don't know).
+// Only whole-function compiles count: a function whose loop got OSR'd still starts out in the lower tiers.
+EffortLevel getPersistedEffort(SourceInfo* source);
+void notePersistentEffort(SourceInfo* source, EffortLevel effort);
+}
+
+#endif
@@ -23,6 +23,7 @@
 #include <pypa/ast/visitor.hh>
 #include <pypa/parser/parser.hh>
 #include <sys/stat.h>
+#include <vector>
 
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/SwapByteOrder.h"
@@ -30,6 +31,7 @@
 #include "core/ast.h"
 #include "core/options.h"
 #include "core/stats.h"
+#include "core/threading.h"
 #include "core/types.h"
 #include "core/util.h"
 #include "gc/collector.h"
@@ -834,8 +836,27 @@ AST_Module* readModule(pypa::AstModule& t) {
     return mod;
 }
 
+// Set while pypa_parse_without_gil() is running; everything that touches the runtime has to be inside a
+// RuntimeAccessRegion then.
+static __thread bool parsing_without_gil = false;
+
+namespace {
+class RuntimeAccessRegion {
+public:
+    RuntimeAccessRegion() {
+        if (parsing_without_gil)
+            threading::endAllowThreads();
+    }
+    ~RuntimeAccessRegion() {
+        if (parsing_without_gil)
+            threading::beginAllowThreads();
+    }
+};
+}
+
 void pypaErrorHandler(pypa::Error e) {
     if (e.type != pypa::ErrorType::SyntaxWarning) {
+        RuntimeAccessRegion _runtime;
         raiseSyntaxError(e.message.c_str(), e.cur.line, e.cur.column, e.file_name, std::string());
     }
 }
@@ -923,6 +944,7 @@ static PyObject* decode_unicode(const char* s, size_t len, int rawmode, const ch
 
 pypa::String pypaEscapeDecoder(const pypa::String& s, const pypa::String& encoding, bool unicode, bool raw_prefix,
                                bool& error) {
+    RuntimeAccessRegion _runtime;
     try {
         error = false;
         if (unicode) {
@@ -970,6 +992,7 @@ public:
     ~PystonSourceReader() override;
 
     bool open_file(const std::string& file_path);
+    void open_string(const char* code, const std::string& file_path);
     void close();
 
     bool set_encoding(const std::string& coding) override;
@@ -980,17 +1003,20 @@ public:
     bool eof() const override { return is_eof; }
 
 private:
-    char next();
-
     std::string file_path;
     bool is_eof;
+    // NULL when parsing a string.
     FILE* file;
+    // The file gets read in one go, and get_line() splits the lines out of this (unless there's an encoding
+    // declaration, in which case the rest of the file gets read through the codec):
+    std::vector<char> data;
+    size_t pos;
     unsigned line_number;
     PyObject* readline;
     std::string encoding;
 };
 
-PystonSourceReader::PystonSourceReader() : file(nullptr), readline(nullptr) {
+PystonSourceReader::PystonSourceReader() : file(nullptr), pos(0), readline(nullptr) {
     close();
 }
 
@@ -1003,26 +1029,67 @@ bool PystonSourceReader::open_file(const std::string& _file_path) {
     if (!file)
         return false;
 
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0 && st.st_size > 0)
+        data.reserve(st.st_size);
+    char buf[4096];
+    while (size_t nread = fread(buf, 1, sizeof(buf), file))
+        data.insert(data.end(), buf, buf + nread);
+
     file_path = _file_path;
     is_eof = false;
+    pos = 0;
     line_number = 0;
     readline = nullptr;
     return true;
 }
 
+void PystonSourceReader::open_string(const char* code, const std::string& _file_path) {
+    data.assign(code, code + strlen(code));
+    data.push_back('\n');
+
+    file_path = _file_path;
+    is_eof = false;
+    pos = 0;
+    line_number = 0;
+    readline = nullptr;
+}
+
 void PystonSourceReader::close() {
     if (file)
         fclose(file);
     file = nullptr;
     file_path.clear();
+    data.clear();
+    pos = 0;
     is_eof = true;
-    if (readline)
+    if (readline) {
+        RuntimeAccessRegion _runtime;
         gc::deregisterPermanentRoot(readline);
+    }
     readline = nullptr;
     line_number = 0;
 }
 
 bool PystonSourceReader::set_encoding(const std::string& coding) {
+    RuntimeAccessRegion _runtime;
+
+    if (!file) {
+        // There's no file to put a stream reader on, so decode the rest of the string in one go and keep splitting
+        // the lines out of the buffer; they end up as UTF-8 either way.
+        PyObject* decoded = PyUnicode_Decode(data.data() + pos, data.size() - pos, coding.c_str(), NULL);
+        if (decoded == NULL)
+            return false;
+        PyObject* utf8 = PyUnicode_AsUTF8String(decoded);
+        if (utf8 == NULL)
+            return false;
+        data.resize(pos);
+        data.insert(data.end(), PyString_AS_STRING(utf8), PyString_AS_STRING(utf8) + PyString_GET_SIZE(utf8));
+        return true;
+    }
+
+    // Continue from where we are in the buffer:
+    fseek(file, pos, SEEK_SET);
     PyObject* stream = PyFile_FromFile(file, file_path.c_str(), "rb", NULL);
     if (stream == NULL)
         return false;
@@ -1039,36 +1106,30 @@ bool PystonSourceReader::set_encoding(const std::string& coding) {
     return true;
 }
 
-char PystonSourceReader::next() {
-    if (is_eof)
-        return 0;
-
-    int c = fgetc(file);
-    if (c == EOF) {
-        is_eof = true;
-        return 0;
-    }
-    return c;
-}
-
 std::string PystonSourceReader::get_line() {
     if (eof())
         return std::string();
 
     if (!readline) {
-        std::string line;
-        char c;
-        do {
-            c = next();
-            if (eof())
-                break;
-            line.push_back(c);
-        } while (c != '\n' && c != '\x0c');
-        if (!eof())
-            ++line_number;
-        return line;
+        const char* start = data.data() + pos;
+        const char* end = data.data() + data.size();
+        const char* p = start;
+        while (p < end && *p != '\n' && *p != '\x0c')
+            p++;
+
+        if (p == end) {
+            is_eof = true;
+            pos = data.size();
+            return std::string(start, end);
+        }
+
+        p++;
+        pos = p - data.data();
+        ++line_number;
+        return std::string(start, p);
     }
 
+    RuntimeAccessRegion _runtime;
     BoxedString* line = (BoxedString*)runtimeCall(readline, ArgPassSpec(0), 0, 0, 0, 0, 0);
     if (line->cls == unicode_cls) {
         line = (BoxedString*)PyUnicode_AsUTF8String(line);
@@ -1084,11 +1145,7 @@ std::string PystonSourceReader::get_line() {
     return line->s;
 }
 
-AST_Module* pypa_parse(char const* file_path) {
-    auto reader = llvm::make_unique<PystonSourceReader>();
-    if (!reader->open_file(file_path))
-        return nullptr;
-
+static AST_Module* parseWithReader(std::unique_ptr<PystonSourceReader> reader) {
     pypa::Lexer lexer(std::move(reader));
     pypa::SymbolTablePtr symbols;
     pypa::AstModulePtr module;
@@ -1106,4 +1163,30 @@ AST_Module* pypa_parse(char const* file_path) {
     }
     return nullptr;
 }
+
+AST_Module* pypa_parse(char const* file_path) {
+    auto reader = llvm::make_unique<PystonSourceReader>();
+    if (!reader->open_file(file_path))
+        return nullptr;
+    return parseWithReader(std::move(reader));
+}
+
+AST_Module* pypa_parse_string(char const* code) {
+    auto reader = llvm::make_unique<PystonSourceReader>();
+    reader->open_string(code, "<string>");
+    return parseWithReader(std::move(reader));
+}
+
+AST_Module* pypa_parse_without_gil(char const* file_path) {
+    assert(!parsing_without_gil);
+    parsing_without_gil = true;
+    try {
+        AST_Module* rtn = pypa_parse(file_path);
+        parsing_without_gil = false;
+        return rtn;
+    } catch (ExcInfo e) {
+        parsing_without_gil = false;
+        throw e;
+    }
+}
 }
@@ -20,6 +20,10 @@
 namespace pyston {
 class AST_Module;
 AST_Module* pypa_parse(char const* file_path);
+// Parses code that's in memory (ex: for compile() and exec), without going through a file.
+AST_Module* pypa_parse_string(char const* code);
+// For threads that have released the GIL: the parser only takes it in the callbacks that need the runtime.
+AST_Module* pypa_parse_without_gil(char const* file_path);
 }
 
 #endif // PYSTON_CODEGEN_PYPAPARSER_H
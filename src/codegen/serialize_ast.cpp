@@ -14,8 +14,10 @@
 
 #include "codegen/serialize_ast.h"
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/SwapByteOrder.h"
 
+#include "analysis/scoping_analysis.h"
 #include "core/ast.h"
 
 namespace pyston {
@@ -26,14 +28,22 @@ private:
     FILE* file;
 
 public:
+    // The AST is preceded by the offset of the string table, which comes after it.
     static unsigned int write(AST_Module* module, FILE* file) {
         SerializeASTVisitor visitor(file);
         unsigned long start_pos = ftell(file);
+        visitor.writeUInt(0);
         visitor.writeASTMisc(module);
+        visitor.writeStringTable(start_pos);
         return ftell(file) - start_pos;
     }
 
 private:
+    // Interned strings get written as indices into the string table, so that the reader only has to intern
+    // each of them once:
+    llvm::DenseMap<InternedString, uint32_t> string_indices;
+    std::vector<InternedString> strings;
+
     SerializeASTVisitor(FILE* file) : file(file) {}
     virtual ~SerializeASTVisitor() {}
 
@@ -67,7 +77,26 @@ private:
         fwrite(v.c_str(), 1, v.size(), file);
     }
 
-    void writeString(const InternedString v) { writeString(v.str()); }
+    void writeString(const InternedString v) {
+        auto it = string_indices.find(v);
+        if (it == string_indices.end()) {
+            it = string_indices.insert(std::make_pair(v, (uint32_t)strings.size())).first;
+            strings.push_back(v);
+        }
+        writeUInt(it->second);
+    }
+
+    void writeStringTable(unsigned long start_pos) {
+        unsigned long table_pos = ftell(file);
+        writeUInt(strings.size());
+        for (InternedString s : strings)
+            writeString(s.str());
+
+        unsigned long end_pos = ftell(file);
+        fseek(file, start_pos, SEEK_SET);
+        writeUInt(table_pos - start_pos);
+        fseek(file, end_pos, SEEK_SET);
+    }
 
     void writeStringVector(const std::vector<InternedString>& vec) {
         writeShort(vec.size());
@@ -106,6 +135,22 @@ private:
         }
     }
 
+    // Function bodies are prefixed with their length, so that the reader can skip over them (see
+    // LazyFunctionBody), followed by the flags it needs to know without reading them.
+    void writeFunctionBody(AST_FunctionDef* node) {
+        long length_pos = ftell(file);
+        writeULL(0);
+
+        long start_pos = ftell(file);
+        writeByte(containsYield(node) ? FUNCTION_BODY_CONTAINS_YIELD : 0);
+        writeStmtVector(node->body);
+        long end_pos = ftell(file);
+
+        fseek(file, length_pos, SEEK_SET);
+        writeULL(end_pos - start_pos);
+        fseek(file, end_pos, SEEK_SET);
+    }
+
     void writeColOffset(uint32_t v) {
         assert(v < 100000 || v == -1);
         writeULL(v == -1 ? 0 : v);
@@ -300,7 +345,7 @@ private:
     }
     virtual bool visit_functiondef(AST_FunctionDef* node) {
         writeASTMisc(node->args);
-        writeStmtVector(node->body);
+        writeFunctionBody(node);
         writeColOffset(node->col_offset);
         writeExprVector(node->decorator_list);
         writeLineno(node->lineno);
@@ -19,6 +19,10 @@
 
 namespace pyston {
 class AST_Module;
+
+// Flags that get written in front of each function body (parse_ast.py writes them too):
+#define FUNCTION_BODY_CONTAINS_YIELD 0x01
+
 unsigned long serializeAST(AST_Module* module, FILE* file);
 }
 
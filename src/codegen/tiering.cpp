@@ -0,0 +1,167 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/tiering.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <unordered_map>
+
+#include "core/cfg.h"
+#include "core/common.h"
+#include "core/options.h"
+#include "core/stats.h"
+#include "core/types.h"
+
+namespace pyston {
+
+// A call counts as much as this many backedges:
+static const int64_t BACKEDGES_PER_CALL = 16;
+// Functions with at most this many CFG blocks skip the MODERATE tier:
+static const int SMALL_FUNCTION_BLOCKS = 8;
+// Don't trust the averages until we've seen this many compiles at an effort level:
+static const int MIN_COMPILES_FOR_ESTIMATE = 4;
+static const double MIN_THRESHOLD_SCALE = 0.25;
+static const double MAX_THRESHOLD_SCALE = 4.0;
+
+static const int NUM_EFFORT_LEVELS = (int)EffortLevel::MAXIMAL + 1;
+
+namespace {
+struct CompileCosts {
+    int64_t total_us = 0;
+    int64_t total_blocks = 0;
+    int64_t num_compiles = 0;
+};
+}
+
+static CompileCosts costs_by_effort[NUM_EFFORT_LEVELS];
+// The most recent compile time of each function at each effort level (-1 if it hasn't been compiled at that level).
+static std::unordered_map<SourceInfo*, std::array<long, NUM_EFFORT_LEVELS>> function_costs;
+
+static int numBlocks(SourceInfo* source) {
+    if (!source->cfg)
+        return 1;
+    return std::max(1, (int)source->cfg->blocks.size());
+}
+
+// How much more (or less) expensive compiling this function at the given effort level is than the average one.
+static double compileCostScale(SourceInfo* source, EffortLevel effort, long* estimated_us) {
+    *estimated_us = -1;
+    if (!ENABLE_ADAPTIVE_TIERING)
+        return 1.0;
+
+    const CompileCosts& costs = costs_by_effort[(int)effort];
+    if (costs.num_compiles < MIN_COMPILES_FOR_ESTIMATE || costs.total_us == 0)
+        return 1.0;
+
+    auto it = function_costs.find(source);
+    if (it != function_costs.end() && it->second[(int)effort] >= 0)
+        *estimated_us = it->second[(int)effort];
+    else
+        *estimated_us = numBlocks(source) * costs.total_us / std::max(costs.total_blocks, (int64_t)1);
+
+    double average_us = (double)costs.total_us / costs.num_compiles;
+    double scale = *estimated_us / average_us;
+    return std::min(MAX_THRESHOLD_SCALE, std::max(MIN_THRESHOLD_SCALE, scale));
+}
+
+static int64_t scaleThreshold(int64_t base, SourceInfo* source, EffortLevel cur_effort, EffortLevel new_effort,
+                              const char* kind) {
+    long estimated_us;
+    double scale = compileCostScale(source, new_effort, &estimated_us);
+    int64_t threshold = std::max((int64_t)1, (int64_t)(base * scale));
+
+    if (threshold < base) {
+        static StatCounter num_lowered("tiering_thresholds_lowered");
+        num_lowered.log();
+    } else if (threshold > base) {
+        static StatCounter num_raised("tiering_thresholds_raised");
+        num_raised.log();
+    }
+
+    if (LOG_TIERING_DECISIONS) {
+        fprintf(stderr, "tiering: %s %s:%s at effort %d -> %d after %ld (default %ld; %d blocks, estimated compile "
+                        "time %ldus)\n",
+                kind, source->fn.c_str(), source->getName().c_str(), (int)cur_effort, (int)new_effort, threshold, base,
+                numBlocks(source), estimated_us);
+    }
+    return threshold;
+}
+
+int64_t getHotness(CompiledFunction* cf) {
+    return cf->times_called + cf->times_backedges / BACKEDGES_PER_CALL;
+}
+
+int64_t getReoptThreshold(SourceInfo* source, EffortLevel effort) {
+    int64_t base;
+    if (effort == EffortLevel::INTERPRETED)
+        base = REOPT_THRESHOLD_INTERPRETER;
+    else if (effort == EffortLevel::MINIMAL)
+        base = REOPT_THRESHOLD_BASELINE;
+    else if (effort == EffortLevel::MODERATE)
+        base = REOPT_THRESHOLD_T2;
+    else
+        RELEASE_ASSERT(0, "Unknown effort: %d", (int)effort);
+
+    return scaleThreshold(base, source, effort, getReoptEffort(source, effort), "reopt");
+}
+
+int64_t getOSRThreshold(SourceInfo* source, EffortLevel effort) {
+    int64_t base;
+    if (effort == EffortLevel::INTERPRETED)
+        base = OSR_THRESHOLD_INTERPRETER;
+    else if (effort == EffortLevel::MINIMAL)
+        base = OSR_THRESHOLD_BASELINE;
+    else if (effort == EffortLevel::MODERATE)
+        base = OSR_THRESHOLD_T2;
+    else
+        RELEASE_ASSERT(0, "Unknown effort: %d", (int)effort);
+
+    return scaleThreshold(base, source, effort, getOSREffort(source, effort), "osr");
+}
+
+EffortLevel getReoptEffort(SourceInfo* source, EffortLevel effort) {
+    if (effort == EffortLevel::INTERPRETED)
+        return EffortLevel::MINIMAL;
+    if (effort == EffortLevel::MINIMAL) {
+        if (ENABLE_ADAPTIVE_TIERING && numBlocks(source) <= SMALL_FUNCTION_BLOCKS)
+            return EffortLevel::MAXIMAL;
+        return EffortLevel::MODERATE;
+    }
+    RELEASE_ASSERT(effort == EffortLevel::MODERATE, "unknown effort: %d", (int)effort);
+    return EffortLevel::MAXIMAL;
+}
+
+EffortLevel getOSREffort(SourceInfo* source, EffortLevel effort) {
+    return effort == EffortLevel::INTERPRETED ? EffortLevel::MINIMAL : EffortLevel::MAXIMAL;
+}
+
+void noteCompileTime(SourceInfo* source, EffortLevel effort, long us) {
+    if (effort == EffortLevel::INTERPRETED)
+        return;
+
+    CompileCosts& costs = costs_by_effort[(int)effort];
+    costs.total_us += us;
+    costs.total_blocks += numBlocks(source);
+    costs.num_compiles++;
+
+    auto it = function_costs.find(source);
+    if (it == function_costs.end()) {
+        it = function_costs.insert(std::make_pair(source, std::array<long, NUM_EFFORT_LEVELS>())).first;
+        it->second.fill(-1);
+    }
+    it->second[(int)effort] = us;
+}
+}
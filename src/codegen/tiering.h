@@ -0,0 +1,52 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_TIERING_H
+#define PYSTON_CODEGEN_TIERING_H
+
+#include <cstdint>
+
+namespace pyston {
+
+class CompiledFunction;
+class SourceInfo;
+enum class EffortLevel;
+
+// The tiering policy decides when code gets recompiled at a higher effort level, and at which one.
+//
+// The REOPT_THRESHOLD_* and OSR_THRESHOLD_* options are the thresholds for a function of typical compile cost.
+// With ENABLE_ADAPTIVE_TIERING, each function's thresholds get scaled by how expensive it is to compile compared
+// to the other functions we've compiled at the same effort level (using the measured compile times, or the
+// function's size if we haven't compiled it at that level yet), so that cheap functions tier up sooner and
+// expensive ones have to prove that they're hot first.  Small functions also skip straight from the baseline
+// LLVM tier to MAXIMAL, since compiling them at MAXIMAL is cheap anyway.
+//
+// Set LOG_TIERING_DECISIONS to have each decision printed to stderr.
+
+// How hot a version is: the interpreter also counts backedges, so that a function that gets called rarely
+// but loops a lot still gets reoptimized.
+int64_t getHotness(CompiledFunction* cf);
+// The hotness at which code compiled at the given effort level should get reoptimized.
+int64_t getReoptThreshold(SourceInfo* source, EffortLevel effort);
+// The number of times a backedge has to be taken before we OSR out of code compiled at the given effort level.
+int64_t getOSRThreshold(SourceInfo* source, EffortLevel effort);
+
+EffortLevel getReoptEffort(SourceInfo* source, EffortLevel effort);
+EffortLevel getOSREffort(SourceInfo* source, EffortLevel effort);
+
+// Called after every compile, so that the policy can learn what compiling costs.
+void noteCompileTime(SourceInfo* source, EffortLevel effort, long us);
+}
+
+#endif
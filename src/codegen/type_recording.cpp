@@ -14,6 +14,7 @@
 
 #include "codegen/type_recording.h"
 
+#include <algorithm>
 #include <unordered_map>
 
 #include "core/options.h"
@@ -29,16 +30,37 @@ TypeRecorder* getTypeRecorderForNode(AST* node) {
     return r;
 }
 
+TypeRecorder* lookupTypeRecorderForNode(AST* node) {
+    auto it = type_recorders.find(node);
+    if (it == type_recorders.end())
+        return NULL;
+    return it->second;
+}
+
 Box* recordType(TypeRecorder* self, Box* obj) {
     BoxedClass* cls = obj->cls;
-    if (cls != self->last_seen) {
-        self->last_seen = cls;
-        self->last_count = 1;
+    self->total++;
+
+    int i = 0;
+    while (i < TypeRecorder::NUM_CLASSES - 1 && self->classes[i] != cls && self->classes[i] != NULL)
+        i++;
+
+    if (self->classes[i] != cls) {
+        self->classes[i] = cls;
+        self->counts[i] = 1;
     } else {
-        self->last_count++;
+        self->counts[i]++;
+    }
+
+    // Keep the histogram sorted.  A class that just replaced the least common one starts at a count of 1, so
+    // it can be behind several entries with that same count; move it up as far as it needs to go.
+    while (i > 0 && self->counts[i] > self->counts[i - 1]) {
+        std::swap(self->classes[i], self->classes[i - 1]);
+        std::swap(self->counts[i], self->counts[i - 1]);
+        i--;
     }
 
-    // printf("Seen %s %ld times\n", getNameOfClass(cls)->c_str(), self->last_count);
+    // printf("Seen %s %ld times\n", getNameOfClass(cls)->c_str(), self->counts[0]);
 
     return obj;
 }
@@ -52,13 +74,44 @@ BoxedClass* predictClassFor(AST* node) {
     return r->predict();
 }
 
+int predictClassesFor(AST* node, BoxedClass** classes, int max_classes) {
+    auto it = type_recorders.find(node);
+    if (it == type_recorders.end())
+        return 0;
+
+    TypeRecorder* r = it->second;
+    return r->predictClasses(classes, max_classes);
+}
+
 BoxedClass* TypeRecorder::predict() {
     if (!ENABLE_TYPE_FEEDBACK)
         return NULL;
 
-    if (last_count > SPECULATION_THRESHOLD)
-        return last_seen;
+    if (counts[0] <= SPECULATION_THRESHOLD)
+        return NULL;
+
+    // We can only speculate on a single class, and every miss costs a deopt, so only predict the most
+    // common class if it's responsible for the vast majority of what we've seen.  This has to go by the total,
+    // since the histogram forgets the classes that it evicted:
+    int64_t others = total - counts[0];
+    if (others * 20 > counts[0])
+        return NULL;
 
-    return NULL;
+    return classes[0];
+}
+
+int TypeRecorder::predictClasses(BoxedClass** out, int max_classes) {
+    if (!ENABLE_TYPE_FEEDBACK)
+        return 0;
+
+    assert(max_classes <= NUM_CLASSES);
+    int64_t covered = 0;
+    for (int i = 0; i < max_classes && classes[i]; i++) {
+        out[i] = classes[i];
+        covered += counts[i];
+        if (covered > SPECULATION_THRESHOLD && (total - covered) * 20 <= covered)
+            return i + 1;
+    }
+    return 0;
 }
 }
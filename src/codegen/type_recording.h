@@ -32,21 +32,54 @@ class TypeRecorder;
 // specified.)
 extern "C" Box* recordType(TypeRecorder* recorder, Box* obj);
 class TypeRecorder {
+public:
+    static const int NUM_CLASSES = 4;
+
 private:
-    BoxedClass* last_seen;
-    int64_t last_count;
+    // A small histogram of the classes we've seen, kept sorted by count (most common first).
+    // Once it's full, a new class replaces the least common one.
+    BoxedClass* classes[NUM_CLASSES];
+    int64_t counts[NUM_CLASSES];
+    // Everything we've recorded, including the classes that got dropped from the histogram since:
+    int64_t total;
 
 public:
-    constexpr TypeRecorder() : last_seen(nullptr), last_count(0) {}
+    constexpr TypeRecorder() : classes(), counts(), total(0) {}
 
     BoxedClass* predict();
+    // Like predict(), but for sites that see a few different classes: if the most common (up to) max_classes of
+    // them account for the vast majority of what we've seen, stores them in out (most common first) and returns
+    // how many there are.  Returns 0 otherwise.
+    int predictClasses(BoxedClass** out, int max_classes);
+
+    BoxedClass* topClass() const { return classes[0]; }
+    int64_t topCount() const { return counts[0]; }
+
+    // Whether everything we've recorded (if anything) was an instance of cls.
+    bool onlySaw(BoxedClass* cls) const {
+        for (int i = 0; i < NUM_CLASSES; i++) {
+            if (classes[i] && classes[i] != cls)
+                return false;
+        }
+        return true;
+    }
+
+    // Start out with feedback from somewhere else (ie a previous run).
+    void seed(BoxedClass* cls, int64_t count) {
+        classes[0] = cls;
+        counts[0] = count;
+        total += count;
+    }
 
     friend Box* recordType(TypeRecorder*, Box*);
 };
 
 TypeRecorder* getTypeRecorderForNode(AST* node);
+// Returns NULL if there's no recorder for this node yet.
+TypeRecorder* lookupTypeRecorderForNode(AST* node);
 
 BoxedClass* predictClassFor(AST* node);
+int predictClassesFor(AST* node, BoxedClass** classes, int max_classes);
 }
 
 #endif
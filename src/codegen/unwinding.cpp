@@ -130,6 +130,12 @@ public:
         cfs.insert(cfs.begin() + (-idx - 1), cf);
     }
 
+    void deregisterCF(CompiledFunction* cf) {
+        int idx = find_cf((uint64_t)cf->code_start + 1);
+        if (idx >= 0 && cfs[idx] == cf)
+            cfs.erase(cfs.begin() + idx);
+    }
+
     CompiledFunction* getCFForAddress(uint64_t addr) {
         if (cfs.empty())
             return NULL;
@@ -143,11 +149,25 @@ public:
 };
 
 static CFRegistry cf_registry;
+static std::unordered_map<CompiledFunction*, unw_dyn_info_t*> cf_dyn_infos;
 
 CompiledFunction* getCFForAddress(uint64_t addr) {
     return cf_registry.getCFForAddress(addr);
 }
 
+void deregisterCompiledCode(CompiledFunction* cf) {
+    cf_registry.deregisterCF(cf);
+
+    auto it = cf_dyn_infos.find(cf);
+    if (it != cf_dyn_infos.end()) {
+        unw_dyn_info_t* dyn_info = it->second;
+        _U_dyn_cancel(dyn_info);
+        delete[](uw_table_entry*) dyn_info->u.rti.table_data;
+        delete dyn_info;
+        cf_dyn_infos.erase(it);
+    }
+}
+
 class TracebacksEventListener : public llvm::JITEventListener {
 public:
     virtual void NotifyObjectEmitted(const llvm::object::ObjectFile& Obj,
@@ -242,6 +262,7 @@ public:
         if (VERBOSITY() >= 2)
             printf("dyn_info = %p, table_data = %p\n", dyn_info, (void*)dyn_info->u.rti.table_data);
         _U_dyn_register(dyn_info);
+        cf_dyn_infos[g.cur_cf] = dyn_info;
 
         // TODO: it looks like libunwind does a linear search over anything dynamically registered,
         // as opposed to the binary search it can do within a dyn_info.
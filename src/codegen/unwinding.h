@@ -39,6 +39,9 @@ struct ExecutionPoint {
 };
 ExecutionPoint getExecutionPoint();
 
+// Forgets about the code of a CompiledFunction that's about to get freed.
+void deregisterCompiledCode(CompiledFunction* cf);
+
 // Adds stack locals and closure locals into the locals dict, and returns it.
 Box* fastLocalsToBoxedLocals();
 
@@ -0,0 +1,59 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/arena.h"
+
+#include "core/stats.h"
+
+namespace pyston {
+
+static __thread Arena* current_arena = NULL;
+
+
+ArenaScope::ArenaScope(Arena* arena) : prev(current_arena) {
+    assert(arena);
+    current_arena = arena;
+}
+
+ArenaScope::~ArenaScope() {
+    current_arena = prev;
+}
+
+Arena* ArenaScope::current() {
+    if (current_arena)
+        return current_arena;
+    return global();
+}
+
+Arena* ArenaScope::global() {
+    static Arena* arena = new Arena();
+    return arena;
+}
+
+void* Arena::SlabAllocator::Allocate(size_t size, size_t alignment) {
+    static StatCounter slab_bytes("arena_slab_bytes");
+    slab_bytes.log(size);
+    return malloc(size);
+}
+
+void* Arena::allocate(size_t size) {
+    static StatCounter bytes_used("arena_bytes_used");
+    bytes_used.log(size);
+    return allocator.Allocate(size, 16);
+}
+
+void* ArenaAllocated::operator new(size_t size) {
+    return ArenaScope::current()->allocate(size);
+}
+}
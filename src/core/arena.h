@@ -0,0 +1,83 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CORE_ARENA_H
+#define PYSTON_CORE_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+
+#include "llvm/Support/Allocator.h"
+
+#include "core/common.h"
+
+namespace pyston {
+
+// The frontend creates lots of small objects (AST nodes, CFG blocks, scoping info) that never get freed
+// individually and all die at the same time, so instead of going through malloc one at a time they get
+// bump-allocated from an Arena, which keeps them packed together and frees them in one go.
+//
+// Classes opt in by deriving from ArenaAllocated: `new` then allocates from the innermost ArenaScope active on the
+// current thread, or from a process-wide arena (which never gets freed) if there isn't one.  `delete` still runs
+// the destructor, but the memory only gets reclaimed along with the whole arena, so whoever owns an Arena has to
+// make sure that nothing allocated from it outlives it.
+//
+// Each parsed module gets an arena for its AST, and its ScopingAnalysis has one for the scoping info and the CFGs of
+// its functions; the stats arena_bytes_used and arena_slab_bytes show how much of the memory they take up is used.
+// Code that gets compiled from strings (eval, exec, compile()) is usually much smaller than a slab and can get
+// compiled any number of times, so all of it shares the global arena instead.
+class Arena {
+private:
+    // Gets the slabs from malloc, and counts them.
+    class SlabAllocator : public llvm::AllocatorBase<SlabAllocator> {
+    public:
+        void* Allocate(size_t size, size_t alignment);
+        using llvm::AllocatorBase<SlabAllocator>::Allocate;
+        void Deallocate(const void* ptr, size_t size) { free(const_cast<void*>(ptr)); }
+        using llvm::AllocatorBase<SlabAllocator>::Deallocate;
+    };
+
+    llvm::BumpPtrAllocatorImpl<SlabAllocator> allocator;
+
+public:
+    Arena() {}
+    Arena(const Arena&) = delete;
+    void operator=(const Arena&) = delete;
+
+    void* allocate(size_t size);
+    size_t getBytesAllocated() const { return allocator.getBytesAllocated(); }
+};
+
+class ArenaScope {
+private:
+    Arena* prev;
+
+public:
+    ArenaScope(Arena* arena);
+    ~ArenaScope();
+
+    // The arena that ArenaAllocated objects get allocated from right now; never NULL.
+    static Arena* current();
+    // The arena that gets used outside of any ArenaScope; never gets freed, and must only be used with the GIL held.
+    static Arena* global();
+};
+
+class ArenaAllocated {
+public:
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr) {}
+};
+}
+
+#endif
@@ -518,6 +518,7 @@ void AST_FunctionDef::accept(ASTVisitor* v) {
 
     visitVector(decorator_list, v);
     args->accept(v);
+    ensureBody();
     visitVector(body, v);
 }
 
@@ -1362,6 +1363,7 @@ bool PrintVisitor::visit_functiondef(AST_FunctionDef* node) {
     node->args->accept(this);
     printf(")");
 
+    node->ensureBody();
     indent += 4;
     for (int i = 0; i < node->body.size(); i++) {
         printf("\n");
@@ -1914,9 +1916,10 @@ private:
     bool expand_scopes;
 
 public:
-    FlattenVisitor(std::vector<AST*>* output, bool expand_scopes) : output(output), expand_scopes(expand_scopes) {
-        assert(expand_scopes && "not sure if this works properly");
-    }
+    // Without expand_scopes, the children of nodes that start a new scope get skipped, including the ones that get
+    // evaluated in the enclosing scope (ex default arguments); that's only meant for CFG blocks, where the scope nodes
+    // only show up inside of MakeFunction / MakeClass.
+    FlattenVisitor(std::vector<AST*>* output, bool expand_scopes) : output(output), expand_scopes(expand_scopes) {}
 
     virtual bool visit_alias(AST_alias* node) {
         output->push_back(node);
@@ -2012,7 +2015,8 @@ public:
     }
     virtual bool visit_functiondef(AST_FunctionDef* node) {
         output->push_back(node);
-        return !expand_scopes;
+        // Don't force bodies that haven't been loaded yet; nobody can have looked at their nodes.
+        return !expand_scopes || node->lazy_body;
     }
     virtual bool visit_generatorexp(AST_GeneratorExp* node) {
         output->push_back(node);
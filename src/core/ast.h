@@ -24,6 +24,7 @@
 #include "llvm/ADT/StringRef.h"
 
 #include "analysis/scoping_analysis.h"
+#include "core/arena.h"
 #include "core/common.h"
 #include "core/stringpool.h"
 
@@ -144,8 +145,11 @@ class ASTVisitor;
 class ExprVisitor;
 class StmtVisitor;
 class AST_keyword;
+class AST_Str;
 
-class AST {
+// AST nodes get allocated from the current arena (see core/arena.h): the parser puts each module's nodes into an
+// arena of their own, and the nodes that the CFG pass creates go into the arena of the ScopingAnalysis.
+class AST : public ArenaAllocated {
 public:
     virtual ~AST() {}
 
@@ -509,17 +513,41 @@ public:
     static const AST_TYPE::AST_TYPE TYPE = AST_TYPE::For;
 };
 
+// The body of a function that got loaded from the .pyc cache without deserializing its statements (see
+// parser.cpp).  The things we need to know when the function gets defined are available up front; the statements
+// get deserialized the first time someone asks for them, and every caller gets the same AST nodes.
+class LazyFunctionBody {
+public:
+    const bool contains_yield;
+    // The docstring, or NULL if the body doesn't start with one.
+    AST_Str* const docstring;
+
+    LazyFunctionBody(bool contains_yield, AST_Str* docstring) : contains_yield(contains_yield), docstring(docstring) {}
+    virtual ~LazyFunctionBody() {}
+
+    virtual const std::vector<AST_stmt*>& getBody() = 0;
+};
+
 class AST_FunctionDef : public AST_stmt {
 public:
+    // Empty while lazy_body is set; call ensureBody() before looking at it.
     std::vector<AST_stmt*> body;
     std::vector<AST_expr*> decorator_list;
     InternedString name;
     AST_arguments* args;
+    LazyFunctionBody* lazy_body;
+
+    void ensureBody() {
+        if (lazy_body) {
+            body = lazy_body->getBody();
+            lazy_body = NULL;
+        }
+    }
 
     virtual void accept(ASTVisitor* v);
     virtual void accept_stmt(StmtVisitor* v);
 
-    AST_FunctionDef() : AST_stmt(AST_TYPE::FunctionDef) {}
+    AST_FunctionDef() : AST_stmt(AST_TYPE::FunctionDef), lazy_body(NULL) {}
 
     static const AST_TYPE::AST_TYPE TYPE = AST_TYPE::FunctionDef;
 };
@@ -703,6 +731,10 @@ public:
     // different bytecodes.
     ScopeInfo::VarScopeType lookup_type;
 
+    // For FAST and CLOSURE names, the name's slot in the interpreter's array of locals (see
+    // ScopeInfo::getFastLocalSlot), cached the same way.  -1 if it hasn't been looked up yet.
+    int vreg;
+
     virtual void accept(ASTVisitor* v);
     virtual void* accept_expr(ExprVisitor* v);
 
@@ -710,7 +742,8 @@ public:
         : AST_expr(AST_TYPE::Name, lineno, col_offset),
           ctx_type(ctx_type),
           id(id),
-          lookup_type(ScopeInfo::VarScopeType::UNKNOWN) {}
+          lookup_type(ScopeInfo::VarScopeType::UNKNOWN),
+          vreg(-1) {}
 
     static const AST_TYPE::AST_TYPE TYPE = AST_TYPE::Name;
 };
@@ -1415,6 +1415,7 @@ public:
         def->col_offset = node->col_offset;
         def->name = node->name;
         def->body = node->body; // expensive vector copy
+        def->lazy_body = node->lazy_body;
 
         // Decorators are evaluated before bases:
         for (auto expr : node->decorator_list)
@@ -1438,6 +1439,7 @@ public:
         def->col_offset = node->col_offset;
         def->name = node->name;
         def->body = node->body; // expensive vector copy
+        def->lazy_body = node->lazy_body;
         // Decorators are evaluated before the defaults, so this *must* go before remapArguments().
         // TODO(rntz): do we have a test for this
         for (auto expr : node->decorator_list)
@@ -2462,6 +2464,10 @@ void CFG::print() {
 }
 
 CFG* computeCFG(SourceInfo* source, std::vector<AST_stmt*> body) {
+    // The CFG and the AST nodes that get created here go into the scoping analysis' arena, along with the scoping
+    // info: most functions' CFGs are a lot smaller than an arena slab.
+    ArenaScope _arena_scope(source->scoping->getArena());
+
     CFG* rtn = new CFG();
 
     ScopingAnalysis* scoping_analysis = source->scoping;
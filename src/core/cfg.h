@@ -29,6 +29,7 @@
 
 #include <vector>
 
+#include "core/arena.h"
 #include "core/ast.h"
 #include "core/common.h"
 #include "core/stringpool.h"
@@ -36,9 +37,8 @@
 namespace pyston {
 
 class AST_stmt;
-
 class CFG;
-class CFGBlock {
+class CFGBlock : public ArenaAllocated {
 private:
     CFG* cfg;
 
@@ -48,9 +48,13 @@ public:
     int idx; // index in the CFG
     const char* info;
 
+    // How many times the interpreter has entered this block, for deciding when to baseline-JIT it.  The code
+    // itself belongs to the CompiledFunction (see CompiledFunction::baseline_jit_code).
+    int times_entered;
+
     typedef std::vector<AST_stmt*>::iterator iterator;
 
-    CFGBlock(CFG* cfg, int idx) : cfg(cfg), idx(idx), info(NULL) {}
+    CFGBlock(CFG* cfg, int idx) : cfg(cfg), idx(idx), info(NULL), times_entered(0) {}
 
     void connectTo(CFGBlock* successor, bool allow_backedge = false);
     void unconnectFrom(CFGBlock* successor);
@@ -60,7 +64,7 @@ public:
 };
 
 // Control Flow Graph
-class CFG {
+class CFG : public ArenaAllocated {
 private:
     int next_idx;
 
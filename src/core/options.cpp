@@ -42,16 +42,21 @@ bool ENABLE_PYPA_PARSER = true;
 bool USE_REGALLOC_BASIC = true;
 bool PAUSE_AT_ABORT = false;
 bool ENABLE_TRACEBACKS = true;
+bool ENABLE_IC_TELEMETRY = false;
 
 int OSR_THRESHOLD_INTERPRETER = 500;
 int REOPT_THRESHOLD_INTERPRETER = 200;
+int BASELINEJIT_THRESHOLD = 50;
 int OSR_THRESHOLD_BASELINE = 10000;
 int REOPT_THRESHOLD_BASELINE = 250;
 int OSR_THRESHOLD_T2 = 10000;
 int REOPT_THRESHOLD_T2 = 10000;
 int SPECULATION_THRESHOLD = 100;
+bool LOG_TIERING_DECISIONS = false;
 
 int MAX_OBJECT_CACHE_ENTRIES = 500;
+int JIT_CODE_CACHE_LIMIT_KB = 0;
+int PREPARSE_THREADS = 0;
 
 static bool _GLOBAL_ENABLE = 1;
 bool ENABLE_ICS = 1 && _GLOBAL_ENABLE;
@@ -75,6 +80,13 @@ bool ENABLE_PYSTON_PASSES = 1 && _GLOBAL_ENABLE;
 bool ENABLE_TYPE_FEEDBACK = 1 && _GLOBAL_ENABLE;
 bool ENABLE_RUNTIME_ICS = 1 && _GLOBAL_ENABLE;
 bool ENABLE_JIT_OBJECT_CACHE = 1 && _GLOBAL_ENABLE;
+bool ENABLE_INLINE_ATTRS = 1 && _GLOBAL_ENABLE;
+bool ENABLE_BASELINEJIT = 1 && _GLOBAL_ENABLE;
+bool ENABLE_BYTECODE_INTERPRETER = 1 && _GLOBAL_ENABLE;
+bool ENABLE_DIRECT_CALLS = 1 && _GLOBAL_ENABLE;
+bool ENABLE_ADAPTIVE_TIERING = 1 && _GLOBAL_ENABLE;
+bool ENABLE_LAZY_FUNCTION_BODIES = 1 && _GLOBAL_ENABLE;
+bool ENABLE_IMPORT_DIRECTORY_CACHE = 1 && _GLOBAL_ENABLE;
 
 bool ENABLE_FRAME_INTROSPECTION = 1;
 bool BOOLS_AS_I64 = ENABLE_FRAME_INTROSPECTION;
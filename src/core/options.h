@@ -31,19 +31,26 @@ inline int version_hex(int major, int minor, int micro, int level = 0, int seria
 
 extern int MAX_OPT_ITERATIONS;
 
-extern int OSR_THRESHOLD_INTERPRETER, REOPT_THRESHOLD_INTERPRETER;
+extern int OSR_THRESHOLD_INTERPRETER, REOPT_THRESHOLD_INTERPRETER, BASELINEJIT_THRESHOLD;
 extern int OSR_THRESHOLD_BASELINE, REOPT_THRESHOLD_BASELINE;
 extern int OSR_THRESHOLD_T2, REOPT_THRESHOLD_T2;
 extern int SPECULATION_THRESHOLD;
 extern int MAX_OBJECT_CACHE_ENTRIES;
+// Evict compiled versions (oldest first) once JIT'd code uses more than this; 0 means no limit.
+extern int JIT_CODE_CACHE_LIMIT_KB;
+// Parse the other modules of a package on this many background threads when the package gets imported.
+extern int PREPARSE_THREADS;
 
 extern bool SHOW_DISASM, FORCE_INTERPRETER, FORCE_OPTIMIZE, PROFILE, DUMPJIT, TRAP, USE_STRIPPED_STDLIB,
-    CONTINUE_AFTER_FATAL, ENABLE_INTERPRETER, ENABLE_PYPA_PARSER, USE_REGALLOC_BASIC, PAUSE_AT_ABORT, ENABLE_TRACEBACKS;
+    CONTINUE_AFTER_FATAL, ENABLE_INTERPRETER, ENABLE_PYPA_PARSER, USE_REGALLOC_BASIC, PAUSE_AT_ABORT, ENABLE_TRACEBACKS,
+    ENABLE_IC_TELEMETRY, LOG_TIERING_DECISIONS;
 
 extern bool ENABLE_ICS, ENABLE_ICGENERICS, ENABLE_ICGETITEMS, ENABLE_ICSETITEMS, ENABLE_ICDELITEMS, ENABLE_ICBINEXPS,
     ENABLE_ICNONZEROS, ENABLE_ICCALLSITES, ENABLE_ICSETATTRS, ENABLE_ICGETATTRS, ENALBE_ICDELATTRS, ENABLE_ICGETGLOBALS,
     ENABLE_SPECULATION, ENABLE_OSR, ENABLE_LLVMOPTS, ENABLE_INLINING, ENABLE_REOPT, ENABLE_PYSTON_PASSES,
-    ENABLE_TYPE_FEEDBACK, ENABLE_FRAME_INTROSPECTION, ENABLE_RUNTIME_ICS, ENABLE_JIT_OBJECT_CACHE;
+    ENABLE_TYPE_FEEDBACK, ENABLE_FRAME_INTROSPECTION, ENABLE_RUNTIME_ICS, ENABLE_JIT_OBJECT_CACHE, ENABLE_INLINE_ATTRS,
+    ENABLE_BASELINEJIT, ENABLE_BYTECODE_INTERPRETER, ENABLE_DIRECT_CALLS, ENABLE_ADAPTIVE_TIERING,
+    ENABLE_LAZY_FUNCTION_BODIES, ENABLE_IMPORT_DIRECTORY_CACHE;
 
 // Due to a temporary LLVM limitation, represent bools as i64's instead of i1's.
 extern bool BOOLS_AS_I64;
@@ -22,6 +22,7 @@
 #include "llvm/ADT/DenseMapInfo.h"
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
 
 #include "core/common.h"
 
@@ -94,13 +95,10 @@ private:
     // which I assume forces extra allocations.
     // (We could define a custom string-pointer container but is it worth it?)
     std::unordered_map<llvm::StringRef, std::string*> interned;
+    // The strings get destroyed along with the pool:
+    llvm::SpecificBumpPtrAllocator<std::string> allocator;
 
 public:
-    ~InternedStringPool() {
-        for (auto& p : interned) {
-            delete p.second;
-        }
-    }
 
     template <class T> InternedString get(T&& arg) {
         auto it = interned.find(llvm::StringRef(arg));
@@ -109,7 +107,7 @@ public:
         if (it != interned.end()) {
             s = it->second;
         } else {
-            s = new std::string(std::forward<T>(arg));
+            s = new (allocator.Allocate()) std::string(std::forward<T>(arg));
             interned.insert(it, std::make_pair(llvm::StringRef(*s), s));
         }
 
@@ -126,20 +126,25 @@ class BoxedFunctionBase;
 class ICGetattr;
 struct ICSlotInfo;
 
+class BytecodeFunction;
 class CFG;
 class AST;
 class AST_FunctionDef;
 class AST_arguments;
 class AST_expr;
 class AST_stmt;
+class LazyFunctionBody;
 
 class PhiAnalysis;
 class LivenessAnalysis;
 class ScopingAnalysis;
+class TypeAnalysisCache;
 
 class CLFunction;
 class OSREntryDescriptor;
 
+// Each dependent slot also points back to the invalidator (see ICSlotInfo::invalidators), so that whichever of the
+// two goes away first can unlink itself from the other.
 class ICInvalidator {
 private:
     int64_t cur_version;
@@ -147,8 +152,12 @@ private:
 
 public:
     ICInvalidator() : cur_version(0) {}
+    ~ICInvalidator();
+    ICInvalidator(const ICInvalidator&) = delete;
+    void operator=(const ICInvalidator&) = delete;
 
     void addDependent(ICSlotInfo* icentry);
+    void removeDependent(ICSlotInfo* icentry);
     int64_t version();
     void invalidateAll();
 };
@@ -168,6 +177,7 @@ struct FunctionSpecialization {
 class BoxedClosure;
 class BoxedGenerator;
 class ICInfo;
+class JitCodeBlock;
 class LocationMap;
 
 struct CompiledFunction {
@@ -192,12 +202,31 @@ public:
     EffortLevel effort;
 
     int64_t times_called, times_speculation_failed;
+    // Only counted by the interpreter.
+    int64_t times_backedges;
+    // Set by the tiering policy when they're first needed (see codegen/tiering.h); 0 if not computed yet.
+    int64_t reopt_threshold, osr_threshold;
+
+    // The number of stack frames that are currently executing this version's code, like ICSlotInfo::num_inside.
+    // It's updated atomically, and frames decrement it whether they return or get unwound by an exception.
+    int64_t num_inside;
+    // How much memory the memory manager mapped for this version's code and data sections.
+    int64_t code_memory_bytes;
+    // Set if the address of this version's code got embedded somewhere that we can't invalidate (ex: direct calls
+    // from other JIT'd code), in which case the code never gets freed.
+    bool pinned;
+    // Set once the version got retired (see codegen/code_cache.h); no new baseline JIT code gets added to it then.
+    bool retired;
     ICInvalidator dependent_callsites;
 
     LocationMap* location_map; // only meaningful if this is a compiled frame
 
     std::vector<ICInfo*> ics;
 
+    // The baseline JIT code for the CFG blocks that the interpreter has run often enough while executing this
+    // version, indexed by CFGBlock::idx.  Owned by the code cache, which frees it along with the version's code.
+    std::vector<JitCodeBlock*> baseline_jit_code;
+
     CompiledFunction(llvm::Function* func, FunctionSpecialization* spec, bool is_interpreted, void* code,
                      EffortLevel effort, const OSREntryDescriptor* entry_descriptor)
         : clfunc(NULL),
@@ -209,6 +238,13 @@ public:
           effort(effort),
           times_called(0),
           times_speculation_failed(0),
+          times_backedges(0),
+          reopt_threshold(0),
+          osr_threshold(0),
+          num_inside(0),
+          code_memory_bytes(0),
+          pinned(false),
+          retired(false),
           location_map(nullptr) {
         assert((spec != NULL) + (entry_descriptor != NULL) == 1);
     }
@@ -218,7 +254,7 @@ public:
     // TODO this will need to be implemented eventually; things to delete:
     // - line_table if it exists
     // - location_map if it exists
-    // - all entries in ics (after deregistering them)
+    // - all entries in ics
     ~CompiledFunction();
 
     // Call this when a speculation inside this version failed
@@ -251,16 +287,25 @@ public:
     ScopingAnalysis* scoping;
     AST* ast;
     CFG* cfg;
+    // The interpreter's lowering of the cfg; see codegen/bytecode.h.
+    BytecodeFunction* bytecode;
     bool is_generator;
     std::string fn; // equivalent of code.co_filename
 
+    // Analysis results that get reused by every (re)compile of this function, whatever the effort level: the
+    // liveness and function-entry phi analyses only depend on the CFG and the parameters, and the type analysis
+    // remembers what it computed for each block; see getLivenessInfo() and doTypeAnalysis().
+    std::unique_ptr<LivenessAnalysis> liveness;
+    std::unique_ptr<PhiAnalysis> phis;
+    std::unique_ptr<TypeAnalysisCache> type_analysis_cache;
+
     InternedStringPool& getInternedStrings();
 
     ScopeInfo* getScopeInfo();
 
-    // TODO we're currently copying the body of the AST into here, since lambdas don't really have a statement-based
-    // body and we have to create one.  Ideally, we'd be able to avoid the space duplication for non-lambdas.
-    const std::vector<AST_stmt*> body;
+    // The statements of the function; for a function whose body got loaded lazily from the .pyc cache, this is
+    // what deserializes it.
+    const std::vector<AST_stmt*>& getBody();
 
     const std::string getName();
     InternedString mangleName(InternedString id);
@@ -268,6 +313,13 @@ public:
     Box* getDocString();
 
     SourceInfo(BoxedModule* m, ScopingAnalysis* scoping, AST* ast, std::vector<AST_stmt*> body, std::string fn);
+    ~SourceInfo();
+
+private:
+    // TODO we're currently copying the body of the AST into here, since lambdas don't really have a statement-based
+    // body and we have to create one.  Ideally, we'd be able to avoid the space duplication for non-lambdas.
+    std::vector<AST_stmt*> body;
+    LazyFunctionBody* lazy_body;
 };
 
 typedef std::vector<CompiledFunction*> FunctionList;
@@ -461,6 +513,10 @@ private:
     // Appends a new value to the hcattrs array.
     void appendNewHCAttr(Box* val, SetattrRewriteArgs* rewrite_args);
 
+    // Moves the attributes out of the inline slots and into a separately-allocated attribute array,
+    // for when they no longer fit.  Returns the object's new hidden class.
+    HiddenClass* spillInlineHCAttrs();
+
 public:
     // Add a no-op constructor to make sure that we don't zero-initialize cls
     Box() {}
@@ -18,7 +18,9 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <pthread.h>
 #include <string>
+#include <unistd.h>
 
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/FormattedStream.h"
@@ -148,4 +150,10 @@ void removeDirectoryIfExists(const std::string& path) {
     code = llvm::sys::fs::remove(path, false);
     assert(!code);
 }
+
+std::string tempFileName(const std::string& fn) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), ".%d.%lx.tmp", getpid(), (unsigned long)pthread_self());
+    return fn + buf;
+}
 }
@@ -61,6 +61,10 @@ bool endswith(const std::string& s, const std::string& pattern);
 
 void removeDirectoryIfExists(const std::string& path);
 
+// A name to write the new contents of fn to before renaming it into place; unique to the calling thread, so that
+// concurrent writers of the same file don't write into each other's temporary file.
+std::string tempFileName(const std::string& fn);
+
 // Checks that lhs and rhs, which are iterables of InternedStrings, have the
 // same set of names in them.
 template <class T1, class T2> bool sameKeyset(T1* lhs, T2* rhs) {
@@ -18,7 +18,6 @@
 #include <cstdio>
 #include <cstdlib>
 
-#include "codegen/ast_interpreter.h"
 #include "codegen/codegen.h"
 #include "core/common.h"
 #include "core/threading.h"
@@ -252,7 +251,6 @@ void markPhase() {
     GCVisitor visitor(&stack);
 
     threading::visitAllStacks(&visitor);
-    gatherInterpreterRoots(&visitor);
 
     for (void* p : nonheap_roots) {
         Box* b = reinterpret_cast<Box*>(p);
@@ -170,6 +170,12 @@ bool _doFree(GCAllocation* al, std::list<Box*, StlCompatAllocator<Box*>>* weakly
         ASSERT(b->cls->tp_dealloc == NULL, "%s", getTypeName(b));
         if (b->cls->simple_destructor)
             b->cls->simple_destructor(b);
+    } else if (alloc_kind == GCKind::HIDDEN_CLASS) {
+        // ICs that guard on this hidden class mustn't match whatever gets allocated here next, and the ICs
+        // point back at the invalidator:
+        HiddenClass* hcls = (HiddenClass*)al->user_data;
+        hcls->dependent_getattrs.invalidateAll();
+        hcls->dependent_getattrs.~ICInvalidator();
     }
     return true;
 }
@@ -181,6 +181,8 @@ int handleArg(char code) {
         ENABLE_TRACEBACKS = false;
     } else if (code == 'G') {
         enableGdbSegfaultWatcher();
+    } else if (code == 'C') {
+        ENABLE_IC_TELEMETRY = true;
     } else {
         fprintf(stderr, "Unknown option: -%c\n", code);
         return 2;
@@ -255,7 +257,7 @@ static int main(int argc, char** argv) {
 
         // Suppress getopt errors so we can throw them ourselves
         opterr = 0;
-        while ((code = getopt(argc, argv, "+:OqdIibpjtrsSvnxEc:FuPTGm:")) != -1) {
+        while ((code = getopt(argc, argv, "+:OqdIibpjtrsSvnxEc:FuPTGCm:")) != -1) {
             if (code == 'c') {
                 assert(optarg);
                 command = optarg;
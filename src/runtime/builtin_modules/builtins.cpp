@@ -221,12 +221,16 @@ extern "C" Box* sum(Box* container, Box* initial) {
     if (initial->cls == str_cls)
         raiseExcHelper(TypeError, "sum() can't sum strings [use ''.join(seq) instead]");
 
-    static RuntimeICCache<BinopIC, 3> runtime_ic_cache;
-    std::shared_ptr<BinopIC> pp = runtime_ic_cache.getIC(__builtin_return_address(0));
+    static RuntimeICCache<BinopIC, 16> runtime_ic_cache;
 
     Box* cur = initial;
     for (Box* e : container->pyElements()) {
-        cur = pp->call(cur, e, AST_TYPE::Add);
+        // The additions can call back into sum(), which could replace our IC, so look it up each time:
+        BinopIC* pp = runtime_ic_cache.getIC(__builtin_return_address(0));
+        if (pp)
+            cur = pp->call(cur, e, AST_TYPE::Add);
+        else
+            cur = binop(cur, e, AST_TYPE::Add);
     }
     return cur;
 }
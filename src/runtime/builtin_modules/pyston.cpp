@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "asm_writing/icinfo.h"
 #include "core/types.h"
 #include "runtime/objmodel.h"
 #include "runtime/types.h"
@@ -40,9 +41,21 @@ static Box* setOption(Box* option, Box* value) {
     else CHECK(FORCE_INTERPRETER);
     else CHECK(REOPT_THRESHOLD_INTERPRETER);
     else CHECK(OSR_THRESHOLD_INTERPRETER);
+    else CHECK(ENABLE_BASELINEJIT);
+    else CHECK(BASELINEJIT_THRESHOLD);
+    else CHECK(ENABLE_BYTECODE_INTERPRETER);
     else CHECK(REOPT_THRESHOLD_BASELINE);
+    else CHECK(REOPT_THRESHOLD_T2);
     else CHECK(OSR_THRESHOLD_BASELINE);
     else CHECK(SPECULATION_THRESHOLD);
+    else CHECK(ENABLE_DIRECT_CALLS);
+    else CHECK(ENABLE_ADAPTIVE_TIERING);
+    else CHECK(LOG_TIERING_DECISIONS);
+    else CHECK(JIT_CODE_CACHE_LIMIT_KB);
+    else CHECK(ENABLE_IC_TELEMETRY);
+    else CHECK(ENABLE_LAZY_FUNCTION_BODIES);
+    else CHECK(PREPARSE_THREADS);
+    else CHECK(ENABLE_IMPORT_DIRECTORY_CACHE);
     else raiseExcHelper(ValueError, "unknown option name '%s", option_string->s.data());
 
     return None;
@@ -61,6 +74,13 @@ static Box* dumpStats(Box* includeZeros) {
     return None;
 }
 
+static Box* dumpICStatsBuiltin(Box* minMisses) {
+    if (minMisses->cls != int_cls)
+        raiseExcHelper(TypeError, "minMisses must be a 'int' object but received a '%s'", getTypeName(minMisses));
+    dumpICStats(((BoxedInt*)minMisses)->n);
+    return None;
+}
+
 void setupPyston() {
     pyston_module = createModule("__pyston__");
 
@@ -72,5 +92,8 @@ void setupPyston() {
     pyston_module->giveAttr("dumpStats",
                             new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)dumpStats, NONE, 1, 1, false, false),
                                                              "dumpStats", { False }));
+    pyston_module->giveAttr("dumpICStats", new BoxedBuiltinFunctionOrMethod(
+                                               boxRTFunction((void*)dumpICStatsBuiltin, NONE, 1, 1, false, false),
+                                               "dumpICStats", { boxInt(0) }));
 }
 }
@@ -28,6 +28,7 @@
 #include "core/types.h"
 #include "runtime/classobj.h"
 #include "runtime/file.h"
+#include "runtime/ics.h"
 #include "runtime/import.h"
 #include "runtime/objmodel.h"
 #include "runtime/rewrite_args.h"
@@ -250,7 +251,14 @@ extern "C" PyObject* PyObject_GetAttr(PyObject* o, PyObject* attr_name) noexcept
     }
 
     try {
-        return getattr(o, static_cast<BoxedString*>(attr_name)->data());
+        // Extension modules tend to look up the same few attributes over and over, so give each call site its own
+        // IC per attribute name:
+        static RuntimeICCache<GetattrIC, 256, std::string> runtime_ic_cache;
+        llvm::StringRef attr = static_cast<BoxedString*>(attr_name)->s;
+        GetattrIC* ic = runtime_ic_cache.getIC(__builtin_return_address(0), attr);
+        if (ic)
+            return ic->call(o);
+        return getattr(o, attr.data());
     } catch (ExcInfo e) {
         setCAPIException(e);
         return NULL;
@@ -284,6 +292,10 @@ extern "C" int _PyObject_GenericSetAttrWithDict(PyObject* obj, PyObject* name, P
 
 extern "C" PyObject* PyObject_GetItem(PyObject* o, PyObject* key) noexcept {
     try {
+        static RuntimeICCache<GetitemIC, 128> runtime_ic_cache;
+        GetitemIC* ic = runtime_ic_cache.getIC(__builtin_return_address(0));
+        if (ic)
+            return ic->call(o, key);
         return getitem(o, key);
     } catch (ExcInfo e) {
         setCAPIException(e);
@@ -293,7 +305,12 @@ extern "C" PyObject* PyObject_GetItem(PyObject* o, PyObject* key) noexcept {
 
 extern "C" int PyObject_SetItem(PyObject* o, PyObject* key, PyObject* v) noexcept {
     try {
-        setitem(o, key, v);
+        static RuntimeICCache<SetitemIC, 128> runtime_ic_cache;
+        SetitemIC* ic = runtime_ic_cache.getIC(__builtin_return_address(0));
+        if (ic)
+            ic->call(o, key, v);
+        else
+            setitem(o, key, v);
         return 0;
     } catch (ExcInfo e) {
         setCAPIException(e);
@@ -310,7 +327,7 @@ extern "C" long PyObject_Hash(PyObject* o) noexcept {
     try {
         return hash(o)->n;
     } catch (ExcInfo e) {
-        fatalOrError(PyExc_NotImplementedError, "unimplemented");
+        setCAPIException(e);
         return -1;
     }
 }
@@ -180,7 +180,7 @@ EHFrameManager::~EHFrameManager() {
 #define SCRATCH_BYTES 0x30
 #endif
 
-RuntimeIC::RuntimeIC(void* func_addr, int num_slots, int slot_size) {
+RuntimeIC::RuntimeIC(void* func_addr, int num_slots, int slot_size) : code_size(0), num_inside(0) {
     static StatCounter sc("runtime_ics_num");
     sc.log();
 
@@ -223,6 +223,7 @@ RuntimeIC::RuntimeIC(void* func_addr, int num_slots, int slot_size) {
         int patchable_size = num_slots * slot_size;
         int total_size = PROLOGUE_SIZE + patchable_size + CALL_SIZE + EPILOGUE_SIZE;
         addr = malloc(total_size);
+        code_size = total_size;
 
         // printf("Allocated runtime IC at %p\n", addr);
 
@@ -15,7 +15,14 @@
 #ifndef PYSTON_RUNTIME_ICS_H
 #define PYSTON_RUNTIME_ICS_H
 
+#include <memory>
+#include <string>
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringRef.h"
+
 #include "core/common.h"
+#include "core/stats.h"
 #include "runtime/objmodel.h"
 
 namespace pyston {
@@ -35,32 +42,51 @@ public:
 class RuntimeIC {
 private:
     void* addr;
+    int code_size;
     EHFrameManager eh_frame;
 
     std::unique_ptr<ICInfo> icinfo;
 
+    // The number of calls that are currently running inside this IC; it can't be freed while there are any.
+    int num_inside;
+
+    struct InsideIC {
+        RuntimeIC* ic;
+        InsideIC(RuntimeIC* ic) : ic(ic) { ic->num_inside++; }
+        ~InsideIC() { ic->num_inside--; }
+    };
+
     RuntimeIC(const RuntimeIC&) = delete;
     void operator=(const RuntimeIC&) = delete;
 
 protected:
     RuntimeIC(void* addr, int num_slots, int slot_size);
-    ~RuntimeIC();
 
     template <class... Args> uint64_t call_int(Args... args) {
+        InsideIC _inside(this);
         return reinterpret_cast<uint64_t (*)(Args...)>(this->addr)(args...);
     }
 
     template <class... Args> bool call_bool(Args... args) {
+        InsideIC _inside(this);
         return reinterpret_cast<bool (*)(Args...)>(this->addr)(args...);
     }
 
     template <class... Args> void* call_ptr(Args... args) {
+        InsideIC _inside(this);
         return reinterpret_cast<void* (*)(Args...)>(this->addr)(args...);
     }
 
     template <class... Args> double call_double(Args... args) {
+        InsideIC _inside(this);
         return reinterpret_cast<double (*)(Args...)>(this->addr)(args...);
     }
+
+public:
+    virtual ~RuntimeIC();
+
+    bool isInUse() const { return num_inside > 0; }
+    int getCodeSize() const { return code_size; }
 };
 
 class CallattrIC : public RuntimeIC {
@@ -87,53 +113,162 @@ public:
     bool call(Box* obj) { return call_bool(obj); }
 };
 
-template <class ICType, unsigned cache_size> class RuntimeICCache {
+class GetattrIC : public RuntimeIC {
+private:
+    // The rewrites that getattr() makes assume that the attribute name is fixed for the call site, so each IC is
+    // bound to a single name, which it keeps a copy of and always passes the same pointer for.
+    const std::string attr;
+
+public:
+    GetattrIC(llvm::StringRef attr) : RuntimeIC((void*)getattr, 2, 256), attr(attr.str()) {}
+
+    Box* call(Box* obj) { return (Box*)call_ptr(obj, attr.c_str()); }
+};
+
+class SetattrIC : public RuntimeIC {
+private:
+    const std::string attr; // see GetattrIC
+
+public:
+    SetattrIC(llvm::StringRef attr) : RuntimeIC((void*)setattr, 2, 256), attr(attr.str()) {}
+
+    void call(Box* obj, Box* attr_val) { call_ptr(obj, attr.c_str(), attr_val); }
+};
+
+class GetitemIC : public RuntimeIC {
+public:
+    GetitemIC() : RuntimeIC((void*)getitem, 2, 160) {}
+
+    Box* call(Box* value, Box* slice) { return (Box*)call_ptr(value, slice); }
+};
+
+class SetitemIC : public RuntimeIC {
+public:
+    SetitemIC() : RuntimeIC((void*)setitem, 2, 160) {}
+
+    void call(Box* target, Box* slice, Box* value) { call_ptr(target, slice, value); }
+};
+
+class CompareIC : public RuntimeIC {
 private:
+    int op_type;
+
+public:
+    CompareIC(int op_type) : RuntimeIC((void*)compare, 2, 160), op_type(op_type) {}
+
+    Box* call(Box* lhs, Box* rhs) { return (Box*)call_ptr(lhs, rhs, op_type); }
+};
+
+// Key type for caches of ICs that don't need anything beyond the caller address to tell them apart.
+struct NoICKey {
+    bool operator==(const NoICKey&) const { return true; }
+};
+
+inline uintptr_t hashICKey(const NoICKey&) {
+    return 0;
+}
+inline uintptr_t hashICKey(llvm::StringRef key) {
+    return llvm::hash_value(key);
+}
+
+template <class ICType> ICType* createRuntimeIC(const NoICKey&) {
+    return new ICType();
+}
+template <class ICType, class Key> ICType* createRuntimeIC(const Key& key) {
+    return new ICType(key);
+}
+
+// Maps call sites (and optionally an extra key, such as the attribute name) to their own runtime IC.
+//
+// A lookup only probes a few entries, starting from one picked by the caller address and key.  If none of them
+// match, one of them gets replaced, picked with the clock algorithm: entries that got hit since the hand last
+// passed them get a second chance.  The replaced IC gets freed, except that ICs that are being run (ex by a call
+// further up the stack) can't be replaced.
+//
+// A call site and key that miss only get an entry without an IC at first; the IC gets created if they come back
+// while that entry is still there.  That way keys that only get seen once (ex attribute names that are computed
+// at runtime) don't make us generate and free code for each of them.
+//
+// getIC() returns NULL when there's no IC (yet), in which case the caller should call the slowpath directly.
+// Callers shouldn't hold on to the IC across anything that might look up another one, since it could get
+// replaced then.
+template <class ICType, unsigned cache_size, class Key = NoICKey> class RuntimeICCache {
+private:
+    static const unsigned NUM_PROBES = 4;
+
     struct PerCallerIC {
         void* caller_addr;
-        std::shared_ptr<ICType> ic;
+        Key key;
+        std::unique_ptr<ICType> ic;
+        bool referenced;
     };
     PerCallerIC ics[cache_size];
-    unsigned next_to_replace;
 
     RuntimeICCache(const RuntimeICCache&) = delete;
     void operator=(const RuntimeICCache&) = delete;
 
-    PerCallerIC* findBestSlotToReplace() {
-        // search for an unassigned slot
+public:
+    RuntimeICCache() {
         for (unsigned i = 0; i < cache_size; ++i) {
-            if (!ics[i].caller_addr)
-                return &ics[i];
+            ics[i].caller_addr = 0;
+            ics[i].referenced = false;
         }
-
-        PerCallerIC* ic = &ics[next_to_replace];
-        ++next_to_replace;
-        if (next_to_replace >= cache_size)
-            next_to_replace = 0;
-        return ic;
     }
 
-public:
-    RuntimeICCache() : next_to_replace(0) {
-        for (unsigned i = 0; i < cache_size; ++i)
-            ics[i].caller_addr = 0;
-    }
+    ICType* getIC(void* caller_addr) { return getIC(caller_addr, Key()); }
 
-    std::shared_ptr<ICType> getIC(void* caller_addr) {
+    template <class LookupKey> ICType* getIC(void* caller_addr, const LookupKey& key) {
         assert(caller_addr);
 
-        // try to find a cached IC for the caller
-        for (unsigned i = 0; i < cache_size; ++i) {
-            if (ics[i].caller_addr == caller_addr)
-                return ics[i].ic;
+        unsigned start = (unsigned)((((uintptr_t)caller_addr >> 4) ^ hashICKey(key)) % cache_size);
+        PerCallerIC* empty = NULL;
+        for (unsigned probe = 0; probe < NUM_PROBES; ++probe) {
+            PerCallerIC& entry = ics[(start + probe) % cache_size];
+            if (!entry.caller_addr) {
+                if (!empty)
+                    empty = &entry;
+                continue;
+            }
+            if (entry.caller_addr == caller_addr && entry.key == key) {
+                if (!entry.ic) {
+                    static StatCounter num_created("runtime_ic_cache_ics_created");
+                    num_created.log();
+                    entry.ic.reset(createRuntimeIC<ICType>(entry.key));
+                }
+                entry.referenced = true;
+                return entry.ic.get();
+            }
+        }
+
+        // Two sweeps, since the first one might only clear the referenced bits:
+        PerCallerIC* victim = empty;
+        for (unsigned probe = 0; !victim && probe < 2 * NUM_PROBES; ++probe) {
+            PerCallerIC& entry = ics[(start + probe % NUM_PROBES) % cache_size];
+            if (entry.ic && entry.ic->isInUse())
+                continue;
+            if (entry.referenced) {
+                entry.referenced = false;
+                continue;
+            }
+            victim = &entry;
+        }
+
+        if (!victim) {
+            static StatCounter num_in_use("runtime_ic_cache_all_in_use");
+            num_in_use.log();
+            return NULL;
+        }
+
+        if (victim->caller_addr) {
+            static StatCounter num_replaced("runtime_ic_cache_replacements");
+            num_replaced.log();
         }
 
-        // could not find a cached runtime IC, create new one and save it
-        PerCallerIC* slot_to_replace = findBestSlotToReplace();
-        std::shared_ptr<ICType> ic = std::make_shared<ICType>();
-        slot_to_replace->caller_addr = caller_addr;
-        slot_to_replace->ic = ic;
-        return ic;
+        victim->caller_addr = caller_addr;
+        victim->key = key;
+        victim->referenced = false;
+        victim->ic.reset();
+        return NULL;
     }
 };
 
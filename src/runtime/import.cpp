@@ -14,7 +14,12 @@
 
 #include "runtime/import.h"
 
+#include <dirent.h>
 #include <limits.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
@@ -22,6 +27,8 @@
 #include "codegen/irgen/hooks.h"
 #include "codegen/parser.h"
 #include "codegen/unwinding.h"
+#include "core/options.h"
+#include "core/stats.h"
 #include "runtime/capi.h"
 #include "runtime/objmodel.h"
 
@@ -39,10 +46,23 @@ static void removeModule(const std::string& name) {
     d->d.erase(b_name);
 }
 
+// Takes the module's AST out of the module bundle if it's there, and otherwise parses its source.
+static AST_Module* parseModule(const std::string& name, const std::string& fn, bool is_package,
+                               bool* from_bundle = NULL) {
+    AST_Module* ast = parseFromModuleBundle(name, fn);
+    if (from_bundle)
+        *from_bundle = (ast != NULL);
+    if (ast)
+        return ast;
+
+    noteModuleForBundle(name, fn, is_package);
+    return caching_parse_file(fn.c_str());
+}
+
 Box* createAndRunModule(const std::string& name, const std::string& fn) {
     BoxedModule* module = createModule(name, fn.c_str());
 
-    AST_Module* ast = caching_parse_file(fn.c_str());
+    AST_Module* ast = parseModule(name, fn, false);
     try {
         compileAndRunModule(ast, module);
     } catch (ExcInfo e) {
@@ -66,7 +86,11 @@ static Box* createAndRunModule(const std::string& name, const std::string& fn, c
 
     module->setattr(path_str, path_list, NULL);
 
-    AST_Module* ast = caching_parse_file(fn.c_str());
+    bool from_bundle;
+    AST_Module* ast = parseModule(name, fn, true, &from_bundle);
+    // Running __init__ usually imports the package's modules:
+    if (!from_bundle)
+        preparsePackage(module_path);
     try {
         compileAndRunModule(ast, module);
     } catch (ExcInfo e) {
@@ -97,6 +121,75 @@ static bool pathExists(const std::string& path) {
     return exists;
 }
 
+// Every import looks for the module in each sys.path directory, so rather than stat()ing each candidate file, we
+// read each directory once and look the names up in its listing.  A listing stays valid as long as the directory's
+// mtime doesn't change.  Files can get added without changing the mtime if that happens within the timestamp's
+// granularity, so listings of directories that got modified very recently get read again on the next import.
+namespace {
+struct DirectoryListing {
+    struct timespec mtime;
+    bool stable;
+    std::unordered_set<std::string> names;
+};
+
+// Looks names up in one directory for one findModule call: the directory gets stat()ed (and read, if its listing
+// isn't cached) once, however many candidate names get looked up in it.
+class DirectoryLookup {
+private:
+    std::string dir;
+    // NULL if the directory doesn't exist, or if ENABLE_IMPORT_DIRECTORY_CACHE is off:
+    const DirectoryListing* listing;
+
+    static const DirectoryListing* getListing(const std::string& dir);
+
+public:
+    DirectoryLookup(llvm::StringRef dir) : dir(dir.empty() ? "." : dir.str()), listing(NULL) {
+        if (ENABLE_IMPORT_DIRECTORY_CACHE)
+            listing = getListing(this->dir);
+    }
+
+    bool contains(const std::string& name) const {
+        if (!ENABLE_IMPORT_DIRECTORY_CACHE) {
+            llvm::SmallString<128> path;
+            llvm::sys::path::append(path, dir, name);
+            return pathExists(path.str());
+        }
+        return listing && listing->names.count(name);
+    }
+};
+}
+static std::unordered_map<std::string, DirectoryListing> directory_listings;
+
+const DirectoryListing* DirectoryLookup::getListing(const std::string& dir) {
+    struct stat dir_stat;
+    if (stat(dir.c_str(), &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode))
+        return NULL;
+
+    auto it = directory_listings.find(dir);
+    if (it != directory_listings.end() && it->second.stable && it->second.mtime.tv_sec == dir_stat.st_mtim.tv_sec
+        && it->second.mtime.tv_nsec == dir_stat.st_mtim.tv_nsec) {
+        static StatCounter num_hits("num_import_directory_cache_hits");
+        num_hits.log();
+        return &it->second;
+    }
+
+    static StatCounter num_reads("num_import_directory_reads");
+    num_reads.log();
+
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+        return NULL;
+
+    DirectoryListing& listing = directory_listings[dir];
+    listing.mtime = dir_stat.st_mtim;
+    listing.stable = time(NULL) - dir_stat.st_mtime >= 2;
+    listing.names.clear();
+    while (struct dirent* entry = readdir(d))
+        listing.names.insert(entry->d_name);
+    closedir(d);
+    return &listing;
+}
+
 /* Return an importer object for a sys.path/pkg.__path__ item 'p',
    possibly by fetching it from the path_importer_cache dict. If it
    wasn't yet cached, traverse path_hooks until a hook is found
@@ -219,18 +312,12 @@ SearchResult findModule(const std::string& name, const std::string& full_name, B
             continue;
         BoxedString* p = static_cast<BoxedString*>(_p);
 
-        joined_path.clear();
-        llvm::sys::path::append(joined_path, std::string(p->s), name);
-        std::string dn(joined_path.str());
-
-        llvm::sys::path::append(joined_path, "__init__.py");
-        std::string fn(joined_path.str());
-
         PyObject* importer = get_path_importer(path_importer_cache, path_hooks, _p);
         if (importer == NULL)
             return SearchResult("", SearchResult::SEARCH_ERROR);
 
-        if (importer != None) {
+        // The default importer for non-directories never finds anything, so don't bother calling it:
+        if (importer != None && importer->cls != null_importer_cls) {
             auto path_pass = path_list ? path_list : None;
             Box* loader = callattr(importer, &find_module_str,
                                    CallattrFlags({.cls_only = false, .null_on_nonexistent = false }), ArgPassSpec(2),
@@ -239,25 +326,43 @@ SearchResult findModule(const std::string& name, const std::string& full_name, B
                 return SearchResult(loader);
         }
 
-        if (pathExists(fn))
-            return SearchResult(std::move(dn), SearchResult::PKG_DIRECTORY);
+        llvm::StringRef dir(p->s);
+        DirectoryLookup lookup(dir);
 
         joined_path.clear();
-        llvm::sys::path::append(joined_path, std::string(p->s), name + ".py");
-        fn = joined_path.str();
+        llvm::sys::path::append(joined_path, dir, name);
+        if (lookup.contains(name) && DirectoryLookup(joined_path.str()).contains("__init__.py"))
+            return SearchResult(joined_path.str().str(), SearchResult::PKG_DIRECTORY);
+
+        std::string fn = name + ".py";
+        if (lookup.contains(fn)) {
+            joined_path.clear();
+            llvm::sys::path::append(joined_path, dir, fn);
+            return SearchResult(joined_path.str().str(), SearchResult::PY_SOURCE);
+        }
 
-        if (pathExists(fn))
-            return SearchResult(std::move(fn), SearchResult::PY_SOURCE);
+        fn = name + ".pyston.so";
+        if (lookup.contains(fn)) {
+            joined_path.clear();
+            llvm::sys::path::append(joined_path, dir, fn);
+            return SearchResult(joined_path.str().str(), SearchResult::C_EXTENSION);
+        }
+    }
 
-        joined_path.clear();
-        llvm::sys::path::append(joined_path, p->s, name + ".pyston.so");
-        fn = joined_path.str();
+    return SearchResult("", SearchResult::SEARCH_ERROR);
+}
 
-        if (pathExists(fn))
-            return SearchResult(std::move(fn), SearchResult::C_EXTENSION);
+// Modules that are in the module bundle don't have to be looked for on disk.
+static SearchResult findModuleOrBundled(const std::string& name, const std::string& full_name, BoxedList* path_list) {
+    std::string fn;
+    bool is_package;
+    if (findInModuleBundle(full_name, &fn, &is_package)) {
+        if (is_package)
+            return SearchResult(llvm::sys::path::parent_path(fn).str(), SearchResult::PKG_DIRECTORY);
+        return SearchResult(std::move(fn), SearchResult::PY_SOURCE);
     }
 
-    return SearchResult("", SearchResult::SEARCH_ERROR);
+    return findModule(name, full_name, path_list);
 }
 
 /* Return the package that an import is being performed in.  If globals comes
@@ -377,7 +482,7 @@ static Box* importSub(const std::string& name, const std::string& full_name, Box
         }
     }
 
-    SearchResult sr = findModule(name, full_name, path_list);
+    SearchResult sr = findModuleOrBundled(name, full_name, path_list);
 
     if (sr.type != SearchResult::SEARCH_ERROR) {
         Box* module;
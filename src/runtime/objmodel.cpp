@@ -22,6 +22,8 @@
 #include <sstream>
 #include <stdint.h>
 
+#include "llvm/ADT/Hashing.h"
+
 #include "asm_writing/icinfo.h"
 #include "asm_writing/rewriter.h"
 #include "capi/typeobject.h"
@@ -31,6 +33,7 @@
 #include "codegen/compvars.h"
 #include "codegen/irgen/hooks.h"
 #include "codegen/parser.h"
+#include "codegen/persistent_profile.h"
 #include "codegen/type_recording.h"
 #include "codegen/unwinding.h"
 #include "core/ast.h"
@@ -92,12 +95,7 @@ static const std::string setitem_str("__setitem__");
 static const std::string set_str("__set__");
 static const std::string str_str("__str__");
 
-#if 0
-void REWRITE_ABORTED(const char* reason) {
-}
-#else
-#define REWRITE_ABORTED(reason) ((void)(reason))
-#endif
+#define REWRITE_ABORTED(reason) noteRewriteAbortReason(reason, __FILE__, __LINE__)
 
 static Box* (*runtimeCallInternal0)(Box*, CallRewriteArgs*, ArgPassSpec)
     = (Box * (*)(Box*, CallRewriteArgs*, ArgPassSpec))runtimeCallInternal;
@@ -172,6 +170,8 @@ extern "C" Box* deopt(AST_expr* expr, Box* value) {
 
     // Should we only do this selectively?
     execution_point.cf->speculationFailed();
+    // Let the next version of this function know what we actually got here:
+    recordType(getTypeRecorderForNode(expr), value);
 
     return astInterpretFrom(execution_point.cf, expr, execution_point.current_stmt, value, frame_state);
 }
@@ -324,6 +324,7 @@ BoxedClass::BoxedClass(BoxedClass* base, gcvisit_func gc_visit, int attrs_offset
       gc_visit(gc_visit),
       simple_destructor(NULL),
       attrs_offset(attrs_offset),
+      inline_attrs_hint(-1),
       is_constant(false),
       is_user_defined(is_user_defined),
       is_pyston_class(true) {
@@ -545,6 +546,44 @@ HiddenClass* HiddenClass::getAttrwrapperChild() {
     return attrwrapper_child;
 }
 
+HiddenClass* HiddenClass::getInlineRoot(int inline_capacity) {
+    assert(inline_capacity >= 0 && inline_capacity <= MAX_INLINE_ATTRS);
+    if (inline_capacity == 0)
+        return root_hcls;
+
+    static HiddenClass* inline_roots[MAX_INLINE_ATTRS + 1];
+    HiddenClass*& root = inline_roots[inline_capacity];
+    if (!root) {
+        root = new HiddenClass(NORMAL, inline_capacity);
+        gc::registerPermanentRoot(root);
+    }
+    return root;
+}
+
+HiddenClass* HiddenClass::replayOnto(HiddenClass* root, int skip_idx) {
+    assert(type == NORMAL);
+    assert(root->type == NORMAL);
+
+    int num_attrs = attributeArraySize();
+    std::vector<std::string> attrs(num_attrs);
+    for (auto it = attr_offsets.begin(); it != attr_offsets.end(); ++it)
+        attrs[it->second] = it->first();
+
+    // TODO we can first locate the parent HiddenClass of the deleted
+    // attribute and hence avoid creation of its ancestors.
+    HiddenClass* cur = root;
+    for (int i = 0; i < num_attrs; i++) {
+        if (i == skip_idx)
+            continue;
+
+        if (i == attrwrapper_offset)
+            cur = cur->getAttrwrapperChild();
+        else
+            cur = cur->getOrMakeChild(attrs[i]);
+    }
+    return cur;
+}
+
 /**
  * del attr from current HiddenClass, maintaining the order of the remaining attrs
  */
@@ -555,31 +594,14 @@ HiddenClass* HiddenClass::delAttrToMakeHC(const std::string& attr) {
     int idx = getOffset(attr);
     assert(idx >= 0);
 
-    std::vector<std::string> new_attrs(attributeArraySize() - 1);
-    for (auto it = attr_offsets.begin(); it != attr_offsets.end(); ++it) {
-        if (it->second < idx)
-            new_attrs[it->second] = it->first();
-        else if (it->second > idx) {
-            new_attrs[it->second - 1] = it->first();
-        }
-    }
+    return replayOnto(getInlineRoot(inline_capacity), idx);
+}
 
-    int new_attrwrapper_offset = attrwrapper_offset;
-    if (new_attrwrapper_offset > idx)
-        new_attrwrapper_offset--;
+HiddenClass* HiddenClass::getNonInlineEquivalent() {
+    assert(type == NORMAL);
+    assert(inline_capacity);
 
-    // TODO we can first locate the parent HiddenClass of the deleted
-    // attribute and hence avoid creation of its ancestors.
-    HiddenClass* cur = root_hcls;
-    int curidx = 0;
-    for (const auto& attr : new_attrs) {
-        if (curidx == new_attrwrapper_offset)
-            cur = cur->getAttrwrapperChild();
-        else
-            cur = cur->getOrMakeChild(attr);
-        curidx++;
-    }
-    return cur;
+    return replayOnto(root_hcls, -1);
 }
 
 size_t Box::getHCAttrsOffset() {
@@ -708,6 +730,10 @@ Box* Box::getattr(const std::string& attr, GetattrRewriteArgs* rewrite_args) {
             if (cls->attrs_offset < 0) {
                 REWRITE_ABORTED("");
                 rewrite_args = NULL;
+            } else if (hcls->getInlineCapacity()) {
+                // The hcls guard implies that the attribute lives inline, so we can skip loading attr_list:
+                rewrite_args->out_rtn
+                    = rewrite_args->obj->getAttr(cls->tp_basicsize + offset * sizeof(Box*), Location::any());
             } else {
                 RewriterVar* r_attrs
                     = rewrite_args->obj->getAttr(cls->attrs_offset + HCATTRS_ATTRS_OFFSET, Location::any());
@@ -754,6 +780,28 @@ void Box::appendNewHCAttr(Box* new_attr, SetattrRewriteArgs* rewrite_args) {
 
     int numattrs = hcls->attributeArraySize();
 
+    if (cls->inline_attrs_hint >= 0 && hcls->type == HiddenClass::NORMAL) {
+        // Learn how many attributes instances of this class tend to have, so that future ones can get
+        // enough inline slots:
+        int wanted = std::min(numattrs + 1, (int)HiddenClass::MAX_INLINE_ATTRS);
+        if (wanted > cls->inline_attrs_hint)
+            cls->inline_attrs_hint = wanted;
+    }
+
+    if (hcls->getInlineCapacity()) {
+        // The caller is responsible for spilling the inline attributes if they are full.
+        assert(numattrs < hcls->getInlineCapacity());
+        assert(attrs->attr_list == (HCAttrs::AttrList*)((char*)this + cls->tp_basicsize));
+
+        if (rewrite_args) {
+            assert(cls->attrs_offset > 0);
+            rewrite_args->obj->setAttr(cls->tp_basicsize + numattrs * sizeof(Box*), rewrite_args->attrval);
+            rewrite_args->out_success = true;
+        }
+        attrs->attr_list->attrs[numattrs] = new_attr;
+        return;
+    }
+
     RewriterVar* r_new_array2 = NULL;
     int new_size = sizeof(HCAttrs::AttrList) + sizeof(Box*) * (numattrs + 1);
     if (numattrs == 0) {
@@ -787,6 +835,32 @@ void Box::appendNewHCAttr(Box* new_attr, SetattrRewriteArgs* rewrite_args) {
     attrs->attr_list->attrs[numattrs] = new_attr;
 }
 
+static StatCounter num_inline_attrs_spills("num_inline_attrs_spills");
+HiddenClass* Box::spillInlineHCAttrs() {
+    HCAttrs* attrs = getHCAttrsPtr();
+    HiddenClass* hcls = attrs->hcls;
+    assert(hcls->type == HiddenClass::NORMAL && hcls->getInlineCapacity());
+
+    num_inline_attrs_spills.log();
+
+    HiddenClass* new_hcls = hcls->getNonInlineEquivalent();
+
+    int numattrs = hcls->attributeArraySize();
+    assert(numattrs > 0);
+    auto new_attr_list = (HCAttrs::AttrList*)gc_alloc(sizeof(HCAttrs::AttrList) + sizeof(Box*) * numattrs,
+                                                      gc::GCKind::PRECISE);
+    memcpy(new_attr_list->attrs, attrs->attr_list->attrs, sizeof(Box*) * numattrs);
+
+    // The inline slots just become dead space in the object:
+    attrs->hcls = new_hcls;
+    attrs->attr_list = new_attr_list;
+    return new_hcls;
+}
+
+// Bumped whenever a type object's attributes change; results in the megamorphic cache are only valid
+// for the epoch they were computed in.
+static int64_t type_mutation_epoch = 0;
+
 void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite_args) {
     assert(gc::isValidGCObject(val));
 
@@ -804,6 +878,9 @@ void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite
 
     RELEASE_ASSERT(attr != none_str || this == builtins_module, "can't assign to None");
 
+    if (PyType_Check(this))
+        type_mutation_epoch++;
+
     if (cls->instancesHaveHCAttrs()) {
         HCAttrs* attrs = getHCAttrsPtr();
         HiddenClass* hcls = attrs->hcls;
@@ -844,6 +921,10 @@ void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite
                 if (cls->attrs_offset < 0) {
                     REWRITE_ABORTED("");
                     rewrite_args = NULL;
+                } else if (hcls->getInlineCapacity()) {
+                    rewrite_args->obj->setAttr(cls->tp_basicsize + offset * sizeof(Box*), rewrite_args->attrval);
+
+                    rewrite_args->out_success = true;
                 } else {
                     RewriterVar* r_hattrs
                         = rewrite_args->obj->getAttr(cls->attrs_offset + HCATTRS_ATTRS_OFFSET, Location::any());
@@ -860,6 +941,16 @@ void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite
         assert(offset == -1);
 
         if (hcls->type == HiddenClass::NORMAL) {
+            if (hcls->inlineAttrsFull()) {
+                // We predicted too few attributes for this object; move them out of line.
+                // This should be rare enough that it's not worth rewriting.
+                if (rewrite_args) {
+                    REWRITE_ABORTED("");
+                    rewrite_args = NULL;
+                }
+                hcls = spillInlineHCAttrs();
+            }
+
             HiddenClass* new_hcls = hcls->getOrMakeChild(attr);
             // make sure we don't need to rearrange the attributes
             assert(new_hcls->getStrAttrOffsets().lookup(attr) == hcls->attributeArraySize());
@@ -1742,6 +1833,143 @@ Box* getattrInternal(Box* obj, const std::string& attr, GetattrRewriteArgs* rewr
                              /* for_call */ false, NULL, NULL);
 }
 
+// A single cache shared by all megamorphic getattr and callattr ICs.  Once an IC has seen too many different
+// types, we stop generating specialized code for it and instead have it call into here, which handles the
+// common cases (instance attributes, plain class attributes and methods) with a hash table probe.
+//
+// Entries are keyed on the class, the hidden class and the attribute name.  For instance attributes we
+// remember the offset into the attribute array; for class attributes we remember the value itself, which
+// is only valid until some type object gets mutated.
+class MegamorphicCache : public GCAllocated<gc::GCKind::CONSERVATIVE> {
+public:
+    enum Kind {
+        INSTANCE_ATTR,
+        CLASS_ATTR,
+        CLASS_FUNCTION, // needs to be bound to the object
+    };
+
+    struct Entry {
+        BoxedClass* cls;
+        HiddenClass* hcls;
+        Box* value;
+        int64_t epoch;
+        int offset;
+        Kind kind;
+        std::string attr;
+    };
+
+private:
+    static const int NUM_ENTRIES = 1024;
+    Entry entries[NUM_ENTRIES];
+
+    Entry& entryFor(BoxedClass* cls, HiddenClass* hcls, llvm::StringRef attr) {
+        size_t h = llvm::hash_combine(cls, hcls, attr);
+        return entries[h % NUM_ENTRIES];
+    }
+
+public:
+    MegamorphicCache() {
+        for (Entry& e : entries) {
+            e.cls = NULL;
+            e.hcls = NULL;
+            e.value = NULL;
+            e.epoch = -1;
+        }
+    }
+
+    // Returns the entry describing how to look up `attr` on `obj`, or NULL if this lookup is not one
+    // that we can cache.
+    Entry* lookup(Box* obj, const char* attr) {
+        static StatCounter megamorphic_hits("megamorphic_cache_hits");
+        static StatCounter megamorphic_misses("megamorphic_cache_misses");
+        static StatCounter megamorphic_uncacheable("megamorphic_cache_uncacheable");
+
+        BoxedClass* cls = obj->cls;
+        if (!cls->instancesHaveHCAttrs() || PyType_Check(obj))
+            return NULL;
+        HiddenClass* hcls = obj->getHCAttrsPtr()->hcls;
+        if (hcls->type != HiddenClass::NORMAL)
+            return NULL;
+
+        llvm::StringRef attr_ref(attr);
+        Entry& e = entryFor(cls, hcls, attr_ref);
+        if (e.cls == cls && e.hcls == hcls && e.epoch == type_mutation_epoch && e.attr == attr_ref) {
+            megamorphic_hits.log();
+            return &e;
+        }
+        megamorphic_misses.log();
+
+        if (cls->tp_getattr || (cls->tp_getattro && cls->tp_getattro != PyObject_GenericGetAttr)) {
+            megamorphic_uncacheable.log();
+            return NULL;
+        }
+
+        std::string attr_str(attr);
+        Box* descr = typeLookup(cls, attr_str, NULL);
+        int offset = hcls->getOffset(attr_str);
+
+        Kind kind;
+        if (descr && descr->cls == function_cls) {
+            kind = offset >= 0 ? INSTANCE_ATTR : CLASS_FUNCTION;
+        } else if (descr) {
+            // Anything that might act as a descriptor goes through the generic path:
+            BoxedClass* descr_cls = descr->cls;
+            if (descr_cls->tp_descr_get || isNondataDescriptorInstanceSpecialCase(descr) || descr_cls == method_cls
+                || descr_cls == member_descriptor_cls || descr_cls == property_cls
+                || descr_cls == pyston_getset_cls || descr_cls == capi_getset_cls) {
+                megamorphic_uncacheable.log();
+                return NULL;
+            }
+            kind = offset >= 0 ? INSTANCE_ATTR : CLASS_ATTR;
+        } else {
+            if (offset < 0) {
+                // Not found; let the generic path deal with __getattr__ and raising the error.
+                megamorphic_uncacheable.log();
+                return NULL;
+            }
+            kind = INSTANCE_ATTR;
+        }
+
+        e.cls = cls;
+        e.hcls = hcls;
+        e.value = kind == INSTANCE_ATTR ? NULL : descr;
+        e.epoch = type_mutation_epoch;
+        e.offset = offset;
+        e.kind = kind;
+        e.attr = std::move(attr_str);
+        return &e;
+    }
+
+    static MegamorphicCache* get() {
+        static MegamorphicCache* cache = NULL;
+        if (!cache) {
+            cache = new MegamorphicCache();
+            gc::registerPermanentRoot(cache);
+        }
+        return cache;
+    }
+};
+
+// The function that megamorphic getattr ICs call into.
+static Box* getattrMegamorphic(Box* obj, const char* attr) {
+    MegamorphicCache::Entry* e = MegamorphicCache::get()->lookup(obj, attr);
+    if (e) {
+        switch (e->kind) {
+            case MegamorphicCache::INSTANCE_ATTR:
+                return obj->getHCAttrsPtr()->attr_list->attrs[e->offset];
+            case MegamorphicCache::CLASS_ATTR:
+                return e->value;
+            case MegamorphicCache::CLASS_FUNCTION:
+                return boxInstanceMethod(obj, e->value, obj->cls);
+        }
+    }
+
+    Box* val = getattrInternal(obj, attr, NULL);
+    if (val)
+        return val;
+    raiseAttributeError(obj, attr);
+}
+
 extern "C" Box* getattr(Box* obj, const char* attr) {
     STAT_TIMER(t0, "us_timer_slowpath_getattr");
 
@@ -1759,6 +1987,16 @@ extern "C" Box* getattr(Box* obj, const char* attr) {
     std::unique_ptr<Rewriter> rewriter(
         Rewriter::createRewriter(__builtin_extract_return_addr(__builtin_return_address(0)), 2, "getattr"));
 
+    if (rewriter.get() && rewriter->isMegamorphic()) {
+        static StatCounter megamorphic_stubs("megamorphic_getattr_stubs");
+        megamorphic_stubs.log();
+
+        RewriterVar* r_rtn
+            = rewriter->call(true, (void*)getattrMegamorphic, rewriter->getArg(0), rewriter->getArg(1));
+        rewriter->commitReturning(r_rtn);
+        return getattrMegamorphic(obj, attr);
+    }
+
     Box* val;
     if (rewriter.get()) {
         Location dest;
@@ -2641,6 +2879,47 @@ extern "C" Box* callattrInternal(Box* obj, const std::string* attr, LookupScope
     }
 }
 
+// The function that megamorphic callattr ICs call into.  Only used for calls that pass at most two
+// positional arguments, so that all the arguments fit in registers.
+static Box* callattrMegamorphic(Box* obj, const std::string* attr, CallattrFlags flags, ArgPassSpec argspec,
+                                Box* arg1, Box* arg2) {
+    assert(argspec.num_args <= 2 && argspec.num_keywords == 0 && !argspec.has_starargs && !argspec.has_kwargs);
+
+    MegamorphicCache::Entry* e = NULL;
+    if (!flags.cls_only)
+        e = MegamorphicCache::get()->lookup(obj, attr->c_str());
+
+    if (!e) {
+        LookupScope scope = flags.cls_only ? CLASS_ONLY : CLASS_OR_INST;
+        if ((*attr)[0] == '_' && (*attr)[1] == '_' && PyInstance_Check(obj)) {
+            if (*attr == "__enter__" || *attr == "__exit__")
+                scope = CLASS_OR_INST;
+        }
+
+        Box* rtn = callattrInternal(obj, attr, scope, NULL, argspec, arg1, arg2, NULL, NULL, NULL);
+        if (rtn == NULL && !flags.null_on_nonexistent)
+            raiseAttributeError(obj, attr->c_str());
+        return rtn;
+    }
+
+    Box* val;
+    Box* rtn;
+    if (e->kind == MegamorphicCache::CLASS_FUNCTION) {
+        val = e->value;
+        rtn = runtimeCallInternal(val, NULL, ArgPassSpec(argspec.num_args + 1), obj, arg1, arg2, NULL, NULL);
+    } else {
+        if (e->kind == MegamorphicCache::INSTANCE_ATTR)
+            val = obj->getHCAttrsPtr()->attr_list->attrs[e->offset];
+        else
+            val = e->value;
+        rtn = runtimeCallInternal(val, NULL, argspec, arg1, arg2, NULL, NULL, NULL);
+    }
+
+    if (!rtn)
+        raiseExcHelper(TypeError, "'%s' object is not callable", getTypeName(val));
+    return rtn;
+}
+
 extern "C" Box* callattr(Box* obj, const std::string* attr, CallattrFlags flags, ArgPassSpec argspec, Box* arg1,
                          Box* arg2, Box* arg3, Box** args, const std::vector<const std::string*>* keyword_names) {
     STAT_TIMER(t0, "us_timer_slowpath_callattr");
@@ -2673,6 +2952,22 @@ extern "C" Box* callattr(Box* obj, const std::string* attr, CallattrFlags flags,
             scope = CLASS_OR_INST;
     }
 
+    if (rewriter.get() && rewriter->isMegamorphic() && argspec.num_args <= 2 && argspec.num_keywords == 0
+        && !argspec.has_starargs && !argspec.has_kwargs) {
+        static StatCounter megamorphic_stubs("megamorphic_callattr_stubs");
+        megamorphic_stubs.log();
+
+        RewriterVar::SmallVector stub_args;
+        for (int i = 0; i < 4 + npassed_args; i++)
+            stub_args.push_back(rewriter->getArg(i));
+        // Pad out the arguments that weren't passed; callattrMegamorphic won't look at them.
+        for (int i = 4 + npassed_args; i < 6; i++)
+            stub_args.push_back(rewriter->loadConst(0));
+        RewriterVar* r_rtn = rewriter->call(true, (void*)callattrMegamorphic, stub_args);
+        rewriter->commitReturning(r_rtn);
+        return callattrMegamorphic(obj, attr, flags, argspec, arg1, arg2);
+    }
+
     if (rewriter.get()) {
         // TODO feel weird about doing this; it either isn't necessary
         // or this kind of thing is necessary in a lot more places
@@ -2760,6 +3055,9 @@ static CompiledFunction* pickVersion(CLFunction* f, int num_output_args, Box* oa
     }
 
     EffortLevel new_effort = initialEffort();
+    // If a previous run ended up compiling this function at a higher tier, go straight there:
+    if (!FORCE_INTERPRETER)
+        new_effort = std::max(new_effort, getPersistedEffort(f->source.get()));
     // Only the interpreter currently supports non-module-globals:
     if (!f->source->scoping->areGlobalsFromModule())
         new_effort = EffortLevel::INTERPRETED;
@@ -3908,6 +4206,9 @@ extern "C" void delitem(Box* target, Box* slice) {
 }
 
 void Box::delattr(const std::string& attr, DelattrRewriteArgs* rewrite_args) {
+    if (PyType_Check(this))
+        type_mutation_epoch++;
+
     if (cls->instancesHaveHCAttrs()) {
         // as soon as the hcls changes, the guard on hidden class won't pass.
         HCAttrs* attrs = getHCAttrsPtr();
@@ -3944,8 +4245,11 @@ void Box::delattr(const std::string& attr, DelattrRewriteArgs* rewrite_args) {
         }
 
         // guarantee the size of the attr_list equals the number of attrs
-        int new_size = sizeof(HCAttrs::AttrList) + sizeof(Box*) * (num_attrs - 1);
-        attrs->attr_list = (HCAttrs::AttrList*)gc::gc_realloc(attrs->attr_list, new_size);
+        // (inline slots don't get resized)
+        if (!hcls->getInlineCapacity()) {
+            int new_size = sizeof(HCAttrs::AttrList) + sizeof(Box*) * (num_attrs - 1);
+            attrs->attr_list = (HCAttrs::AttrList*)gc::gc_realloc(attrs->attr_list, new_size);
+        }
         return;
     }
 
@@ -4393,6 +4697,14 @@ Box* typeNew(Box* _cls, Box* arg1, Box* arg2, Box** _args) {
     else
         made->tp_alloc = PyType_GenericAlloc;
 
+    // We can only put attributes inline if the hcattrs were added by a Python-level class (this one or a base),
+    // since C++ constructors will reinitialize hcattrs that are a member of their object.
+    if (ENABLE_INLINE_ATTRS && made->tp_alloc == PystonType_GenericAlloc && attrs_offset > 0
+        && (add_dict || base->inline_attrs_hint >= 0)) {
+        assert(made->tp_basicsize % sizeof(Box*) == 0);
+        made->inline_attrs_hint = std::max(0, base->inline_attrs_hint);
+    }
+
     assert(!made->simple_destructor);
     for (auto b : *bases) {
         if (!isSubclass(b->cls, type_cls))
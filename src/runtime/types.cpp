@@ -94,7 +94,14 @@ bool IN_SHUTDOWN = false;
 extern "C" PyObject* PystonType_GenericAlloc(BoxedClass* cls, Py_ssize_t nitems) noexcept {
     assert(cls);
 
-    const size_t size = _PyObject_VAR_SIZE(cls, nitems);
+    size_t size = _PyObject_VAR_SIZE(cls, nitems);
+
+    // Make room for the attributes that we expect instances of this class to get:
+    int inline_attrs = cls->inline_attrs_hint;
+    if (inline_attrs > 0) {
+        assert(cls->tp_itemsize == 0 && cls->attrs_offset > 0);
+        size += inline_attrs * sizeof(Box*);
+    }
 
 #ifndef NDEBUG
 #if 0
@@ -138,6 +145,12 @@ extern "C" PyObject* PystonType_GenericAlloc(BoxedClass* cls, Py_ssize_t nitems)
     PyObject_INIT(rtn, cls);
     assert(rtn->cls);
 
+    if (inline_attrs > 0) {
+        HCAttrs* attrs = rtn->getHCAttrsPtr();
+        attrs->hcls = HiddenClass::getInlineRoot(inline_attrs);
+        attrs->attr_list = (HCAttrs::AttrList*)((char*)rtn + cls->tp_basicsize);
+    }
+
     return rtn;
 }
 
@@ -445,9 +458,17 @@ extern "C" void boxGCHandler(GCVisitor* v, Box* b) {
         if (b->cls->instancesHaveHCAttrs()) {
             HCAttrs* attrs = b->getHCAttrsPtr();
 
-            v->visit(attrs->hcls);
-            if (attrs->attr_list)
-                v->visit(attrs->attr_list);
+            HiddenClass* hcls = attrs->hcls;
+            v->visit(hcls);
+            if (attrs->attr_list) {
+                if (hcls && hcls->type == HiddenClass::NORMAL && hcls->getInlineCapacity()) {
+                    // The attributes are stored inside this object, so scan them directly:
+                    Box** start = attrs->attr_list->attrs;
+                    v->visitRange((void* const*)start, (void* const*)(start + hcls->attributeArraySize()));
+                } else {
+                    v->visit(attrs->attr_list);
+                }
+            }
         }
 
         if (b->cls->instancesHaveDictAttrs()) {
@@ -1609,6 +1630,9 @@ Box* Box::getAttrWrapper() {
     if (offset == -1) {
         Box* aw = new AttrWrapper(this);
         if (hcls->type == HiddenClass::NORMAL) {
+            if (hcls->inlineAttrsFull())
+                hcls = spillInlineHCAttrs();
+
             auto new_hcls = hcls->getAttrwrapperChild();
             appendNewHCAttr(aw, NULL);
             attrs->hcls = new_hcls;
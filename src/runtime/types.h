@@ -182,6 +182,12 @@ public:
     // (But having nonzero attrs_offset here would map to having nonzero tp_dictoffset in CPython)
     const int attrs_offset;
 
+    // How many attribute slots to allocate inline, directly after tp_basicsize, in new instances of this class.
+    // This is learned from the number of attributes that previous instances ended up with.
+    // -1 means that instances of this class can't have inline attributes (ex their hcattrs is a C++ member that
+    // gets reinitialized by a constructor, or they aren't allocated through PystonType_GenericAlloc).
+    int inline_attrs_hint;
+
     bool instancesHaveHCAttrs() { return attrs_offset != 0; }
     bool instancesHaveDictAttrs() { return tp_dictoffset != 0; }
 
@@ -289,15 +295,27 @@ public:
 
     static HiddenClass* dict_backed;
 
+    // The largest number of attributes that we will try to store inline in an object.
+    static const int MAX_INLINE_ATTRS = 8;
+
 private:
-    HiddenClass(HCType type) : type(type) {}
-    HiddenClass(HiddenClass* parent) : type(NORMAL), attr_offsets(), attrwrapper_offset(parent->attrwrapper_offset) {
+    HiddenClass(HCType type, int inline_capacity = 0) : type(type), inline_capacity(inline_capacity) {}
+    HiddenClass(HiddenClass* parent)
+        : type(NORMAL),
+          inline_capacity(parent->inline_capacity),
+          attr_offsets(),
+          attrwrapper_offset(parent->attrwrapper_offset) {
         assert(parent->type == NORMAL);
         for (auto& p : parent->attr_offsets) {
             this->attr_offsets.insert(&p);
         }
     }
 
+    // Only nonzero for NORMAL hidden classes.  If nonzero, objects with this hidden class were allocated with
+    // this many attribute slots directly after the end of the object (at cls->tp_basicsize), and attr_list points
+    // to those slots.  All hidden classes in a tree share the capacity of their root.
+    const int inline_capacity;
+
     // These fields only make sense for NORMAL or SINGLETON hidden classes:
     llvm::StringMap<int> attr_offsets;
     // If >= 0, is the offset where we stored an attrwrapper object
@@ -330,6 +348,10 @@ public:
         return new HiddenClass(DICT_BACKED);
     }
 
+    // Returns the root of the hidden class tree for objects with the given number of inline attribute slots.
+    // getInlineRoot(0) is root_hcls.
+    static HiddenClass* getInlineRoot(int inline_capacity);
+
     void gc_visit(GCVisitor* visitor) {
         // Visit children even for the dict-backed case, since children will just be empty
         visitor->visitRange((void* const*)&children.vector()[0], (void* const*)&children.vector()[children.size()]);
@@ -375,6 +397,14 @@ public:
         return attrwrapper_offset;
     }
 
+    int getInlineCapacity() { return inline_capacity; }
+
+    // Whether adding another attribute would overflow the inline slots.  Only valid for NORMAL hidden classes.
+    bool inlineAttrsFull() {
+        assert(type == NORMAL);
+        return inline_capacity && attributeArraySize() == inline_capacity;
+    }
+
     // Only valid for SINGLETON hidden classes:
     void appendAttribute(llvm::StringRef attr);
     void appendAttrwrapper();
@@ -386,6 +416,15 @@ public:
 
     // Only valid for NORMAL hidden classes:
     HiddenClass* delAttrToMakeHC(const std::string& attr);
+
+    // Only valid for NORMAL hidden classes.  Returns the hidden class with the same attribute layout, but
+    // without any inline slots.
+    HiddenClass* getNonInlineEquivalent();
+
+private:
+    // Rebuilds this hidden class's attributes, in order, starting from the given root and leaving out the
+    // attribute at skip_idx (if it's not -1).
+    HiddenClass* replayOnto(HiddenClass* root, int skip_idx);
 };
 
 class BoxedInt : public Box {
@@ -0,0 +1,51 @@
+# Functions of different sizes tier up at different points; they should compute the same thing
+# however far they got.
+
+try:
+    import __pyston__
+    __pyston__.setOption("ENABLE_ADAPTIVE_TIERING", 1)
+    __pyston__.setOption("REOPT_THRESHOLD_INTERPRETER", 20)
+    __pyston__.setOption("REOPT_THRESHOLD_BASELINE", 40)
+except ImportError:
+    pass
+
+def small(x):
+    return x * 2 + 1
+
+def big(x):
+    t = 0
+    if x % 2:
+        t += 1
+    else:
+        t -= 1
+    if x % 3:
+        t += x
+    elif x % 5:
+        t -= x
+    for i in xrange(3):
+        if i == x:
+            t += 100
+        else:
+            t += i
+    try:
+        t += 10 / (x % 7)
+    except ZeroDivisionError:
+        t -= 7
+    while t > 1000:
+        t /= 2
+    return t
+
+# Called rarely, but loops a lot:
+def loopy(n):
+    s = 0
+    for i in xrange(n):
+        s += i % 7
+    return s
+
+total = 0
+for i in xrange(500):
+    total += small(i) + big(i)
+    if i % 100 == 0:
+        total += loopy(2000)
+print total
+print small(10), big(10), big(35), loopy(100)
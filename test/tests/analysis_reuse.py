@@ -0,0 +1,33 @@
+# Recompiling a function at a higher effort level, or for an OSR entry, reuses the analyses of its earlier
+# compiles; make sure that the later compiles still notice when the type feedback changed in between.
+# statcheck: stats['num_type_analysis_blocks_reused'] >= 1
+# statcheck: stats['num_liveness_analysis_reused'] >= 1
+# statcheck: stats['num_phi_analysis_reused'] >= 1
+
+class C(object):
+    def __init__(self, x):
+        self.x = x
+
+def f(objs, n):
+    t = 0
+    for i in xrange(n):
+        t = t * 3 + objs[i % len(objs)].x
+        t = t % 1000003
+    return t
+
+ints = [C(i) for i in xrange(10)]
+for i in xrange(2000):
+    r = f(ints, 20)
+print r
+print f(ints, 100000)
+
+# The speculations that the earlier compiles made don't hold anymore:
+floats = [C(i + 0.5) for i in xrange(10)]
+print f(floats, 100)
+big = [C(2 ** 62)]
+print f(big, 100)
+
+for i in xrange(2000):
+    r = f(floats, 20)
+print r
+print f(big, 100000)
@@ -0,0 +1,96 @@
+# Blocks that the interpreter runs often enough get compiled by the baseline JIT.
+# Turn off the LLVM tiers so that everything here stays in the interpreter / baseline JIT.
+
+try:
+    import __pyston__
+    __pyston__.setOption("ENABLE_REOPT", 0)
+    __pyston__.setOption("ENABLE_OSR", 0)
+    __pyston__.setOption("BASELINEJIT_THRESHOLD", 5)
+except ImportError:
+    pass
+
+class C(object):
+    def __init__(self, x):
+        self.x = x
+
+    def get(self, n):
+        return self.x + n
+
+    def __getitem__(self, i):
+        return i * 2
+
+def f(c, l, d, i):
+    a = c.x
+    b = a + i
+    t = a < b
+    if t:
+        b = c.get(3)
+    d[i] = b
+    c.y = l[i % 3]
+    return c.y + d[i] + c[i] + (i / 2)
+
+total = 0
+for i in xrange(100):
+    total += f(C(i), [1, 2, 3], {}, i)
+print total
+
+# Polymorphic operands going through the same compiled blocks:
+def g(a, b):
+    return a + b, a < b, a[0] if a else None
+
+for args in [(1, 2), ("a", "b"), ([1], [2]), ((), ()), (1.5, 2), (2L, 3)] * 5:
+    try:
+        print g(*args)
+    except TypeError:
+        print "TypeError", args
+
+# Exceptions and tracebacks from inside compiled blocks:
+def h(o):
+    return o.missing
+
+for i in xrange(10):
+    try:
+        h(C(i))
+    except AttributeError as e:
+        pass
+print e
+
+import traceback
+try:
+    h(C(0))
+except AttributeError:
+    print traceback.format_exc().strip().split('\n')[-2].strip()
+
+# Generators, closures and loops:
+def gen(n):
+    for i in xrange(n):
+        yield i * i
+
+def outer():
+    k = 5
+    def inner(x):
+        return x + k
+    return [inner(x) for x in gen(20)]
+for i in xrange(10):
+    r = outer()
+print r
+
+def loop():
+    s = 0
+    i = 0
+    while i < 1000:
+        if i % 2:
+            s += i
+        else:
+            s -= 1
+        i += 1
+    return s
+print loop()
+
+# Exceptions caught by the same function whose compiled block raised them:
+def k(o):
+    try:
+        return o.missing
+    except AttributeError:
+        return -1
+print sum(k(C(i)) for i in xrange(20))
@@ -0,0 +1,27 @@
+# The baseline JIT code of an interpreted version gets freed once the version gets reoptimized.
+# statcheck: stats['baselinejit_blocks_freed'] >= 1
+
+try:
+    import __pyston__
+    __pyston__.setOption("BASELINEJIT_THRESHOLD", 5)
+except ImportError:
+    pass
+
+class C(object):
+    pass
+
+def f(c, i):
+    c.x = i
+    return c.x + i
+
+def g(i):
+    return i * 2
+
+c = C()
+total = 0
+for i in xrange(20000):
+    total += f(c, i)
+# Freeing happens on the next compile:
+for i in xrange(20000):
+    total += g(i)
+print total
@@ -0,0 +1,70 @@
+# The C API entry points (PyObject_GetAttr, PyObject_GetItem, PyObject_RichCompare, ...) keep runtime ICs
+# per call site; these modules are implemented in C, so they go through those paths.  Make sure the ICs
+# don't get confused by the different attribute names, operators and types that come through one call site.
+# statcheck: 1 <= stats['runtime_ic_cache_ics_created'] < 500
+import operator
+import heapq
+
+class C(object):
+    def __init__(self, i):
+        self.a = i
+        self.b = -i
+        self.l = [i, i * 2]
+
+class D(object):
+    a = "class attr"
+    def __getattr__(self, attr):
+        return attr * 2
+
+ga = operator.attrgetter("a")
+gb = operator.attrgetter("b")
+gab = operator.attrgetter("a", "b")
+total = 0
+for i in xrange(1000):
+    c = C(i)
+    total += ga(c) * 3 + gb(c) + sum(gab(c))
+print total
+print ga(D()), gb(D()), gab(D())
+try:
+    operator.attrgetter("missing")(C(1))
+except AttributeError as e:
+    print e
+
+g0 = operator.itemgetter(0)
+g1 = operator.itemgetter(1)
+print [g0(x) for x in ([1, 2], (3, 4), "ab", {0: "zero"})]
+print [g1(C(i).l) for i in xrange(5)]
+d = {}
+for i in xrange(100):
+    operator.setitem(d, i % 7, i)
+    operator.setitem(C(i).l, 0, d)
+print sorted(d.items())
+
+class Rev(object):
+    def __init__(self, v):
+        self.v = v
+    def __lt__(self, other):
+        return self.v > other.v
+    def __repr__(self):
+        return "Rev(%d)" % self.v
+
+for l in ([5, 3, 8, 1], [2.5, -1.0, 3], ["b", "a", "c"], [Rev(1), Rev(3), Rev(2)]):
+    h = list(l)
+    heapq.heapify(h)
+    print [heapq.heappop(h) for _ in xrange(len(l))]
+
+print [f(1, 2) for f in (operator.lt, operator.le, operator.eq, operator.ne, operator.gt, operator.ge)]
+print [f(Rev(1), Rev(2)) for f in (operator.lt,)]
+print operator.eq(C(1), C(1)), operator.ne(C(1), C(1))
+
+# Lots of different attribute names through one call site make the IC cache replace its ICs; the ICs that
+# got replaced mustn't still get invalidated when the class changes.
+class E(object):
+    pass
+e = E()
+names = ["attr%d" % i for i in xrange(2000)]
+for n in names:
+    setattr(e, n, n)
+print sum(len(operator.attrgetter(n)(e)) for n in names)
+E.__getattr__ = lambda self, attr: "missing"
+print operator.attrgetter("attr5")(e), operator.attrgetter("nope")(e)
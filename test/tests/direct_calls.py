@@ -0,0 +1,88 @@
+# Calls to global functions can get compiled into direct calls to the callee's compiled code;
+# make sure they keep working when the global gets rebound, or the callee raises.
+
+def add(a, b):
+    return a + b
+
+def half(x):
+    return x / 2.0
+
+def is_odd(n):
+    return n % 2 == 1
+
+def other_add(a, b):
+    return a - b
+
+def g(i):
+    return add(i, 1) + half(i) + is_odd(i)
+
+total = 0
+for i in xrange(30000):
+    total += g(i)
+print total
+
+add = other_add
+print g(10)
+
+def raiser(x):
+    if x == 12345:
+        raise ValueError(x)
+    return x
+
+def h(n):
+    t = 0
+    for i in xrange(n):
+        try:
+            t += raiser(i)
+        except ValueError as e:
+            print "caught", e
+    return t
+print h(20000)
+
+add = lambda a, b: a * b
+print g(10)
+del add
+try:
+    g(10)
+except NameError as e:
+    print e
+
+# The callee's version getting replaced (here, killed after it keeps failing its type speculations) has to send
+# the direct calls to whatever version is current:
+class C(object):
+    def __init__(self, v):
+        self.v = v
+
+def callee(c):
+    return c.v + c.v
+
+def caller(c):
+    return callee(c)
+
+t = 0
+for i in xrange(30000):
+    t += caller(C(i))
+print t
+s = 0
+for i in xrange(100):
+    s += len(caller(C(str(i))))
+print s
+
+# Same thing, but with the callee getting recompiled before the caller gets compiled, so that the caller never
+# gets to see the callee's original version:
+def callee2(c):
+    return c.v * 2
+
+for i in xrange(30000):
+    callee2(C(i))
+for i in xrange(100):
+    callee2(C(str(i)))
+
+def caller2(c):
+    return callee2(c)
+
+t = 0
+for i in xrange(30000):
+    t += caller2(C(i))
+print t
+print caller2(C("ab"))
@@ -0,0 +1,14 @@
+# Code compiled from strings shares one arena, instead of getting a couple of mostly-empty arena slabs (4KB each)
+# per string:
+# statcheck: stats['arena_slab_bytes'] < 12 * 1024 * 1024
+
+t = 0
+for i in xrange(3000):
+    t += eval("i + %d" % i)
+    exec "t -= %d" % i
+print t
+
+ns = {}
+for i in xrange(500):
+    exec compile("def f%d(x):\n    return x * %d\n" % (i, i), "<string>", "exec") in ns
+print sum(ns["f%d" % i](2) for i in xrange(500))
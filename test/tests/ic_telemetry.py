@@ -0,0 +1,32 @@
+# Smoke test for the per-IC telemetry: turn it on, run some polymorphic code, and dump the table
+# (which goes to stderr, so it doesn't affect the expected output).
+
+try:
+    import __pyston__
+    __pyston__.setOption("ENABLE_IC_TELEMETRY", 1)
+except ImportError:
+    __pyston__ = None
+
+class A(object):
+    def f(self):
+        return 1
+class B(object):
+    def f(self):
+        return 2
+class C(object):
+    def __getattr__(self, attr):
+        return lambda: 3
+
+def g(o):
+    return o.f()
+
+total = 0
+for i in xrange(1000):
+    for o in (A(), B(), C()):
+        total += g(o)
+print total
+
+if __pyston__:
+    __pyston__.dumpICStats()
+    __pyston__.dumpICStats(10)
+    __pyston__.setOption("ENABLE_IC_TELEMETRY", 0)
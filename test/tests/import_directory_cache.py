@@ -0,0 +1,37 @@
+# Imports look names up in cached directory listings; make sure that files which get created
+# after a directory has been read are still found.
+
+import os
+import shutil
+import sys
+import tempfile
+
+d = tempfile.mkdtemp()
+sys.path.insert(0, d)
+try:
+    # Make the directory look old, so that its listing gets kept around:
+    os.utime(d, (1000000000, 1000000000))
+    try:
+        import import_directory_cache_mod
+    except ImportError, e:
+        print e
+
+    with open(os.path.join(d, "import_directory_cache_mod.py"), "w") as f:
+        f.write("x = 1\n")
+    import import_directory_cache_mod
+    print import_directory_cache_mod.x
+
+    os.utime(d, (1000000000, 1000000000))
+    try:
+        import import_directory_cache_pkg
+    except ImportError, e:
+        print e
+
+    os.mkdir(os.path.join(d, "import_directory_cache_pkg"))
+    with open(os.path.join(d, "import_directory_cache_pkg", "__init__.py"), "w") as f:
+        f.write("y = 2\n")
+    import import_directory_cache_pkg
+    print import_directory_cache_pkg.y
+finally:
+    sys.path.remove(d)
+    shutil.rmtree(d)
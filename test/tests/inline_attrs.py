@@ -0,0 +1,83 @@
+# Instances of user classes get their first few attributes stored inline in the object,
+# with the number of inline slots learned from previous instances.  Exercise the transitions
+# between inline and out-of-line storage.
+
+class C(object):
+    pass
+
+def make(n):
+    c = C()
+    for i in xrange(n):
+        setattr(c, "a%d" % i, i)
+    return c
+
+def check(c, n):
+    for i in xrange(n):
+        assert getattr(c, "a%d" % i) == i
+    print n, sorted(c.__dict__.items())[:3], len(c.__dict__)
+
+# The class learns to expect more and more attributes, and the earlier
+# instances have to spill their attributes out of line:
+objs = []
+for n in (1, 2, 3, 5, 8, 13, 3, 0):
+    objs.append((make(n), n))
+for c, n in objs:
+    check(c, n)
+
+# Attribute access through the ICs:
+def f(c):
+    c.a0 = c.a0 + 1
+    return c.a0
+for i in xrange(1000):
+    c = make(3)
+    assert f(c) == 1
+    c.new_attr = i
+    assert c.new_attr == i
+print f(c), c.new_attr
+
+# Deleting attributes from inline storage:
+c = make(4)
+del c.a1
+print sorted(c.__dict__.items())
+c.a1 = 100
+print sorted(c.__dict__.items())
+del c.a3
+del c.a0
+print sorted(c.__dict__.items())
+
+# Asking for the __dict__ uses up a slot too:
+c = make(7)
+d = c.__dict__
+d["x"] = 5
+print c.x, len(d)
+
+# Subclasses and __class__ assignment:
+class D(C):
+    def __init__(self):
+        self.d1 = 1
+        self.d2 = 2
+
+for i in xrange(5):
+    d = D()
+print d.d1, d.d2, sorted(d.__dict__.items())
+d.__class__ = C
+print type(d).__name__, d.d1, d.d2
+
+class E(object):
+    __slots__ = ("s", "__dict__")
+
+for i in xrange(5):
+    e = E()
+    e.s = i
+    e.x = i * 2
+    e.y = i * 3
+print e.s, e.x, e.y, sorted(e.__dict__.items())
+
+# Survive a collection:
+import gc
+objs = [make(i % 10) for i in xrange(1000)]
+gc.collect()
+for i, c in enumerate(objs):
+    for j in xrange(i % 10):
+        assert getattr(c, "a%d" % j) == j
+print "done"
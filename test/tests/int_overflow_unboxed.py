@@ -0,0 +1,48 @@
+# Int arithmetic in hot loops stays unboxed in JIT'd code and has to overflow into longs correctly.
+
+def count(n):
+    t = 0
+    i = 0
+    while i < n:
+        t = t + i * 3 - 1
+        i += 1
+    return t
+
+for i in xrange(20):
+    r = count(1000)
+print r, type(r)
+
+def grow(x, n):
+    for i in xrange(n):
+        x = x * 2 + 1
+    return x
+
+for i in xrange(1000):
+    grow(1, 10)
+# These overflow part way through:
+print grow(1, 70)
+print grow(-1, 70)
+print grow(2 ** 62, 1)
+
+def ops(a, b):
+    c = a + b
+    d = a - b
+    e = a * b
+    a += b
+    b -= a
+    b *= 3
+    return c, d, e, a, b
+
+for i in xrange(1000):
+    ops(i, 3)
+big = 2 ** 62
+print ops(big, big)
+print ops(-big, big)
+print ops(-big - big, 1)
+print ops(3037000499, 3037000499)
+print ops(3037000500, 3037000500)
+
+# Once a node has overflowed, later compilations shouldn't keep speculating on it:
+for i in xrange(2000):
+    r = ops(big, big + i)
+print r
@@ -0,0 +1,106 @@
+# Exercises the register bytecode that the interpreter tier runs, including the nodes it hands
+# back to the tree-walking interpreter.  Keep everything in the interpreter tier:
+
+try:
+    import __pyston__
+    __pyston__.setOption("ENABLE_REOPT", 0)
+    __pyston__.setOption("ENABLE_OSR", 0)
+    __pyston__.setOption("ENABLE_BASELINEJIT", 0)
+except ImportError:
+    pass
+
+def f(n):
+    total = 0
+    for i in xrange(n):
+        a, b = i, i * 2
+        total += a + b
+    return total
+print f(10)
+
+g = 5
+def read_global():
+    return g + 1
+def write_global():
+    global g
+    g = 10
+print read_global()
+write_global()
+print read_global()
+
+def closures(x):
+    y = x + 1
+    def inner(z):
+        return x + y + z
+    y = y + 1
+    return inner
+print closures(1)(10)
+
+def unbound(c):
+    if c:
+        x = 1
+    return x
+print unbound(True)
+try:
+    unbound(False)
+except UnboundLocalError as e:
+    print e
+
+# The local has to be checked before the call happens:
+def order():
+    def side_effect():
+        print "called"
+        return 1
+    return y + side_effect()
+    y = 0
+try:
+    order()
+except UnboundLocalError as e:
+    print e
+
+def excs(l):
+    try:
+        return l[5]
+    except IndexError:
+        return "caught"
+    finally:
+        print "finally"
+print excs(range(3))
+print excs(range(10))
+
+class C(object):
+    z = 3
+    def __init__(self):
+        self.x = 1
+    def m(self, a, b=2, *args, **kw):
+        return (a, b, args, sorted(kw.items()))
+
+c = C()
+c.y = c.x + C.z
+d = {}
+d["a"] = c.y
+l = [0, 0]
+l[1] = d["a"]
+print c.y, d, l, l[0:1], l[::-1]
+print c.m(1), c.m(1, b=3), c.m(1, 2, 3, k=4), c.m(*(1, 2), **{'q': 5})
+
+def gen(n):
+    for i in range(n):
+        yield i * i
+print list(gen(5))
+
+def deleter():
+    x = 1
+    del x
+    try:
+        print x
+    except UnboundLocalError as e:
+        print e
+deleter()
+
+def locs(a, b=2):
+    c = a + b
+    return sorted(locals().items())
+print locs(1)
+
+print [x * 2 for x in range(4)], {x: -x for x in range(3)}, not 0, -5, 1 < 2 < 3, 1 if 0 else 2
+print 7 / 2, 7 // 2, 7.0 / 2, 2 ** 10, 10L, 1j, u"u", "s" "t"
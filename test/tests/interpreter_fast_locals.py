@@ -0,0 +1,37 @@
+# Interpreted frames keep their FAST and CLOSURE variables in an array numbered by the scoping analysis;
+# make sure introspection and OSR see the right values.
+
+import sys
+
+def f(n):
+    a = 1
+    if n > 100:
+        b = 2
+    c = [n]
+    def g():
+        return c
+    for i in xrange(n):
+        a += i
+    frame_locals = sys._getframe(0).f_locals
+    return a, sorted(k for k in frame_locals if k != "g"), sorted(locals().keys())
+for i in xrange(3):
+    print f(1000)
+    print f(10)
+
+def uses_global():
+    global x
+    x = 5
+    y = x + 1
+    return y, sorted(locals())
+print uses_global(), x
+
+def with_exec():
+    a = 1
+    exec "b = a + 1"
+    return sorted(locals().items())
+print with_exec()
+
+class C(object):
+    a = 1
+    b = a + 1
+    print sorted(k for k in locals() if not k.startswith("__"))
@@ -0,0 +1,59 @@
+# Interpreted frames get found through the stack rather than a global table; check that the GC still sees
+# the locals of frames with more registers than fit inline, and that tracebacks / frame introspection work.
+
+import gc
+import sys
+import traceback
+
+try:
+    import __pyston__
+    __pyston__.setOption("ENABLE_REOPT", 0)
+    __pyston__.setOption("ENABLE_OSR", 0)
+except ImportError:
+    pass
+
+def many_locals(n):
+    a0 = [0]; a1 = [1]; a2 = [2]; a3 = [3]; a4 = [4]; a5 = [5]; a6 = [6]; a7 = [7]
+    a8 = [8]; a9 = [9]; a10 = [10]; a11 = [11]; a12 = [12]; a13 = [13]; a14 = [14]; a15 = [15]
+    a16 = [16]; a17 = [17]; a18 = [18]; a19 = [19]
+    if n:
+        return many_locals(n - 1)
+    for i in xrange(3):
+        gc.collect()
+        l = [[i] * 100 for i in xrange(1000)]
+    return sum(x[0] for x in (a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, a17, a18, a19))
+print many_locals(5)
+
+def recurse(n):
+    if n == 0:
+        f = sys._getframe(0)
+        depth = 0
+        while f and f.f_code.co_name == "recurse":
+            depth += 1
+            f = f.f_back
+        print "depth", depth
+        raise ValueError("bottom")
+    return recurse(n - 1)
+
+try:
+    recurse(20)
+except ValueError:
+    tb = traceback.extract_tb(sys.exc_info()[2])
+    print len(tb), tb[-1][2]
+
+# Several threads running a function for the first time at once all share its lowered bytecode:
+import threading
+results = []
+def fresh(n):
+    t = 0
+    for i in xrange(n):
+        t += i
+    return t
+def worker():
+    results.append(fresh(1000))
+threads = [threading.Thread(target=worker) for i in xrange(4)]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+print results
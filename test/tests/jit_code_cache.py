@@ -0,0 +1,47 @@
+# Code that gets reoptimized, evicted from a tiny code cache, or exec'd over and over
+# should keep working, including versions that are still running when they get replaced.
+# statcheck: stats['jit_versions_freed'] >= 1
+
+try:
+    import __pyston__
+    __pyston__.setOption("JIT_CODE_CACHE_LIMIT_KB", 16)
+    __pyston__.setOption("REOPT_THRESHOLD_INTERPRETER", 5)
+    __pyston__.setOption("REOPT_THRESHOLD_BASELINE", 10)
+except ImportError:
+    pass
+
+def make(i):
+    exec """
+def f%d(n):
+    t = 0
+    for j in xrange(n):
+        t += j * %d
+    return t
+""" % (i, i)
+    return locals()["f%d" % i]
+
+total = 0
+for i in xrange(50):
+    f = make(i)
+    for j in xrange(30):
+        total += f(j)
+print total
+
+# A version that gets replaced while it's on the stack:
+def rec(n):
+    if n == 0:
+        return 0
+    return n + rec(n - 1)
+
+for i in xrange(100):
+    r = rec(20)
+print r
+
+def gen(n):
+    for i in xrange(n):
+        yield i * 2
+
+gens = [gen(5) for i in xrange(50)]
+for g in gens:
+    g.next()
+print sum(sum(g) for g in gens)
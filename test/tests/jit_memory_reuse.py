@@ -0,0 +1,29 @@
+# Without a code cache limit, nothing gets evicted, but the versions that get replaced when their function gets
+# reoptimized still get freed, and their memory gets used for the code that gets compiled after them.
+# statcheck: stats['jit_memory_bytes_released'] > 0
+# statcheck: stats['jit_memory_bytes_reused'] > 0
+
+try:
+    import __pyston__
+    __pyston__.setOption("REOPT_THRESHOLD_INTERPRETER", 5)
+    __pyston__.setOption("REOPT_THRESHOLD_BASELINE", 10)
+    __pyston__.setOption("REOPT_THRESHOLD_T2", 50)
+except ImportError:
+    pass
+
+def make(i):
+    exec """
+def f%d(n):
+    t = 0
+    for j in xrange(n):
+        t += j * %d
+    return t
+""" % (i, i)
+    return locals()["f%d" % i]
+
+total = 0
+for i in xrange(20):
+    f = make(i)
+    for j in xrange(200):
+        total += f(j % 20)
+print total
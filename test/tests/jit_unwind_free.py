@@ -0,0 +1,34 @@
+# Versions whose frames only ever get left by an exception propagating out of them shouldn't stay pinned: once
+# they get replaced by a reoptimized version, they should get freed like any other.
+# statcheck: stats['jit_versions_freed'] >= 20
+
+try:
+    import __pyston__
+    __pyston__.setOption("REOPT_THRESHOLD_INTERPRETER", 5)
+    __pyston__.setOption("REOPT_THRESHOLD_BASELINE", 10)
+    __pyston__.setOption("REOPT_THRESHOLD_T2", 50)
+except ImportError:
+    pass
+
+def make(i):
+    ns = {}
+    exec """
+def inner%d(n):
+    if n >= 0:
+        raise ValueError(n * %d)
+    return n
+
+def outer%d(n):
+    return inner%d(n) + 1
+""" % (i, i, i, i) in ns
+    return ns["outer%d" % i]
+
+total = 0
+for i in xrange(20):
+    f = make(i)
+    for j in xrange(200):
+        try:
+            f(j)
+        except ValueError as e:
+            total += e.args[0]
+print total
@@ -0,0 +1,85 @@
+# Function bodies that come from the .pyc cache only get deserialized when they're needed;
+# check that everything we know about a function before that is right, that packages with stale
+# cache files get preparsed in the background, and that the bodies survive the .pyc changing under us.
+# statcheck: stats['num_lazy_function_bodies'] > 0
+# statcheck: stats['num_preparsed_files'] > 0
+# statcheck: stats['num_lazy_function_bodies_reparsed'] > 0
+
+try:
+    import __pyston__
+    __pyston__.setOption("PREPARSE_THREADS", 2)
+    preparsing = True
+except ImportError:
+    preparsing = False
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+d = os.path.dirname(os.path.abspath(__file__))
+
+# Imports the module in another process first, so that its cache file exists by the time we import it here:
+def import_from_cache(name):
+    subprocess.check_call([sys.executable, "-c", "import " + name], cwd=d)
+    return __import__(name)
+
+t = import_from_cache("lazy_function_bodies_target")
+
+print t.documented.__doc__, t.undocumented.__doc__, t.C.method.__doc__
+print type(t.gen(3)).__name__, type(t.not_a_generator()).__name__
+print t.documented(1), t.undocumented(2), list(t.gen(3)), list(t.not_a_generator()())
+c = t.make_counter()
+print c(), c(), t.C().method()
+try:
+    t.never_called()
+except NameError, e:
+    print e
+
+import test_package.import_target
+print test_package.import_target.__name__
+
+# A package whose module has a stale cache file: importing the package should get the module preparsed.
+tmpdir = tempfile.mkdtemp()
+try:
+    pkg = os.path.join(tmpdir, "preparse_pkg")
+    os.mkdir(pkg)
+    with open(os.path.join(pkg, "__init__.py"), "w") as f:
+        f.write("")
+    mod = os.path.join(pkg, "mod.py")
+    with open(mod, "w") as f:
+        f.write("def f(x):\n    return x * 3\n")
+    with open(mod + "c", "w") as f:
+        f.write("stale")
+    os.utime(mod + "c", (0, 0))
+
+    sys.path.insert(0, tmpdir)
+    import preparse_pkg
+    # Let the preparse threads get to it before we do:
+    deadline = time.time() + 30
+    while preparsing and time.time() < deadline and os.stat(mod + "c").st_mtime < os.stat(mod).st_mtime:
+        time.sleep(0.01)
+    import preparse_pkg.mod
+    print preparse_pkg.mod.f(14)
+finally:
+    sys.path.remove(tmpdir)
+    shutil.rmtree(tmpdir)
+
+# The .pyc that a module got loaded from can change under us: function bodies that haven't been
+# deserialized yet have to come from the source then, instead of what's left of the file.
+t = import_from_cache("pyc_mmap_target")
+
+# Truncate the cache file in place, the way a careless tool would; the next import just reparses it.
+pyc = os.path.join(d, "pyc_mmap_target.pyc")
+if os.path.exists(pyc):
+    with open(pyc, "r+b") as f:
+        f.truncate(0)
+
+class C(object):
+    pass
+
+print t.add(1, 2), t.add("a", "b")
+print t.attributes(C())
+print t.norm1(t.Point(-3, 4))
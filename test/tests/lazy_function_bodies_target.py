@@ -0,0 +1,33 @@
+# Module-level functions of this module get loaded lazily once it has a .pyc file.
+
+def documented(x):
+    """adds one"""
+    return x + 1
+
+def undocumented(x):
+    y = x * 2
+    return y
+
+def gen(n):
+    for i in xrange(n):
+        yield i
+
+def not_a_generator():
+    def inner():
+        yield 1
+    return inner
+
+def make_counter():
+    count = [0]
+    def incr():
+        count[0] += 1
+        return count[0]
+    return incr
+
+class C(object):
+    def method(self):
+        "method doc"
+        return documented(41)
+
+def never_called():
+    return undefined_name
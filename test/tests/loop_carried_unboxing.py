@@ -0,0 +1,33 @@
+# Loop-carried ints and floats that get boxed across the backedge, and only need
+# to be materialized when leaving the loop (or when a speculation fails).
+
+def floats(n):
+    x = 0.0
+    v = 1.5
+    for i in xrange(n):
+        x = x + v * 0.5
+        if i % 3 == 0:
+            v = v - 0.25
+        else:
+            v = v + 0.125
+    return x, v
+
+def ints(n):
+    a, b = 0, 1
+    for i in xrange(n):
+        a, b = b, (a + b) % 1000003
+    return a, b
+
+def mixed(n):
+    t = 0
+    for i in xrange(n):
+        if i == n - 5:
+            t = t + 0.5
+        else:
+            t = t + i
+    return t
+
+for i in xrange(3):
+    print floats(20000)
+    print ints(20000)
+    print mixed(20000)
@@ -0,0 +1,28 @@
+# Type guards on values that don't change inside a loop can get checked once before the loop;
+# make sure that a value with a different type still takes the slow path.
+
+class C(object):
+    pass
+
+def get(c):
+    return c.v
+
+def f(c, n):
+    t = 0
+    for i in xrange(n):
+        t = t + get(c) * i
+    return t
+
+c = C()
+c.v = 2
+for i in xrange(100):
+    r = f(c, 1000)
+print r
+
+c.v = 1.5
+print f(c, 1000)
+c.v = "a"
+try:
+    f(c, 10)
+except TypeError as e:
+    print e
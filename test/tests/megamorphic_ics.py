@@ -0,0 +1,51 @@
+# Once an IC has seen too many different types, it switches over to a shared cache.
+# Make sure that cache stays correct as classes and instances change.
+# statcheck: stats['megamorphic_cache_hits'] >= 1
+
+classes = []
+for i in xrange(200):
+    def m(self, x, i=i):
+        return x + i
+    classes.append(type("C%d" % i, (object,), {"m": m, "k": i}))
+
+objs = []
+for i, C in enumerate(classes):
+    o = C()
+    o.a = i
+    objs.append(o)
+
+def f(o):
+    return o.a + o.k + o.m(1)
+
+for _ in xrange(3):
+    total = 0
+    for o in objs:
+        total += f(o)
+    print total
+
+# Mutating the classes has to be noticed:
+for C in classes:
+    C.k = -1
+    C.m = lambda self, x: x * 10
+print sum(f(o) for o in objs)
+
+# Instance attributes shadowing class attributes:
+for o in objs[::2]:
+    o.k = 1000
+    o.m = lambda x: 0
+print sum(f(o) for o in objs)
+
+del classes[1].m
+try:
+    f(objs[1])
+except AttributeError as e:
+    print e
+
+# Descriptors still go through the normal path:
+class D(object):
+    @property
+    def a(self):
+        return 5
+    k = 0
+    m = staticmethod(lambda x: x)
+print f(D())
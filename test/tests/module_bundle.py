@@ -0,0 +1,39 @@
+# Write a module bundle, and import from it in another process once the sources are gone.
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+d = tempfile.mkdtemp()
+try:
+    with open(os.path.join(d, "bundle_mod.py"), "w") as f:
+        f.write("def f(x):\n    'doc'\n    return x * 2\n")
+    os.mkdir(os.path.join(d, "bundle_pkg"))
+    with open(os.path.join(d, "bundle_pkg", "__init__.py"), "w") as f:
+        f.write("import bundle_mod\nfrom . import sub\n")
+    with open(os.path.join(d, "bundle_pkg", "sub.py"), "w") as f:
+        f.write("y = [i for i in range(3)]\n")
+
+    code = ("import bundle_pkg, bundle_pkg.sub\n"
+            "print bundle_pkg.bundle_mod.f(21), bundle_pkg.bundle_mod.f.__doc__, bundle_pkg.sub.y\n"
+            "print bundle_pkg.__path__[0].endswith('bundle_pkg')\n")
+    bundle = os.path.join(d, "app.bundle")
+
+    env = dict(os.environ)
+    env["PYTHONPATH"] = d
+    env["PYSTON_WRITE_MODULE_BUNDLE"] = bundle
+    subprocess.check_call([sys.executable, "-c", code], env=env)
+
+    # The second run must get everything from the bundle, so take the sources (and their .pyc files) away:
+    shutil.rmtree(os.path.join(d, "bundle_pkg"))
+    for fn in os.listdir(d):
+        if fn.startswith("bundle_mod."):
+            os.remove(os.path.join(d, fn))
+
+    del env["PYSTON_WRITE_MODULE_BUNDLE"]
+    env["PYSTON_MODULE_BUNDLE"] = bundle
+    subprocess.check_call([sys.executable, "-c", code], env=env)
+finally:
+    shutil.rmtree(d)
@@ -0,0 +1,42 @@
+# Build an object cache pack in one process, and load the JIT'd objects from it in another.
+
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+code = ("def f(n):\n"
+        "    t = 0\n"
+        "    for i in xrange(n):\n"
+        "        t += i * 2\n"
+        "    return t\n"
+        "print f(1000)\n")
+
+def run(env):
+    # -n: skip the interpreter, so that everything gets compiled; -s: print the stats
+    p = subprocess.Popen([sys.executable, "-n", "-s", "-c", code], env=env, stdout=subprocess.PIPE,
+                         stderr=subprocess.PIPE)
+    out, err = p.communicate()
+    assert p.returncode == 0, err
+    print out.strip()
+    stats = dict(re.findall(r"^\s*(\w+): (\d+)$", err, re.M))
+    return int(stats.get("num_jit_objectcache_pack_hits", 0))
+
+d = tempfile.mkdtemp()
+try:
+    pack = os.path.join(d, "objects.pack")
+    env = dict(os.environ)
+    # Keep the cache directory out of the way:
+    env["HOME"] = d
+    env["PYSTON_OBJECT_CACHE_WRITE_PACK"] = pack
+    run(env)
+    print os.path.exists(pack)
+
+    del env["PYSTON_OBJECT_CACHE_WRITE_PACK"]
+    env["PYSTON_OBJECT_CACHE_PACK"] = pack
+    shutil.rmtree(os.path.join(d, ".cache"), ignore_errors=True)
+    print run(env) > 0
+finally:
+    shutil.rmtree(d)
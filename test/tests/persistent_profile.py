@@ -0,0 +1,38 @@
+# Record a persistent profile in one process, and check that a second process picks it up.
+
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+code = ("class C(object):\n"
+        "    def __init__(self, x):\n"
+        "        self.x = x\n"
+        "def f(c):\n"
+        "    return c.x + 1\n"
+        "t = 0\n"
+        "for i in xrange(20000):\n"
+        "    t += f(C(i))\n"
+        "print t\n")
+
+def run(env):
+    p = subprocess.Popen([sys.executable, "-s", "-c", code], env=env, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    out, err = p.communicate()
+    assert p.returncode == 0, err
+    print out.strip()
+    return dict((k, int(v)) for k, v in re.findall(r"^\s*(\w+): (\d+)$", err, re.M))
+
+d = tempfile.mkdtemp()
+try:
+    env = dict(os.environ)
+    env["PYSTON_PERSISTENT_PROFILE"] = os.path.join(d, "profile")
+    run(env)
+    print os.path.exists(env["PYSTON_PERSISTENT_PROFILE"])
+
+    stats = run(env)
+    print stats.get("persistent_profile_efforts_applied", 0) > 0
+    print stats.get("persistent_profile_types_seeded", 0) > 0
+finally:
+    shutil.rmtree(d)
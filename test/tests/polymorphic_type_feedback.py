@@ -0,0 +1,74 @@
+# Sites that see a mix of classes shouldn't get speculated on, but a site that's
+# dominated by one class (with the occasional outlier) should keep working either way.
+# Int/float sites get a switch on the operand classes instead:
+# statcheck: stats.get('num_numeric_type_switches_emitted', 0) >= 1
+
+class C(object):
+    def __init__(self, v):
+        self.v = v
+
+def mixed(c):
+    return c.v * 2
+
+def f():
+    total = 0
+    for i in xrange(20000):
+        if i % 2:
+            total += mixed(C(i))
+        else:
+            total += mixed(C(i * 0.5))
+    return total
+print f()
+
+def mostly_ints():
+    total = 0
+    for i in xrange(20000):
+        if i % 1000 == 999:
+            total += mixed(C(1.5))
+        elif i % 997 == 0:
+            total += mixed(C(2L))
+        else:
+            total += mixed(C(i))
+    return total
+print mostly_ints()
+
+def changes_phase():
+    total = 0
+    for i in xrange(20000):
+        if i < 10000:
+            total += mixed(C(i))
+        else:
+            total += mixed(C(str(i % 10)))[0] == '1'
+    return total
+print changes_phase()
+
+# More classes than the histogram has room for: the ones that keep getting evicted still count against the
+# most common one.
+rare = [1.5, 2L, "s", u"u", (1,), [1], True]
+def many_classes():
+    total = 0
+    for i in xrange(20000):
+        if i % 10 == 0:
+            v = rare[(i / 10) % len(rare)]
+            total += len(str(mixed(C(v))))
+        else:
+            total += mixed(C(i))
+    return total
+print many_classes()
+
+# Mixed int/float arithmetic; int overflow and operands of other classes have to go through the generic path:
+def scale(a, b):
+    return a * b + a - b
+
+def numeric():
+    total = 0
+    for i in xrange(20000):
+        if i % 3 == 0:
+            total += scale(i, 0.5)
+        elif i % 3 == 1:
+            total += scale(0.25, i)
+        else:
+            total += scale(i, 3)
+    print total
+    print scale(2 ** 62, 4), scale(1.5, 2L), scale(7, 7)
+numeric()
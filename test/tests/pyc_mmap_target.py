@@ -0,0 +1,18 @@
+# Loaded from its .pyc by lazy_function_bodies.py, which truncates the .pyc before calling these.
+
+def add(first_argument, second_argument):
+    total = first_argument + second_argument
+    return total
+
+def attributes(obj):
+    obj.some_attribute_name = 1
+    obj.another_attribute_name = 2
+    return sorted(k for k in obj.__dict__ if k.endswith("_name"))
+
+class Point(object):
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+
+def norm1(p):
+    return abs(p.x) + abs(p.y)